@@ -0,0 +1,248 @@
+
+#include <knotkit.h>
+
+/* The entries of the Alexander matrix are linear in t, so its
+   determinant has degree at most the size m of the matrix.  The
+   determinant is evaluated at t = 0, ..., m modulo primes just
+   below 2^62 and interpolated.  The coefficients in each row of the
+   matrix sum to at most 4 in absolute value, so those of the
+   determinant sum to at most 4^m, which fixes how many primes the
+   Chinese remainder theorem needs. */
+
+static const uint64 primes[] = {
+  4611686018427387847ull, 4611686018427387817ull,
+  4611686018427387787ull, 4611686018427387761ull,
+  4611686018427387751ull, 4611686018427387737ull,
+  4611686018427387733ull, 4611686018427387709ull,
+};
+
+static inline uint64
+mulmod (uint64 a, uint64 b, uint64 p)
+{
+  return (uint64)((unsigned __int128)a * b % p);
+}
+
+static uint64
+invmod (uint64 a, uint64 p)
+{
+  // a^(p - 2)
+  uint64 r = 1, e = p - 2;
+  while (e)
+    {
+      if (e & 1)
+	r = mulmod (r, a, p);
+      a = mulmod (a, a, p);
+      e >>= 1;
+    }
+  return r;
+}
+
+static inline uint64
+reduce (int64 x, uint64 p)
+{
+  return x >= 0 ? (uint64)x % p : p - (uint64)(-x) % p;
+}
+
+/* entries c0 + c1 t */
+typedef std::vector<std::vector<std::pair<int, int> > > alexander_matrix;
+
+static uint64
+determinant_mod (const alexander_matrix &a, uint64 x, uint64 p)
+{
+  unsigned m = a.size ();
+  std::vector<std::vector<uint64> > b (m, std::vector<uint64> (m));
+  for (unsigned i = 0; i < m; i ++)
+    for (unsigned j = 0; j < m; j ++)
+      b[i][j] = reduce ((int64)a[i][j].first + (int64)a[i][j].second * (int64)x, p);
+  
+  uint64 det = 1;
+  for (unsigned k = 0; k < m; k ++)
+    {
+      unsigned r = k;
+      while (r < m && b[r][k] == 0)
+	r ++;
+      if (r == m)
+	return 0;
+      if (r != k)
+	{
+	  b[r].swap (b[k]);
+	  det = p - det;
+	}
+  
+      det = mulmod (det, b[k][k], p);
+      uint64 inv = invmod (b[k][k], p);
+      for (unsigned i = k + 1; i < m; i ++)
+	{
+	  if (b[i][k] == 0)
+	    continue;
+  
+	  uint64 f = mulmod (b[i][k], inv, p);
+	  for (unsigned j = k; j < m; j ++)
+	    b[i][j] = (b[i][j] + p - mulmod (f, b[k][j], p)) % p;
+	}
+    }
+  return det;
+}
+
+/* coefficients mod p of the polynomial of degree < m through
+   (0, y[0]), ..., (m - 1, y[m - 1]), m = y.size () */
+static std::vector<uint64>
+interpolate_mod (std::vector<uint64> y, uint64 p)
+{
+  unsigned m = y.size ();
+  
+  // Newton's divided differences; nodes i and i - j are j apart
+  for (unsigned j = 1; j < m; j ++)
+    {
+      uint64 inv = invmod (j, p);
+      for (unsigned i = m - 1; i >= j; i --)
+	y[i] = mulmod ((y[i] + p - y[i - 1]) % p, inv, p);
+    }
+  
+  std::vector<uint64> c (m, 0);
+  c[0] = y[m - 1];
+  unsigned deg = 0;
+  for (unsigned i = m - 1; i -- > 0;)
+    {
+      // c = c (t - i) + y[i]
+      deg ++;
+      for (unsigned k = deg; k > 0; k --)
+	c[k] = (c[k - 1] + p - mulmod (c[k], i, p)) % p;
+      c[0] = (p - mulmod (c[0], i, p)) % p;
+      c[0] = (c[0] + y[i]) % p;
+    }
+  return c;
+}
+
+multivariate_laurentpoly<Z>
+alexander_polynomial (const knot_diagram &kd)
+{
+  assert (kd.num_components () == 1);
+  
+  unsigned n = kd.n_crossings;
+  
+  // arcs: edges joined where they pass over a crossing
+  unionfind<1> u (kd.num_edges ());
+  for (unsigned c = 1; c <= n; c ++)
+    u.join (kd.ept_edge (kd.crossings[c][2]),
+	    kd.ept_edge (kd.crossings[c][4]));
+  assert (u.num_sets () == n);
+  
+  map<unsigned, unsigned> root_arc;
+  basedvector<unsigned, 1> edge_arc (kd.num_edges ());
+  for (unsigned e = 1; e <= kd.num_edges (); e ++)
+    {
+      unsigned r = u.find (e);
+      if (! (root_arc % r))
+	root_arc.push (r, root_arc.card ());
+      edge_arc[e] = root_arc(r);
+    }
+  
+  /* Fox derivatives of the Wirtinger relation at each crossing, over
+     arc k, under arcs i in and j out: 1 - t, t, -1 for a positive
+     crossing and 1 - t, -1, t for a negative one.  The last crossing
+     and the last arc are dropped. */
+  unsigned m = n ? n - 1 : 0;
+  alexander_matrix a (m, std::vector<std::pair<int, int> > (m, std::pair<int, int> (0, 0)));
+  for (unsigned c = 1; c <= m; c ++)
+    {
+      std::vector<std::pair<int, int> > &row = a[c - 1];
+      bool positive = (kd.is_to_ept (kd.crossings[c][1])
+		       == kd.is_to_ept (kd.crossings[c][4]));
+      unsigned in = kd.crossings[c][1],
+	out = kd.crossings[c][3];
+      if (kd.is_from_ept (in))
+	std::swap (in, out);
+  
+      unsigned k = edge_arc[kd.ept_edge (kd.crossings[c][2])],
+	i = edge_arc[kd.ept_edge (in)],
+	j = edge_arc[kd.ept_edge (out)];
+      if (k < m)
+	{
+	  row[k].first += 1;
+	  row[k].second -= 1;
+	}
+      if (i < m)
+	{
+	  if (positive)
+	    row[i].second += 1;
+	  else
+	    row[i].first -= 1;
+	}
+      if (j < m)
+	{
+	  if (positive)
+	    row[j].first -= 1;
+	  else
+	    row[j].second += 1;
+	}
+    }
+  
+  std::vector<mpz_class> coeffs (m + 1);
+  if (m == 0)
+    coeffs[0] = 1;
+  else
+    {
+      unsigned n_primes = (2 * m + 1) / 61 + 1;
+      if (n_primes > sizeof (primes) / sizeof (primes[0]))
+	{
+	  fprintf (stderr, "error: diagram too large for alexander_polynomial\n");
+	  exit (EXIT_FAILURE);
+	}
+  
+      mpz_class M = 1;
+      for (unsigned l = 0; l < n_primes; l ++)
+	{
+	  uint64 p = primes[l];
+	  std::vector<uint64> y (m + 1);
+	  for (unsigned x = 0; x <= m; x ++)
+	    y[x] = determinant_mod (a, x, p);
+	  std::vector<uint64> r = interpolate_mod (y, p);
+  
+	  // Garner: coeffs += M ((r - coeffs) / M mod p)
+	  mpz_class pz = (unsigned long)p;
+	  uint64 Minv = invmod (mpz_fdiv_ui (M.get_mpz_t (), p), p);
+	  for (unsigned k = 0; k <= m; k ++)
+	    {
+	      uint64 ck = mpz_fdiv_ui (coeffs[k].get_mpz_t (), p);
+	      uint64 h = mulmod ((r[k] + p - ck) % p, Minv, p);
+	      coeffs[k] += M * (unsigned long)h;
+	    }
+	  M *= pz;
+	}
+  
+      // symmetric residues
+      mpz_class half = M / 2;
+      for (unsigned k = 0; k <= m; k ++)
+	{
+	  if (cmp (coeffs[k], half) > 0)
+	    coeffs[k] -= M;
+	}
+    }
+  
+  int lo = -1, hi = -1;
+  mpz_class sum = 0;
+  for (unsigned k = 0; k < coeffs.size (); k ++)
+    {
+      if (sgn (coeffs[k]) == 0)
+	continue;
+      if (lo < 0)
+	lo = k;
+      hi = k;
+      sum += coeffs[k];
+    }
+  assert (lo >= 0
+	  && (cmp (sum, 1) == 0 || cmp (sum, -1) == 0)
+	  && (hi - lo) % 2 == 0);
+  
+  multivariate_laurentpoly<Z> delta;
+  int center = (lo + hi) / 2;
+  for (int k = lo; k <= hi; k ++)
+    {
+      assert (cmp (coeffs[k], coeffs[hi - (k - lo)]) == 0);
+      if (sgn (coeffs[k]) != 0)
+	delta += multivariate_laurentpoly<Z> (Z (sgn (sum) < 0 ? mpz_class (-coeffs[k]) : coeffs[k]),
+					      VARIABLE, 1, k - center);
+    }
+  return delta;
+}
@@ -0,0 +1,6 @@
+
+/* The Alexander polynomial of the knot kd, in the variable t (x1),
+   from the Wirtinger presentation: the determinant of the Alexander
+   matrix with one row and one column removed.  Normalized so that
+   Delta(t^-1) = Delta(t) and Delta(1) = 1. */
+multivariate_laurentpoly<Z> alexander_polynomial (const knot_diagram &kd);
@@ -67,7 +67,10 @@ class Q
     write_state();
 #endif
   }
-  //Q(reader &r) : impl(new Q_impl (r)) { }
+  Q(reader &r) : impl(new mpq_class) {
+    r.read_mpz(mpq_numref(impl.get()->get_mpq_t()));
+    r.read_mpz(mpq_denref(impl.get()->get_mpq_t()));
+  }
   ~Q() {
 #ifdef DEBUG_Q
     std::cout << "~Q()" << "\n";
@@ -203,7 +206,10 @@ class Q
   static void show_ring () { printf ("Q"); }
   void show_self () const { std::cout << *this; }
   void display_self () const { std::cout << *this << "\n"; }
-  // void write_self (writer &w) const { write (w, *impl); }
+  void write_self (writer &w) const {
+    w.write_mpz(mpq_numref(impl.get()->get_mpq_t()));
+    w.write_mpz(mpq_denref(impl.get()->get_mpq_t()));
+  }
   int get_count() const {
     return impl.use_count();
   }
@@ -62,6 +62,9 @@ class Z
     write_state();
 #endif
   }
+  Z(reader &r) : impl(new mpz_class) {
+    r.read_mpz(impl.get()->get_mpz_t());
+  }
   Z(Z&& z) : impl(std::move(z.impl)) {
 #ifdef DEBUG_Z
     std::cout << "Z(Z&& z)" << "\n";
@@ -275,5 +278,15 @@ class Z
   unsigned get_ui() const {
     return impl.get()->get_ui();
   }
+
+  long get_si() const {
+    return impl.get()->get_si();
+  }
+
+  const mpz_class& get_mpz() const {
+    return *impl.get();
+  }
+
+  void write_self (writer &w) const { w.write_mpz(impl.get()->get_mpz_t()); }
 };
 #endif // _KNOTKIT_ALGEBRA_Z_H
@@ -33,6 +33,7 @@ class Zp
     x.v = 0;
   }
   Zp (const Z& z) : v((z % p).get_ui()) {}
+  Zp (reader &r) : v(r.read_unsigned ()) { assert (v < p); }
   ~Zp () { }
   
   Zp& operator = (const Zp& x) { v = x.v; return *this; }
@@ -55,6 +56,8 @@ class Zp
     return v != 0;
   }
   
+  unsigned get_ui () const { return v; }
+  
   Zp operator + (const Zp& x) const { return Zp (v + x.v); }
   Zp operator - (const Zp& x) const { return Zp ((int)v - (int)x.v); }
   Zp operator - () const { return Zp (- (int)v);  }
@@ -121,6 +124,7 @@ class Zp
     return os << x.v;
   }
   static void show_ring () { std::cout << "Z" << p; }
+  void write_self (writer &w) const { w.write_unsigned (v); }
   void show_self () const { std::cout << v << "(" << p << ")"; }
   void display_self () const { std::cout << *this << "\n"; }
 };
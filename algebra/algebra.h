@@ -70,10 +70,15 @@ enum variable { VARIABLE };
 #include <algebra/Zp.h>
 #include <algebra/Q.h>
 #include <algebra/polynomial.h>
+#include <algebra/bivariate_laurentpoly.h>
 
 #include <algebra/fraction_field.h>
+#include <algebra/extension_field.h>
+#include <algebra/sparse_field_matrix.h>
 
 #include <algebra/module.h>
 #include <algebra/linear_combination.h>
+#include <algebra/column_store.h>
+#include <algebra/mapped_map.h>
 
 #endif // _KNOTKIT_ALGEBRA_H
@@ -0,0 +1,277 @@
+
+#include <algebra/algebra.h>
+
+bivariate_laurentpoly::bivariate_laurentpoly (const multivariate_laurentpoly<Z> &p)
+  : tlow(0), qlow(0), twidth(0), qwidth(0)
+{
+  int tlo = 0, thi = 0, qlo = 0, qhi = 0;
+  bool first = 1;
+  for (map<multivariate_laurent_monomial, Z>::const_iter i = p.coeffs; i; i ++)
+    {
+      const map<unsigned, int> &m = i.key ().m;
+      assert (m.card () <= 2);
+      int e1 = m(1, 0),
+	e2 = m(2, 0);
+      if (first || e1 < tlo) tlo = e1;
+      if (first || e1 > thi) thi = e1;
+      if (first || e2 < qlo) qlo = e2;
+      if (first || e2 > qhi) qhi = e2;
+      first = 0;
+    }
+  if (first)
+    return;
+  
+  extend (tlo, thi, qlo, qhi);
+  for (map<multivariate_laurent_monomial, Z>::const_iter i = p.coeffs; i; i ++)
+    {
+      const map<unsigned, int> &m = i.key ().m;
+      int e1 = m(1, 0),
+	e2 = m(2, 0);
+      assert (m.card () == (unsigned) ((e1 != 0) + (e2 != 0)));
+      c[(e1 - tlow) * qwidth + (e2 - qlow)] += i.val ().get_si ();
+    }
+}
+
+void
+bivariate_laurentpoly::extend (int tlo, int thi, int qlo, int qhi)
+{
+  if (twidth == 0)
+    {
+      tlow = tlo;
+      qlow = qlo;
+      twidth = thi - tlo + 1;
+      qwidth = qhi - qlo + 1;
+      c.assign ((size_t)twidth * qwidth, 0);
+      return;
+    }
+  
+  int new_tlow = std::min (tlow, tlo),
+    new_thigh = std::max (tlow + (int)twidth - 1, thi),
+    new_qlow = std::min (qlow, qlo),
+    new_qhigh = std::max (qlow + (int)qwidth - 1, qhi);
+  unsigned new_twidth = new_thigh - new_tlow + 1,
+    new_qwidth = new_qhigh - new_qlow + 1;
+  if (new_twidth == twidth && new_qwidth == qwidth)
+    return;
+  
+  std::vector<int64> r ((size_t)new_twidth * new_qwidth, 0);
+  for (unsigned i = 0; i < twidth; i ++)
+    std::copy (&c[i * qwidth], &c[i * qwidth] + qwidth,
+	       &r[(i + tlow - new_tlow) * new_qwidth + (qlow - new_qlow)]);
+  
+  tlow = new_tlow;
+  qlow = new_qlow;
+  twidth = new_twidth;
+  qwidth = new_qwidth;
+  c.swap (r);
+}
+
+multivariate_laurentpoly<Z>
+bivariate_laurentpoly::multivariate () const
+{
+  map<multivariate_laurent_monomial, Z> coeffs;
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      {
+	int64 x = c[i * qwidth + j];
+	if (x == 0)
+	  continue;
+  
+	multivariate_laurent_monomial m;
+	m.push_exponent (1, tlow + (int)i);
+	m.push_exponent (2, qlow + (int)j);
+	coeffs.push (m, Z (mpz_class ((long)x)));
+      }
+  return multivariate_laurentpoly<Z> (coeffs);
+}
+
+bool
+bivariate_laurentpoly::is_zero () const
+{
+  for (unsigned k = 0; k < c.size (); k ++)
+    {
+      if (c[k] != 0)
+	return 0;
+    }
+  return 1;
+}
+
+void
+bivariate_laurentpoly::trim ()
+{
+  int tlo = 0, thi = -1, qlo = 0, qhi = -1;
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      {
+	if (c[i * qwidth + j] == 0)
+	  continue;
+  
+	if (thi < tlo)
+	  {
+	    tlo = thi = i;
+	    qlo = qhi = j;
+	  }
+	thi = i;
+	qlo = std::min (qlo, (int)j);
+	qhi = std::max (qhi, (int)j);
+      }
+  if (thi < tlo)
+    {
+      *this = bivariate_laurentpoly ();
+      return;
+    }
+  if (tlo == 0 && qlo == 0
+      && thi == (int)twidth - 1 && qhi == (int)qwidth - 1)
+    return;
+  
+  bivariate_laurentpoly r;
+  r.extend (tlow + tlo, tlow + thi, qlow + qlo, qlow + qhi);
+  for (int i = tlo; i <= thi; i ++)
+    std::copy (&c[i * qwidth + qlo], &c[i * qwidth + qhi] + 1,
+	       &r.c[(i - tlo) * r.qwidth]);
+  *this = r;
+}
+
+bool
+bivariate_laurentpoly::operator == (const bivariate_laurentpoly &p) const
+{
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      {
+	if (c[i * qwidth + j] != p.coeff (tlow + i, qlow + j))
+	  return 0;
+      }
+  for (unsigned i = 0; i < p.twidth; i ++)
+    for (unsigned j = 0; j < p.qwidth; j ++)
+      {
+	if (p.c[i * p.qwidth + j] != coeff (p.tlow + i, p.qlow + j))
+	  return 0;
+      }
+  return 1;
+}
+
+bivariate_laurentpoly &
+bivariate_laurentpoly::operator += (const bivariate_laurentpoly &p)
+{
+  if (p.twidth == 0)
+    return *this;
+  
+  extend (p.tlow, p.tlow + p.twidth - 1, p.qlow, p.qlow + p.qwidth - 1);
+  for (unsigned i = 0; i < p.twidth; i ++)
+    {
+      int64 *r = &c[(i + p.tlow - tlow) * qwidth + (p.qlow - qlow)];
+      const int64 *s = &p.c[i * p.qwidth];
+      for (unsigned j = 0; j < p.qwidth; j ++)
+	r[j] += s[j];
+    }
+  return *this;
+}
+
+bivariate_laurentpoly &
+bivariate_laurentpoly::operator -= (const bivariate_laurentpoly &p)
+{
+  if (p.twidth == 0)
+    return *this;
+  
+  extend (p.tlow, p.tlow + p.twidth - 1, p.qlow, p.qlow + p.qwidth - 1);
+  for (unsigned i = 0; i < p.twidth; i ++)
+    {
+      int64 *r = &c[(i + p.tlow - tlow) * qwidth + (p.qlow - qlow)];
+      const int64 *s = &p.c[i * p.qwidth];
+      for (unsigned j = 0; j < p.qwidth; j ++)
+	r[j] -= s[j];
+    }
+  return *this;
+}
+
+bivariate_laurentpoly &
+bivariate_laurentpoly::operator *= (int64 s)
+{
+  for (unsigned k = 0; k < c.size (); k ++)
+    c[k] *= s;
+  return *this;
+}
+
+bivariate_laurentpoly
+bivariate_laurentpoly::operator * (const bivariate_laurentpoly &p) const
+{
+  bivariate_laurentpoly r;
+  if (twidth == 0 || p.twidth == 0)
+    return r;
+  
+  r.extend (tlow + p.tlow, tlow + p.tlow + twidth + p.twidth - 2,
+	    qlow + p.qlow, qlow + p.qlow + qwidth + p.qwidth - 2);
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      {
+	int64 x = c[i * qwidth + j];
+	if (x == 0)
+	  continue;
+  
+	for (unsigned k = 0; k < p.twidth; k ++)
+	  {
+	    int64 *rr = &r.c[(i + k) * r.qwidth + j];
+	    const int64 *s = &p.c[k * p.qwidth];
+	    for (unsigned l = 0; l < p.qwidth; l ++)
+	      rr[l] += x * s[l];
+	  }
+      }
+  return r;
+}
+
+bivariate_laurentpoly
+bivariate_laurentpoly::evaluate_t (int64 x) const
+{
+  bivariate_laurentpoly r;
+  if (twidth == 0)
+    return r;
+  
+  r.extend (0, 0, qlow, qlow + qwidth - 1);
+  for (unsigned i = 0; i < twidth; i ++)
+    {
+      int e = tlow + (int)i;
+      // negative powers only of units
+      assert (e >= 0 || x == 1 || x == -1);
+      int64 xe = 1;
+      for (int k = 0; k < std::abs (e); k ++)
+	xe *= x;
+  
+      const int64 *s = &c[i * qwidth];
+      for (unsigned j = 0; j < qwidth; j ++)
+	r.c[j] += xe * s[j];
+    }
+  return r;
+}
+
+bivariate_laurentpoly
+bivariate_laurentpoly::invert_q () const
+{
+  bivariate_laurentpoly r;
+  if (twidth == 0)
+    return r;
+  
+  r.extend (tlow, tlow + twidth - 1, -(qlow + (int)qwidth - 1), -qlow);
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      r.c[i * qwidth + (qwidth - 1 - j)] = c[i * qwidth + j];
+  return r;
+}
+
+bivariate_laurentpoly
+bivariate_laurentpoly::fold_q (unsigned n) const
+{
+  bivariate_laurentpoly r;
+  if (twidth == 0)
+    return r;
+  
+  r.extend (tlow, tlow + twidth - 1, 0, n - 1);
+  for (unsigned i = 0; i < twidth; i ++)
+    for (unsigned j = 0; j < qwidth; j ++)
+      {
+	int e = (qlow + (int)j) % (int)n;
+	if (e < 0)
+	  e += n;
+	r.c[i * n + e] += c[i * qwidth + j];
+      }
+  return r;
+}
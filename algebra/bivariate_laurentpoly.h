@@ -0,0 +1,109 @@
+#ifndef _KNOTKIT_ALGEBRA_BIVARIATE_LAURENTPOLY_H
+#define _KNOTKIT_ALGEBRA_BIVARIATE_LAURENTPOLY_H
+
+/* Laurent polynomials in t = x1 and q = x2 with machine integer
+   coefficients, stored densely: the coefficient of t^i q^j is
+   c[(i - tlow) * qwidth + (j - qlow)].  This is the shape of
+   Poincare polynomials, for which multivariate_laurentpoly<Z>
+   allocates a map for every monomial.  Arithmetic runs over
+   contiguous rows and never allocates per term; convert with
+   multivariate () where the general type is needed. */
+
+class bivariate_laurentpoly
+{
+ public:
+  int tlow, qlow;
+  unsigned twidth, qwidth;
+  std::vector<int64> c;
+  
+  // make room for t^tlo..t^thi, q^qlo..q^qhi
+  void extend (int tlo, int thi, int qlo, int qhi);
+  
+ public:
+  bivariate_laurentpoly () : tlow(0), qlow(0), twidth(0), qwidth(0) { }
+  bivariate_laurentpoly (int64 x) : tlow(0), qlow(0), twidth(0), qwidth(0)
+  {
+    add_term (x, 0, 0);
+  }
+  bivariate_laurentpoly (int64 x, int i, int j) : tlow(0), qlow(0), twidth(0), qwidth(0)
+  {
+    add_term (x, i, j);
+  }
+  explicit bivariate_laurentpoly (const multivariate_laurentpoly<Z> &p);
+  bivariate_laurentpoly (const bivariate_laurentpoly &p)
+    : tlow(p.tlow), qlow(p.qlow), twidth(p.twidth), qwidth(p.qwidth), c(p.c)
+  { }
+  ~bivariate_laurentpoly () { }
+  
+  bivariate_laurentpoly &operator = (const bivariate_laurentpoly &p)
+  {
+    tlow = p.tlow;
+    qlow = p.qlow;
+    twidth = p.twidth;
+    qwidth = p.qwidth;
+    c = p.c;
+    return *this;
+  }
+  
+  multivariate_laurentpoly<Z> multivariate () const;
+  
+  bool is_zero () const;
+  int64 coeff (int i, int j) const
+  {
+    if (i < tlow || i >= tlow + (int)twidth
+	|| j < qlow || j >= qlow + (int)qwidth)
+      return 0;
+    return c[(i - tlow) * qwidth + (j - qlow)];
+  }
+  void add_term (int64 x, int i, int j)
+  {
+    if (x == 0)
+      return;
+    extend (i, i, j, j);
+    c[(i - tlow) * qwidth + (j - qlow)] += x;
+  }
+  
+  // shrink to the smallest box holding the nonzero terms
+  void trim ();
+  
+  bool operator == (const bivariate_laurentpoly &p) const;
+  bool operator != (const bivariate_laurentpoly &p) const { return !operator == (p); }
+  bool operator == (int x) const { return operator == (bivariate_laurentpoly (x)); }
+  bool operator != (int x) const { return !operator == (x); }
+  
+  bivariate_laurentpoly &operator += (const bivariate_laurentpoly &p);
+  bivariate_laurentpoly &operator -= (const bivariate_laurentpoly &p);
+  bivariate_laurentpoly &operator *= (int64 s);
+  
+  bivariate_laurentpoly operator + (const bivariate_laurentpoly &p) const
+  {
+    bivariate_laurentpoly r (*this);
+    r += p;
+    return r;
+  }
+  bivariate_laurentpoly operator - (const bivariate_laurentpoly &p) const
+  {
+    bivariate_laurentpoly r (*this);
+    r -= p;
+    return r;
+  }
+  bivariate_laurentpoly operator * (const bivariate_laurentpoly &p) const;
+  
+  // t = x, leaving a polynomial in q
+  bivariate_laurentpoly evaluate_t (int64 x) const;
+  // q -> q^-1
+  bivariate_laurentpoly invert_q () const;
+  // exponents of q taken mod n, into 0, ..., n - 1
+  bivariate_laurentpoly fold_q (unsigned n) const;
+  
+  void show_self () const { std::cout << multivariate (); }
+  void display_self () const { std::cout << multivariate () << "\n"; }
+};
+
+inline std::ostream &
+operator << (std::ostream &os, const bivariate_laurentpoly &p)
+{
+  return os << p.multivariate ();
+}
+
+#endif // _KNOTKIT_ALGEBRA_BIVARIATE_LAURENTPOLY_H
@@ -0,0 +1,286 @@
+#ifndef _KNOTKIT_ALGEBRA_COLUMN_STORE_H
+#define _KNOTKIT_ALGEBRA_COLUMN_STORE_H
+
+/* Columns of a map from -> to which need not fit in memory (see
+   lib/spill.h).  Columns written through operator [] are dirty and
+   stay in memory until spill () writes them out in blocks, one block
+   per homological degree of the domain, so that algorithms walking a
+   complex a degree at a time touch few blocks.  column () loads clean
+   copies of spilled blocks into the shared cache.  Writing to a
+   spilled column makes its whole block dirty again; the old copy on
+   disk is abandoned. */
+
+template<class R>
+class column_store : public refcounted, public spill_cached
+{
+ public:
+  ptr<const module<R> > from, to;
+  
+ private:
+  // rough in-memory footprint, for the budget
+  static const unsigned entry_bytes = 48;
+  static const unsigned column_bytes = 96;
+  
+  class block
+  {
+  public:
+    uint64 offset, size;
+    uint64 nbytes;
+  
+    // columns of the block while it is loaded
+    basedvector<unsigned, 1> keys;
+    bool loaded;
+  
+  public:
+    block () : offset(0), size(0), nbytes(0), loaded(0) { }
+  };
+  
+  ptr<spill_file> f;
+  mutable basedvector<block, 1> blocks;
+  
+  // block holding column i, 0 if the column is dirty (or empty)
+  basedvector<unsigned, 1> column_block;
+  
+  // dirty columns and loaded clean copies
+  mutable map<unsigned, linear_combination<R> > columns;
+  
+  // dirty columns written since the last update_dirty (), and the
+  // cardinality of each dirty column as of then
+  basedvector<unsigned, 1> touched;
+  basedvector<unsigned, 1> dirty_card;
+  unsigned n_dirty;
+  uint64 dirty_entries;
+  
+  void load (unsigned b) const;
+  void unspill (unsigned b);
+  void update_dirty ();
+  
+ public:
+  column_store (ptr<const module<R> > from_, ptr<const module<R> > to_);
+  column_store (const column_store &) = delete;
+  ~column_store () { }
+  
+  column_store &operator = (const column_store &) = delete;
+  
+  bool on_disk () const { return blocks.size () > 0; }
+  
+  linear_combination<R> &operator [] (unsigned i);
+  linear_combination<R> column (unsigned i) const;
+  
+  // all columns; only for a store that never spilled
+  basedvector<linear_combination<R>, 1> explicit_columns () const;
+  
+  uint64 dirty_bytes ()
+  {
+    update_dirty ();
+    return dirty_entries * entry_bytes + (uint64)n_dirty * column_bytes;
+  }
+  void spill ();
+  void spill_if_needed ()
+  {
+    if (spill_budget && dirty_bytes () > spill_budget / 2)
+      spill ();
+  }
+  
+  void evict (unsigned b);
+};
+
+template<class R>
+class spilled_map_impl : public map_impl<R>
+{
+  ptr<const column_store<R> > store;
+  
+ public:
+  spilled_map_impl (ptr<const column_store<R> > store_)
+    : map_impl<R>(store_->from, store_->to),
+      store(store_)
+  { }
+  ~spilled_map_impl () { }
+  
+  const linear_combination<R> column (unsigned i) const { return store->column (i); }
+  const linear_combination<R> column_copy (unsigned i) const
+  {
+    return linear_combination<R> (COPY, store->column (i));
+  }
+};
+
+template<class R>
+column_store<R>::column_store (ptr<const module<R> > from_, ptr<const module<R> > to_)
+  : from(from_), to(to_),
+    column_block(from_->dim ()),
+    dirty_card(from_->dim ()),
+    n_dirty(0),
+    dirty_entries(0)
+{
+  for (unsigned i = 1; i <= from->dim (); i ++)
+    {
+      column_block[i] = 0;
+      dirty_card[i] = 0;
+    }
+}
+
+template<class R> void
+column_store<R>::load (unsigned b) const
+{
+  block &bl = blocks[b];
+  assert (!bl.loaded);
+  
+  spill_reader r (f, bl.offset, bl.size);
+  unsigned n = r.read_unsigned ();
+  bl.keys = basedvector<unsigned, 1> (n);
+  r.read_increasing (&bl.keys[1], n);
+  for (unsigned i = 1; i <= n; i ++)
+    columns.push (bl.keys[i], linear_combination<R> (to, r));
+  bl.loaded = 1;
+}
+
+template<class R> void
+column_store<R>::evict (unsigned b)
+{
+  block &bl = blocks[b];
+  assert (bl.loaded);
+  
+  for (unsigned i = 1; i <= bl.keys.size (); i ++)
+    columns -= bl.keys[i];
+  bl.keys = basedvector<unsigned, 1> ();
+  bl.loaded = 0;
+}
+
+template<class R> void
+column_store<R>::unspill (unsigned b)
+{
+  block &bl = blocks[b];
+  if (!bl.loaded)
+    load (b);
+  forget_block (b);
+  
+  for (unsigned i = 1; i <= bl.keys.size (); i ++)
+    {
+      unsigned k = bl.keys[i];
+      column_block[k] = 0;
+      dirty_card[k] = columns[k].card ();
+      dirty_entries += dirty_card[k];
+      n_dirty ++;
+    }
+  bl.keys = basedvector<unsigned, 1> ();
+  bl.loaded = 0;
+}
+
+template<class R> linear_combination<R> &
+column_store<R>::operator [] (unsigned i)
+{
+  if (column_block[i])
+    unspill (column_block[i]);
+  
+  pair<linear_combination<R> &, bool> p = columns.find (i);
+  if (!p.second)
+    {
+      p.first = linear_combination<R> (to);
+      n_dirty ++;
+    }
+  if (touched.size () == 0
+      || touched[touched.size ()] != i)
+    touched.append (i);
+  return p.first;
+}
+
+template<class R> linear_combination<R>
+column_store<R>::column (unsigned i) const
+{
+  unsigned b = column_block[i];
+  if (b)
+    {
+      if (!blocks[b].loaded)
+	load (b);
+      const_cast<column_store *> (this)->touch_block (b, blocks[b].nbytes);
+    }
+  
+  if (const linear_combination<R> *p = columns ^ i)
+    return *p;
+  return linear_combination<R> (to);
+}
+
+template<class R> basedvector<linear_combination<R>, 1>
+column_store<R>::explicit_columns () const
+{
+  assert (!on_disk ());
+  
+  basedvector<linear_combination<R>, 1> v (from->dim ());
+  for (unsigned i = 1; i <= from->dim (); i ++)
+    v[i] = column (i);
+  return v;
+}
+
+template<class R> void
+column_store<R>::update_dirty ()
+{
+  for (unsigned j = 1; j <= touched.size (); j ++)
+    {
+      unsigned i = touched[j];
+      if (column_block[i])
+	continue;
+  
+      unsigned c = columns[i].card ();
+      dirty_entries += c;
+      dirty_entries -= dirty_card[i];
+      dirty_card[i] = c;
+    }
+  touched.resize (0);
+}
+
+template<class R> void
+column_store<R>::spill ()
+{
+  update_dirty ();
+  if (n_dirty == 0)
+    return;
+  
+  if (f == 0)
+    f = new spill_file;
+  
+  map<int, basedvector<unsigned, 1> > degree_keys;
+  for (typename map<unsigned, linear_combination<R> >::const_iter i = columns; i; i ++)
+    {
+      unsigned k = i.key ();
+      if (column_block[k] == 0)
+	degree_keys[from->generator_grading (k).h].append (k);
+    }
+  
+  for (typename map<int, basedvector<unsigned, 1> >::const_iter i = degree_keys; i; i ++)
+    {
+      const basedvector<unsigned, 1> &keys = i.val ();
+      unsigned n = keys.size ();
+  
+      block bl;
+      uint64 entries = 0;
+      {
+	spill_writer w (f);
+	bl.offset = w.offset;
+  
+	w.write_unsigned (n);
+	w.write_increasing (&keys[1], n);
+	for (unsigned j = 1; j <= n; j ++)
+	  {
+	    const linear_combination<R> &c = columns[keys[j]];
+	    entries += c.card ();
+	    c.write_column (w);
+	  }
+      }
+      bl.size = f->size - bl.offset;
+      bl.nbytes = entries * entry_bytes + (uint64)n * column_bytes;
+      blocks.append (bl);
+  
+      unsigned b = blocks.size ();
+      for (unsigned j = 1; j <= n; j ++)
+	{
+	  column_block[keys[j]] = b;
+	  dirty_card[keys[j]] = 0;
+	  columns -= keys[j];
+	}
+    }
+  
+  n_dirty = 0;
+  dirty_entries = 0;
+}
+
+#endif // _KNOTKIT_ALGEBRA_COLUMN_STORE_H
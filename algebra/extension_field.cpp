@@ -0,0 +1,22 @@
+
+#include <algebra/algebra.h>
+
+unsigned extension_field<Z2>::k = 0;
+uint64 extension_field<Z2>::low = 0;
+
+void
+extension_field<Z2>::set_degree (unsigned min_k)
+{
+  /* Products must fit in 128 bits.  Past 61, a polynomial of degree
+     n vanishes at a random point with probability at most n / 2^61
+     rather than not at all. */
+  k = next_prime (std::min (min_k, max_degree ()));
+  
+  polynomial<Z2> f = irreducible_polynomial<Z2> (k);
+  low = 0;
+  for (unsigned e = 0; e < k; e ++)
+    {
+      if (f.coeff (e) != 0)
+	low |= (uint64)1 << e;
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef _KNOTKIT_ALGEBRA_EXTENSION_FIELD_H
+#define _KNOTKIT_ALGEBRA_EXTENSION_FIELD_H
+
+template<class F> struct field_characteristic;
+template<> struct field_characteristic<Z2> { static const unsigned p = 2; };
+template<unsigned p_> struct field_characteristic<Zp<p_> > { static const unsigned p = p_; };
+
+/* The finite field F[x]/(f), F = Z2 or Zp<p>, f irreducible of prime
+   degree k, so every element outside F generates the field.  f is
+   shared by all elements: call set_degree () once, before any
+   arithmetic; after that the field may be used from several threads.
+   Used as a field of evaluation points for the twisted complexes
+   over F(t), see twisted_evaluation.h. */
+template<class F>
+class extension_field
+{
+ public:
+  static unsigned k;
+  static polynomial<F> modulus;
+  
+ private:
+  polynomial<F> v;
+  
+ public:
+  extension_field () { }
+  extension_field (int x) : v(F (x)) { }
+  extension_field (F x) : v(x) { }
+  explicit extension_field (const polynomial<F> &v_) : v(v_.mod (modulus)) { }
+  extension_field (const extension_field &x) : v(x.v) { }
+  ~extension_field () { }
+  
+  extension_field &operator = (const extension_field &x) { v = x.v; return *this; }
+  extension_field &operator = (int x) { v = F (x); return *this; }
+  
+  // the largest degree set_degree () will give
+  static unsigned max_degree () { return ~0u; }
+  static void set_degree (unsigned min_k);
+  
+  bool operator == (const extension_field &x) const { return v == x.v; }
+  bool operator != (const extension_field &x) const { return !operator == (x); }
+  
+  bool operator == (int x) const { return v == polynomial<F> (F (x)); }
+  bool operator != (int x) const { return !operator == (x); }
+  
+  bool is_unit () const { return v != 0; }
+  extension_field recip () const;
+  
+  extension_field operator + (const extension_field &x) const { return extension_field (v + x.v, 0); }
+  extension_field operator - (const extension_field &x) const { return extension_field (v - x.v, 0); }
+  extension_field operator - () const { return extension_field (-v, 0); }
+  extension_field operator * (const extension_field &x) const { return extension_field (v * x.v); }
+  extension_field operator / (const extension_field &x) const { return operator * (x.recip ()); }
+  
+  extension_field &operator += (const extension_field &x) { v += x.v; return *this; }
+  extension_field &operator -= (const extension_field &x) { v -= x.v; return *this; }
+  extension_field &operator *= (const extension_field &x) { return operator = (*this * x); }
+  extension_field &operator /= (const extension_field &x) { return operator = (*this / x); }
+  
+  static void show_ring ()
+  {
+    printf ("GF(");
+    F::show_ring ();
+    printf ("^%d)", k);
+  }
+  void show_self () const { v.show_self (); }
+  void display_self () const { show_self (); newline (); }
+  
+ private:
+  // already reduced
+  extension_field (const polynomial<F> &v_, int) : v(v_) { }
+};
+
+template<class F> unsigned extension_field<F>::k = 0;
+template<class F> polynomial<F> extension_field<F>::modulus;
+
+template<class F> extension_field<F>
+extension_field<F>::recip () const
+{
+  assert (v != 0);
+  
+  // s v = r mod f
+  polynomial<F> r0 = modulus, s0 = 0,
+    r1 = v, s1 = 1;
+  while (r1 != 0)
+    {
+      polynomial<F> q, r;
+      dense_divide (r0, r1, q, r);
+      polynomial<F> s = s0 - q * s1;
+      r0 = r1; s0 = s1;
+      r1 = r; s1 = s;
+    }
+  assert (r0.deg () == 0);
+  s0 *= r0.coeff (0).recip ();
+  return extension_field (s0);
+}
+
+// the smallest prime >= max (n, 2)
+inline unsigned
+next_prime (unsigned n)
+{
+  for (unsigned d = std::max (n, 2u);; d ++)
+    {
+      bool prime = 1;
+      for (unsigned i = 2; i * i <= d; i ++)
+	{
+	  if (d % i == 0)
+	    {
+	      prime = 0;
+	      break;
+	    }
+	}
+      if (prime)
+	return d;
+    }
+}
+
+/* An irreducible monic polynomial over F of prime degree d.  f is
+   irreducible iff x^(p^d) = x mod f and x^p - x is prime to f.
+   Candidates x^d + g are tried with the coefficients of g the base p
+   digits of 1, 2, ... */
+template<class F> polynomial<F>
+irreducible_polynomial (unsigned d)
+{
+  unsigned p = field_characteristic<F>::p;
+  
+  polynomial<F> x (F (1), 1);
+  for (uint64 i = 1;; i ++)
+    {
+      polynomial<F> f (F (1), d);
+      uint64 j = i;
+      for (unsigned e = 0; j; e ++, j /= p)
+	f.add_term (F ((int)(j % p)), e);
+  
+      // y = x^(p^e) mod f
+      polynomial<F> y = x, xp;
+      for (unsigned e = 1; e <= d; e ++)
+	{
+	  polynomial<F> z = 1, b = y;
+	  for (unsigned m = p; m; m >>= 1)
+	    {
+	      if (m & 1)
+		z = (z * b).mod (f);
+	      b = (b * b).mod (f);
+	    }
+	  y = z;
+	  if (e == 1)
+	    xp = y;
+	}
+      if (y == x
+	  && (xp - x).gcd (f).deg () == 0)
+	return f;
+    }
+}
+
+template<class F> void
+extension_field<F>::set_degree (unsigned min_k)
+{
+  k = next_prime (min_k);
+  modulus = irreducible_polynomial<F> (k);
+}
+
+/* Over Z2, k <= 61 and an element is a word of bits, lowest degree
+   first.  The modulus is x^k + low. */
+template<>
+class extension_field<Z2>
+{
+ public:
+  static unsigned k;
+  static uint64 low;
+  
+ private:
+  uint64 v;
+  
+  extension_field (uint64 v_, int) : v(v_) { }
+  
+  static uint64 reduce (unsigned __int128 x)
+  {
+    // each fold lowers the degree, as deg low < k
+    while (x >> k)
+      x = (x & ((((uint64)1) << k) - 1)) ^ clmul ((uint64)(x >> k), low);
+    return (uint64)x;
+  }
+  
+ public:
+  extension_field () : v(0) { }
+  extension_field (int x) : v(x & 1) { }
+  extension_field (Z2 x) : v(x != 0) { }
+  explicit extension_field (const polynomial<Z2> &p)
+  {
+    v = 0;
+    for (int e = p.deg (); e >= 0; e --)
+      {
+	// v = v x + p_e
+	v = reduce ((unsigned __int128)v << 1) ^ (p.coeff (e) != 0);
+      }
+  }
+  extension_field (const extension_field &x) : v(x.v) { }
+  ~extension_field () { }
+  
+  extension_field &operator = (const extension_field &x) { v = x.v; return *this; }
+  extension_field &operator = (int x) { v = x & 1; return *this; }
+  
+  static unsigned max_degree () { return 61; }
+  static void set_degree (unsigned min_k);
+  
+  bool operator == (const extension_field &x) const { return v == x.v; }
+  bool operator != (const extension_field &x) const { return !operator == (x); }
+  
+  bool operator == (int x) const { return v == (uint64)(x & 1); }
+  bool operator != (int x) const { return !operator == (x); }
+  
+  bool is_unit () const { return v != 0; }
+  extension_field recip () const
+  {
+    assert (v != 0);
+  
+    // v^(2^k - 2)
+    extension_field r (1), b (*this);
+    for (unsigned i = 1; i < k; i ++)
+      {
+	b *= b;
+	r *= b;
+      }
+    return r;
+  }
+  
+  extension_field operator + (const extension_field &x) const { return extension_field (v ^ x.v, 0); }
+  extension_field operator - (const extension_field &x) const { return extension_field (v ^ x.v, 0); }
+  extension_field operator - () const { return *this; }
+  extension_field operator * (const extension_field &x) const
+  {
+    return extension_field (reduce (clmul (v, x.v)), 0);
+  }
+  extension_field operator / (const extension_field &x) const { return operator * (x.recip ()); }
+  
+  extension_field &operator += (const extension_field &x) { v ^= x.v; return *this; }
+  extension_field &operator -= (const extension_field &x) { v ^= x.v; return *this; }
+  extension_field &operator *= (const extension_field &x) { return operator = (*this * x); }
+  extension_field &operator /= (const extension_field &x) { return operator = (*this / x); }
+  
+  static void show_ring () { printf ("GF(2^%d)", k); }
+  void show_self () const { printf ("%llx", (unsigned long long)v); }
+  void display_self () const { show_self (); newline (); }
+};
+
+#endif // _KNOTKIT_ALGEBRA_EXTENSION_FIELD_H
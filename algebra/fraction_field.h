@@ -30,6 +30,7 @@ template<class T> class fraction_field
 #endif
   }
   
+  fraction_field (reader &r) : num(r), denom(r) { }
   fraction_field (const fraction_field &q) : num(q.num), denom(q.denom) { }
   fraction_field (copy, const fraction_field &q) : num(COPY, q.num), denom(COPY, q.denom) { }
   ~fraction_field () { }
@@ -204,6 +205,7 @@ template<class T> class fraction_field
   }
   
   static void show_ring () { printf ("fraction_field("); T::show_ring (); printf (")"); }
+  void write_self (writer &w) const { write (w, num); write (w, denom); }
   void show_self () const;
   void display_self () const { show_self (); newline (); }
 };
@@ -2,6 +2,65 @@
 #define _KNOTKIT_ALGEBRA_LINEAR_COMBINATIONS_H
 template<class R> class linear_combination_const_iter;
 
+/* coefficient blocks of linear_combination::write_column; Zp
+   coefficients are packed one byte each. */
+template<class R>
+class coeff_block
+{
+ public:
+  static void write (writer &w, const basedvector<R, 1> &cs)
+  {
+    for (unsigned i = 1; i <= cs.size (); i ++)
+      ::write (w, cs[i]);
+  }
+  
+  static basedvector<R, 1> read (reader &r, unsigned n)
+  {
+    basedvector<R, 1> cs (n);
+    for (unsigned i = 1; i <= n; i ++)
+      cs[i] = R (r);
+    return cs;
+  }
+};
+
+template<unsigned p>
+class coeff_block<Zp<p> >
+{
+ public:
+  static void write (writer &w, const basedvector<Zp<p>, 1> &cs)
+  {
+    unsigned n = cs.size ();
+    if (p > 256)
+      {
+	for (unsigned i = 1; i <= n; i ++)
+	  w.write_unsigned (cs[i].get_ui ());
+	return;
+      }
+    
+    std::vector<uint8> packed (n);
+    for (unsigned i = 1; i <= n; i ++)
+      packed[i - 1] = (uint8)cs[i].get_ui ();
+    w.write_raw (packed.data (), sizeof packed[0], n);
+  }
+  
+  static basedvector<Zp<p>, 1> read (reader &r, unsigned n)
+  {
+    basedvector<Zp<p>, 1> cs (n);
+    if (p > 256)
+      {
+	for (unsigned i = 1; i <= n; i ++)
+	  cs[i] = Zp<p> (r.read_unsigned ());
+	return cs;
+      }
+    
+    std::vector<uint8> packed (n);
+    r.read_raw (packed.data (), sizeof packed[0], n);
+    for (unsigned i = 1; i <= n; i ++)
+      cs[i] = Zp<p> ((unsigned)packed[i - 1]);
+    return cs;
+  }
+};
+
 template<class R>
 class linear_combination
 {
@@ -47,6 +106,21 @@ class linear_combination
     v = map<unsigned, R> (r);
   }
   
+  // reads a column written by write_column
+  linear_combination (ptr<const Rmod> m_, reader &r)
+    : m(m_)
+  {
+    unsigned n = r.read_unsigned ();
+    if (n == 0)
+      return;
+    
+    basedvector<unsigned, 1> keys (n);
+    r.read_increasing (&keys[1], n);
+    basedvector<R, 1> cs = coeff_block<R>::read (r, n);
+    for (unsigned i = 1; i <= n; i ++)
+      v.push (keys[i], cs[i]);
+  }
+  
   ~linear_combination () { }
   
   linear_combination &operator = (const linear_combination &lc)
@@ -179,6 +253,27 @@ class linear_combination
     write (w, v);
   }
   
+  /* bulk encoding without the module: delta coded support followed
+     by the coefficients (packed for Zp). */
+  void write_column (writer &w) const
+  {
+    unsigned n = v.card ();
+    w.write_unsigned (n);
+    if (n == 0)
+      return;
+    
+    basedvector<unsigned, 1> keys (n);
+    basedvector<R, 1> cs (n);
+    unsigned j = 1;
+    for (typename map<unsigned, R>::const_iter i = v; i; i ++, j ++)
+      {
+	keys[j] = i.key ();
+	cs[j] = i.val ();
+      }
+    w.write_increasing (&keys[1], n);
+    coeff_block<R>::write (w, cs);
+  }
+  
   void show_self () const;
   void display_self () const { show_self (); newline (); }
 };
@@ -357,6 +452,19 @@ class linear_combination<Z2>
     v = set<unsigned> (r);
   }
   
+  linear_combination (ptr<const Z2mod> m_, reader &r)
+    : m(m_)
+  {
+    unsigned n = r.read_unsigned ();
+    if (n == 0)
+      return;
+    
+    basedvector<unsigned, 1> keys (n);
+    r.read_increasing (&keys[1], n);
+    for (unsigned i = 1; i <= n; i ++)
+      v.push (keys[i]);
+  }
+  
   ~linear_combination () { }
   
   linear_combination &operator = (const linear_combination &lc)
@@ -473,6 +581,20 @@ class linear_combination<Z2>
     write (w, v);
   }
   
+  void write_column (writer &w) const
+  {
+    unsigned n = v.card ();
+    w.write_unsigned (n);
+    if (n == 0)
+      return;
+    
+    basedvector<unsigned, 1> keys (n);
+    unsigned j = 1;
+    for (set_const_iter<unsigned> i = v; i; i ++, j ++)
+      keys[j] = i.val ();
+    w.write_increasing (&keys[1], n);
+  }
+  
   void show_self () const;
   void display_self () const { show_self (); newline (); }
 };
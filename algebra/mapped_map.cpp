@@ -0,0 +1,263 @@
+
+#include <algebra/algebra.h>
+
+#include <unistd.h>
+
+static const char mapped_maps_magic[8] = { 'k', 'k', 'm', 'a', 'p', 's', 0, 0 };
+
+class mapped_maps_header
+{
+ public:
+  char magic[8];
+  unsigned version;
+  unsigned n_modules;
+  unsigned n_maps;
+  unsigned pad;
+};
+
+class mapped_module_entry
+{
+ public:
+  unsigned dim;
+  unsigned pad;
+  uint64 hq_offset;
+};
+
+class mapped_map_entry
+{
+ public:
+  unsigned from, to;
+  uint64 offsets_offset;
+  uint64 indices_offset;
+};
+
+static uint64
+align8 (uint64 x)
+{
+  return (x + 7) & ~(uint64)7;
+}
+
+static void
+put (FILE *fp, const std::string &file, const void *p, size_t nbytes)
+{
+  if (fwrite (p, 1, nbytes, fp) != nbytes)
+    {
+      stderror ("fwrite: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+}
+
+static void
+pad_to (FILE *fp, const std::string &file, uint64 &pos, uint64 to)
+{
+  static const char zeros[8] = { 0 };
+  assert (to >= pos && to - pos < 8);
+  put (fp, file, zeros, to - pos);
+  pos = to;
+}
+
+void
+write_mapped_maps (const std::string &file,
+		   basedvector<mod_map<Z2>, 1> maps)
+{
+  basedvector<ptr<const module<Z2> >, 1> modules;
+  basedvector<pair<unsigned, unsigned>, 1> map_modules (maps.size ());
+  
+  for (unsigned i = 1; i <= maps.size (); i ++)
+    {
+      ptr<const module<Z2> > ms[2] = { maps[i].domain (), maps[i].codomain () };
+      unsigned ks[2];
+      for (unsigned j = 0; j < 2; j ++)
+	{
+	  assert (ms[j]->is_free ());
+	  
+	  unsigned k = 1;
+	  while (k <= modules.size () && modules[k] != ms[j])
+	    k ++;
+	  if (k > modules.size ())
+	    modules.append (ms[j]);
+	  ks[j] = k;
+	}
+      map_modules[i] = pair<unsigned, unsigned> (ks[0], ks[1]);
+    }
+  
+  // layout
+  uint64 pos = sizeof (mapped_maps_header)
+    + modules.size () * sizeof (mapped_module_entry)
+    + maps.size () * sizeof (mapped_map_entry);
+  
+  basedvector<mapped_module_entry, 1> module_entries (modules.size ());
+  for (unsigned i = 1; i <= modules.size (); i ++)
+    {
+      mapped_module_entry &e = module_entries[i];
+      e.dim = modules[i]->dim ();
+      e.pad = 0;
+      e.hq_offset = pos = align8 (pos);
+      pos += (uint64)e.dim * 2 * sizeof (int);
+    }
+  
+  basedvector<mapped_map_entry, 1> map_entries (maps.size ());
+  for (unsigned i = 1; i <= maps.size (); i ++)
+    {
+      mapped_map_entry &e = map_entries[i];
+      e.from = map_modules[i].first;
+      e.to = map_modules[i].second;
+      
+      unsigned n = maps[i].domain ()->dim ();
+      uint64 total = 0;
+      for (unsigned j = 1; j <= n; j ++)
+	total += maps[i].column (j).card ();
+      
+      e.offsets_offset = pos = align8 (pos);
+      pos += (uint64)(n + 1) * sizeof (uint64);
+      e.indices_offset = pos = align8 (pos);
+      pos += total * sizeof (unsigned);
+    }
+  
+  // write to a temporary and rename, so readers never see a partial file
+  std::string tmp = file + ".tmp";
+  FILE *fp = open_file (tmp, "w");
+  
+  mapped_maps_header h;
+  memcpy (h.magic, mapped_maps_magic, sizeof h.magic);
+  h.version = mapped_maps_version;
+  h.n_modules = modules.size ();
+  h.n_maps = maps.size ();
+  h.pad = 0;
+  put (fp, tmp, &h, sizeof h);
+  for (unsigned i = 1; i <= modules.size (); i ++)
+    put (fp, tmp, &module_entries[i], sizeof (mapped_module_entry));
+  for (unsigned i = 1; i <= maps.size (); i ++)
+    put (fp, tmp, &map_entries[i], sizeof (mapped_map_entry));
+  
+  pos = sizeof (mapped_maps_header)
+    + modules.size () * sizeof (mapped_module_entry)
+    + maps.size () * sizeof (mapped_map_entry);
+  
+  for (unsigned i = 1; i <= modules.size (); i ++)
+    {
+      pad_to (fp, tmp, pos, module_entries[i].hq_offset);
+      for (unsigned j = 1; j <= modules[i]->dim (); j ++)
+	{
+	  grading hq = modules[i]->generator_grading (j);
+	  int v[2] = { hq.h, hq.q };
+	  put (fp, tmp, v, sizeof v);
+	  pos += sizeof v;
+	}
+    }
+  
+  for (unsigned i = 1; i <= maps.size (); i ++)
+    {
+      unsigned n = maps[i].domain ()->dim ();
+      
+      pad_to (fp, tmp, pos, map_entries[i].offsets_offset);
+      uint64 off = 0;
+      put (fp, tmp, &off, sizeof off);
+      for (unsigned j = 1; j <= n; j ++)
+	{
+	  off += maps[i].column (j).card ();
+	  put (fp, tmp, &off, sizeof off);
+	}
+      pos += (uint64)(n + 1) * sizeof (uint64);
+      
+      pad_to (fp, tmp, pos, map_entries[i].indices_offset);
+      for (unsigned j = 1; j <= n; j ++)
+	{
+	  for (linear_combination_const_iter<Z2> k = maps[i].column (j); k; k ++)
+	    {
+	      unsigned g = k.key ();
+	      put (fp, tmp, &g, sizeof g);
+	      pos += sizeof g;
+	    }
+	}
+    }
+  
+  if (fflush (fp) != 0
+      || fsync (fileno (fp)) != 0)
+    {
+      stderror ("fsync: %s", tmp.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  close_file (fp);
+  
+  if (rename (tmp.c_str (), file.c_str ()) != 0)
+    {
+      stderror ("rename: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+}
+
+mapped_map_impl::mapped_map_impl (ptr<const module<Z2> > from, ptr<const module<Z2> > to,
+				  ptr<mapped_file> f_,
+				  uint64 offsets_offset, uint64 indices_offset)
+  : map_impl<Z2>(from, to),
+    f(f_)
+{
+  unsigned n = from->dim ();
+  offsets = f->at<uint64> (offsets_offset, (uint64)n + 1);
+  indices = f->at<unsigned> (indices_offset, offsets[n]);
+}
+
+const linear_combination<Z2>
+mapped_map_impl::column (unsigned i) const
+{
+  const unsigned *p;
+  unsigned n = column_support (i, p);
+  
+  linear_combination<Z2> r (to);
+  for (unsigned j = 0; j < n; j ++)
+    r.muladd (1, p[j]);
+  return r;
+}
+
+mapped_maps::mapped_maps (const std::string &file)
+  : f(new mapped_file (file))
+{
+  const mapped_maps_header *h = f->at<mapped_maps_header> (0);
+  if (memcmp (h->magic, mapped_maps_magic, sizeof h->magic) != 0)
+    {
+      fprintf (stderr, "%s: not a mapped map file\n", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  if (h->version != mapped_maps_version)
+    {
+      fprintf (stderr, "%s: unsupported version %d (expected %d)\n",
+	       file.c_str (), h->version, mapped_maps_version);
+      exit (EXIT_FAILURE);
+    }
+  
+  uint64 pos = sizeof (mapped_maps_header);
+  const mapped_module_entry *module_entries
+    = f->at<mapped_module_entry> (pos, h->n_modules);
+  pos += h->n_modules * sizeof (mapped_module_entry);
+  const mapped_map_entry *map_entries
+    = f->at<mapped_map_entry> (pos, h->n_maps);
+  
+  modules.resize (h->n_modules);
+  for (unsigned i = 1; i <= h->n_modules; i ++)
+    {
+      const mapped_module_entry &e = module_entries[i - 1];
+      const int *v = f->at<int> (e.hq_offset, (uint64)e.dim * 2);
+      
+      basedvector<grading, 1> hq (e.dim);
+      for (unsigned j = 1; j <= e.dim; j ++)
+	hq[j] = grading (v[2 * (j - 1)], v[2 * (j - 1) + 1]);
+      modules[i] = new explicit_module<Z2> (e.dim, basedvector<Z2, 1> (), hq);
+    }
+  
+  maps.resize (h->n_maps);
+  for (unsigned i = 1; i <= h->n_maps; i ++)
+    {
+      const mapped_map_entry &e = map_entries[i - 1];
+      if (e.from < 1 || e.from > modules.size ()
+	  || e.to < 1 || e.to > modules.size ())
+	{
+	  fprintf (stderr, "%s: corrupt map table\n", file.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+      
+      maps[i] = mod_map<Z2> (mod_map<Z2>::IMPL,
+			     new mapped_map_impl (modules[e.from], modules[e.to],
+						  f, e.offsets_offset, e.indices_offset));
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _KNOTKIT_ALGEBRA_MAPPED_MAP_H
+#define _KNOTKIT_ALGEBRA_MAPPED_MAP_H
+
+/* Versioned, uncompressed container for mod_map<Z2>s (differentials,
+   sq1/sq2) that is used in place through mmap: columns are read from
+   the offset and index arrays of the mapping on demand, nothing is
+   deserialized on open.
+
+   Layout (native byte order, all arrays 8-byte aligned):
+
+     header        magic "kkmaps\0\0", unsigned version, n_modules,
+                   n_maps, 0
+     modules       n_modules x { unsigned dim, 0, uint64 hq_offset }
+     maps          n_maps x { unsigned from, to, uint64 offsets_offset,
+                   indices_offset }
+     hq            dim x { int h, q } per module
+     offsets       from_dim + 1 uint64s per map, into indices
+     indices       unsigned generator indices, sorted within a column
+
+   Modules are free and shared between maps: a map with from == to
+   (a differential) is reopened as an endomorphism. */
+
+static const unsigned mapped_maps_version = 1;
+
+extern void write_mapped_maps (const std::string &file,
+			       basedvector<mod_map<Z2>, 1> maps);
+
+class mapped_map_impl : public map_impl<Z2>
+{
+  ptr<mapped_file> f;
+  const uint64 *offsets;
+  const unsigned *indices;
+  
+ public:
+  mapped_map_impl (ptr<const module<Z2> > from, ptr<const module<Z2> > to,
+		   ptr<mapped_file> f_, uint64 offsets_offset, uint64 indices_offset);
+  ~mapped_map_impl () { }
+  
+  // the support of column i, in place
+  unsigned column_support (unsigned i, const unsigned *&p) const
+  {
+    assert (i >= 1 && i <= from->dim ());
+    p = indices + offsets[i - 1];
+    return (unsigned)(offsets[i] - offsets[i - 1]);
+  }
+  
+  const linear_combination<Z2> column (unsigned i) const;
+};
+
+class mapped_maps
+{
+  ptr<mapped_file> f;
+  basedvector<ptr<const module<Z2> >, 1> modules;
+  basedvector<mod_map<Z2>, 1> maps;
+  
+ public:
+  mapped_maps (const std::string &file);
+  mapped_maps (const mapped_maps &) = delete;
+  ~mapped_maps () { }
+  
+  mapped_maps &operator = (const mapped_maps &) = delete;
+  
+  unsigned n_maps () const { return maps.size (); }
+  mod_map<Z2> map (unsigned i) const { return maps[i]; }
+};
+
+#endif // _KNOTKIT_ALGEBRA_MAPPED_MAP_H
@@ -17,19 +17,46 @@ class module : public refcounted
  private:
   friend class reader;
   friend class writer;
+  friend class direct_sum<R>;
+  friend class tensor_product<R>;
+  friend class hom_module<R>;
   
   unsigned id;
   
   static unsigned id_counter;
   
+  /* modules read by a reader, kept alive for the lifetime of that
+     reader (see reader::read_mod). */
   static map<unsigned, ptr<const module<R> > > reader_id_module;
   
+  /* The direct sum, tensor product and hom caches hold weak
+     references: an entry is removed by the destructor of the module
+     it points to, so the caches never pin dead modules. */
   static map<basedvector<unsigned, 1>,
-    ptr<const direct_sum<R> > > direct_sum_idx;
+    const direct_sum<R> *> direct_sum_idx;
   static map<basedvector<unsigned, 1>,
-    ptr<const tensor_product<R> > > tensor_product_idx;
+    const tensor_product<R> *> tensor_product_idx;
   static map<pair<unsigned, unsigned>,
-    ptr<const hom_module<R> > > hom_module_idx;
+    const hom_module<R> *> hom_module_idx;
+  
+  static basedvector<unsigned, 1>
+    module_ids (const basedvector<ptr<const module<R> >, 1> &ms)
+  {
+    basedvector<unsigned, 1> ids (ms.size ());
+    for (unsigned i = 1; i <= ms.size (); i ++)
+      ids[i] = ms[i]->id;
+    return ids;
+  }
+  
+  template<class K, class M> static void
+    unregister (map<K, const M *> &idx, const K &k, const M *m)
+  {
+    const M **p = idx ^ k;
+    if (p && *p == m)
+      idx -= k;
+  }
+  
+  static void release_reader_id (unsigned id) { reader_id_module -= id; }
   
  public:
   module ()
@@ -88,6 +115,7 @@ class module : public refcounted
   ptr<const free_submodule<R> > submodule (const mod_span<R> &span) const;
 
   multivariate_laurentpoly<Z> free_poincare_polynomial () const;
+  bivariate_laurentpoly free_poincare_bivariate () const;
   template<unsigned p>
   multivariate_laurentpoly<Zp<p>> free_poincare_polynomial () const;
   multivariate_laurentpoly<Z> free_delta_poincare_polynomial () const;
@@ -165,6 +193,8 @@ class module : public refcounted
   void write_self (writer &w) const { w.write_mod<R> (this); }
   void show_self () const;
   void display_self () const;
+  
+  static void show_registry_stats ();
 };
 
 template<class R> unsigned module<R>::id_counter = 0;
@@ -172,13 +202,23 @@ template<class R> unsigned module<R>::id_counter = 0;
 template<class R> map<unsigned, ptr<const module<R> > > module<R>::reader_id_module;
 
 template<class R> map<basedvector<unsigned, 1>,
-  ptr<const direct_sum<R> > > module<R>::direct_sum_idx;
+  const direct_sum<R> *> module<R>::direct_sum_idx;
 
 template<class R> map<basedvector<unsigned, 1>,
-  ptr<const tensor_product<R> > > module<R>::tensor_product_idx;
+  const tensor_product<R> *> module<R>::tensor_product_idx;
 
 template<class R> map<pair<unsigned, unsigned>,
-  ptr<const hom_module<R> > > module<R>::hom_module_idx;
+  const hom_module<R> *> module<R>::hom_module_idx;
+
+template<class R> void
+module<R>::show_registry_stats ()
+{
+  fprintf (stderr, "module registries: %d direct sums, %d tensor products, %d homs, %d read\n",
+	   direct_sum_idx.card (),
+	   tensor_product_idx.card (),
+	   hom_module_idx.card (),
+	   reader_id_module.card ());
+}
 
 template<class R>
 class direct_sum : public module<R>
@@ -199,7 +239,11 @@ class direct_sum : public module<R>
     for (unsigned i = 1; i <= summands.size (); i ++)
       n += summands[i]->dim ();
   }
-  ~direct_sum () { }
+  ~direct_sum ()
+  {
+    module<R>::unregister (module<R>::direct_sum_idx,
+			   module<R>::module_ids (summands), this);
+  }
   
   unsigned dim () const { return n; }
   unsigned free_rank () const { return n; }
@@ -271,14 +315,13 @@ module<R>::add (basedvector<ptr<const module<R> >, 1> compound_summands) const
   for (unsigned i = 1; i <= compound_summands.size (); i ++)
     compound_summands[i]->append_direct_summands (summands);
   
-  basedvector<unsigned, 1> summand_ids (summands.size ());
-  for (unsigned i = 1; i <= summands.size (); i ++)
-    summand_ids[i] = summands[i]->id;
+  pair<const direct_sum<R> *&, bool> p = direct_sum_idx.find (module_ids (summands));
+  if (p.second)
+    return p.first;
   
-  pair<ptr<const direct_sum<R> > &, bool> p = direct_sum_idx.find (summand_ids);
-  if (!p.second)
-    p.first = new direct_sum<R> (summands);
-  return p.first;
+  ptr<const direct_sum<R> > s = new direct_sum<R> (summands);
+  p.first = s.get ();
+  return s;
 }
 
 template<class R>
@@ -302,7 +345,11 @@ class tensor_product : public module<R>
     for (unsigned i = 1; i <= factors.size (); i ++)
       n *= factors[i]->dim ();
   }
-  ~tensor_product () { }
+  ~tensor_product ()
+  {
+    module<R>::unregister (module<R>::tensor_product_idx,
+			   module<R>::module_ids (factors), this);
+  }
   
   unsigned dim () const { return n; }
   unsigned free_rank () const { return n; }
@@ -327,14 +374,13 @@ module<R>::tensor (basedvector<ptr<const module<R> >, 1> compound_factors)
   for (unsigned i = 1; i <= compound_factors.size (); i ++)
     compound_factors[i]->append_tensor_factors (factors);
   
-  basedvector<unsigned, 1> factor_ids (factors.size ());
-  for (unsigned i = 1; i <= factors.size (); i ++)
-    factor_ids[i] = factors[i]->id;
+  pair<const tensor_product<R> *&, bool> p = tensor_product_idx.find (module_ids (factors));
+  if (p.second)
+    return p.first;
   
-  pair<ptr<const tensor_product<R> > &, bool> p = tensor_product_idx.find (factor_ids);
-  if (!p.second)
-    p.first = new tensor_product<R> (factors);
-  return p.first;
+  ptr<const tensor_product<R> > t = new tensor_product<R> (factors);
+  p.first = t.get ();
+  return t;
 }
 
 template<class R> grading
@@ -418,7 +464,11 @@ class hom_module : public module<R>
 	    && to->is_free ());
     n = from->dim () * to->dim ();
   }
-  ~hom_module () { }
+  ~hom_module ()
+  {
+    module<R>::unregister (module<R>::hom_module_idx,
+			   pair<unsigned, unsigned> (from->id, to->id), this);
+  }
   
   // e_ij -> ij
   pair<unsigned, unsigned> generator_indices (unsigned g) const
@@ -454,11 +504,14 @@ class hom_module : public module<R>
 template<class R> ptr<const hom_module<R> >
 module<R>::hom (ptr<const module<R> > to) const
 {
-  pair<ptr<const hom_module<R> > &, bool> p = hom_module_idx.find (pair<unsigned, unsigned>
-								   (id, to->id));
-  if (!p.second)
-    p.first = new hom_module<R> (this, to);
-  return p.first;
+  pair<const hom_module<R> *&, bool> p = hom_module_idx.find (pair<unsigned, unsigned>
+							      (id, to->id));
+  if (p.second)
+    return p.first;
+  
+  ptr<const hom_module<R> > h = new hom_module<R> (this, to);
+  p.first = h.get ();
+  return h;
 }
 
 template<class R> grading
@@ -797,6 +850,9 @@ class tensor_impl : public map_impl<R>
   }
 };
 
+template<class R> class column_store;
+template<class R> class spilled_map_impl;
+
 template<class R>
 class map_builder
 {
@@ -804,6 +860,9 @@ class map_builder
   ptr<const module<R> > from, to;
   basedvector<linear_combination<R>, 1> columns;
   
+  // out of core (spill_budget set): the columns live in store
+  ptr<column_store<R> > store;
+  
   void init ();
   
  public:
@@ -827,13 +886,37 @@ class map_builder
     init ();
   }
   
-  linear_combination<R> &operator [] (unsigned i) { return columns[i]; }
-  const linear_combination<R> &operator [] (unsigned i) const { return columns[i]; }
+  linear_combination<R> &operator [] (unsigned i)
+  {
+    if (store != 0)
+      return (*store)[i];
+    return columns[i];
+  }
+  const linear_combination<R> operator [] (unsigned i) const
+  {
+    if (store != 0)
+      return store->column (i);
+    return columns[i];
+  }
+  
+  /* out of core, writes the columns built so far to disk if they
+     exceed the budget */
+  void spill_if_needed ()
+  {
+    if (store != 0)
+      store->spill_if_needed ();
+  }
 };
 
 template<class R> void
 map_builder<R>::init ()
 {
+  if (spill_budget)
+    {
+      store = new column_store<R> (from, to);
+      return;
+    }
+  
   columns.resize (from->dim ());
   for (unsigned i = 1; i <= from->dim (); i ++)
     columns[i] = linear_combination<R> (to);
@@ -842,14 +925,16 @@ map_builder<R>::init ()
 template<class R>
 class mod_map
 {
+ public:
   // ???
   enum impl_ctor { IMPL };
-
+  
+ private:
   ptr<const map_impl<R> > impl;
   
+ public:
   mod_map (impl_ctor, ptr<const map_impl<R> > impl_) : impl(impl_) { }
   
- public:
   mod_map () { }
   mod_map (const mod_map &m) : impl(m.impl) { }
   
@@ -879,15 +964,40 @@ class mod_map
     : impl(new explicit_map_impl<R> (from, to, columns))
   { }
   mod_map (const map_builder<R> &b)
-    : impl(new explicit_map_impl<R> (b.from, b.to, b.columns))
-  { }
+  {
+    if (b.store == 0)
+      impl = new explicit_map_impl<R> (b.from, b.to, b.columns);
+    else if (b.store->on_disk ())
+      {
+	b.store->spill ();
+	impl = new spilled_map_impl<R> (b.store);
+      }
+    else
+      impl = new explicit_map_impl<R> (b.from, b.to, b.store->explicit_columns ());
+  }
   
   mod_map (reader &r)
   {
-    ptr<const module<R> > from = r.read_mod<R> ();
-    ptr<const module<R> > to = r.read_mod<R> ();
-    basedvector<linear_combination<R>, 1> columns (r);
-    impl = new explicit_map_impl<R> (from, to, columns);
+    /* A leading 0, which is never a module io id, marks the bulk
+       column encoding written by write_self.  Older dumps start
+       directly with the domain. */
+    int io_id = r.read_int ();
+    if (io_id == 0)
+      {
+	ptr<const module<R> > from = r.read_mod<R> ();
+	ptr<const module<R> > to = r.read_mod<R> ();
+	basedvector<linear_combination<R>, 1> columns (from->dim ());
+	for (unsigned i = 1; i <= from->dim (); i ++)
+	  columns[i] = linear_combination<R> (to, r);
+	impl = new explicit_map_impl<R> (from, to, columns);
+      }
+    else
+      {
+	ptr<const module<R> > from = r.read_mod<R> (io_id);
+	ptr<const module<R> > to = r.read_mod<R> ();
+	basedvector<linear_combination<R>, 1> columns (r);
+	impl = new explicit_map_impl<R> (from, to, columns);
+      }
   }
   
   ~mod_map () { }
@@ -987,10 +1097,12 @@ class mod_map
   
   void write_self (writer &w) const
   {
-    // write explicitly
+    // write explicitly, columns in bulk
+    w.write_int (0);
     write (w, *impl->from);
     write (w, *impl->to);
-    write (w, explicit_columns ());
+    for (unsigned i = 1; i <= impl->from->dim (); i ++)
+      column (i).write_column (w);
   }
   
   void show_self () const;
@@ -1467,14 +1579,33 @@ module<R>::submodule (const mod_span<R> &span) const
 template<class R> multivariate_laurentpoly<Z>
 module<R>::free_poincare_polynomial () const
 {
-  multivariate_laurentpoly<Z> r;
-  for (unsigned i = 1; i <= free_rank (); i ++)
+  return free_poincare_bivariate ().multivariate ();
+}
+
+template<class R> bivariate_laurentpoly
+module<R>::free_poincare_bivariate () const
+{
+  bivariate_laurentpoly r;
+  unsigned n = free_rank ();
+  if (n == 0)
+    return r;
+  
+  grading lo = generator_grading (1),
+    hi = lo;
+  for (unsigned i = 2; i <= n; i ++)
     {
       grading hq = generator_grading (i);
-      multivariate_laurent_monomial m;
-      m.push_exponent (1, hq.h);
-      m.push_exponent (2, hq.q);
-      r.muladdeq (1, m);
+      lo.h = std::min (lo.h, hq.h);
+      lo.q = std::min (lo.q, hq.q);
+      hi.h = std::max (hi.h, hq.h);
+      hi.q = std::max (hi.q, hq.q);
+    }
+  
+  r.extend (lo.h, hi.h, lo.q, hi.q);
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      grading hq = generator_grading (i);
+      r.c[(hq.h - lo.h) * r.qwidth + (hq.q - lo.q)] ++;
     }
   return r;
 }
@@ -2123,7 +2254,13 @@ writer::write_mod (ptr<const module<R> > m)
 template<class R> ptr<const module<R> > 
 reader::read_mod ()
 {
-  int io_id = read_int ();
+  return read_mod<R> (read_int ());
+}
+
+template<class R> ptr<const module<R> > 
+reader::read_mod (int io_id)
+{
+  assert (io_id != 0);
   if (io_id < 0)
     {
       unsigned n = read_unsigned ();
@@ -2138,6 +2275,8 @@ reader::read_mod ()
       ptr<const module<R> > m = new explicit_module<R> (r, ann, gr);
       ar->io_id_id.push ((unsigned)(-io_id), m->id);
       module<R>::reader_id_module.push (m->id, m);
+      ar->release_ids.append (pair<void (*) (unsigned), unsigned>
+			      (&module<R>::release_reader_id, m->id));
       
       return m;
     }
@@ -1,109 +1,257 @@
 
 #include <knotkit.h>
 
-polynomial<Z2>
-polynomial<Z2>::operator * (polynomial<Z2> p) const
+/* Carry-less multiplication of 64-bit words in software, four bits
+   of a at a time from a table of the multiples of b. */
+unsigned __int128
+clmul (uint64 a, uint64 b)
 {
-  set<unsigned> r_coeffs;
+  unsigned __int128 t[16];
+  t[0] = 0;
+  t[1] = b;
+  for (unsigned i = 2; i < 16; i += 2)
+    {
+      t[i] = t[i / 2] << 1;
+      t[i + 1] = t[i] ^ b;
+    }
+  
+  unsigned __int128 r = 0;
+  for (int s = 60; s >= 0; s -= 4)
+    r = (r << 4) ^ t[(a >> s) & 0xf];
+  return r;
+}
+
+static const unsigned karatsuba_words = 16;
+
+// r[0, na + nb) ^= a b
+static void
+mul_words (const uint64 *a, unsigned na,
+	   const uint64 *b, unsigned nb,
+	   uint64 *r)
+{
+  if (na < nb)
+    {
+      std::swap (a, b);
+      std::swap (na, nb);
+    }
+  
+  if (nb < karatsuba_words)
+    {
+      for (unsigned i = 0; i < na; i ++)
+	{
+	  if (a[i] == 0)
+	    continue;
+	  for (unsigned j = 0; j < nb; j ++)
+	    {
+	      unsigned __int128 x = clmul (a[i], b[j]);
+	      r[i + j] ^= (uint64)x;
+	      r[i + j + 1] ^= (uint64)(x >> 64);
+	    }
+	}
+      return;
+    }
+  
+  if (na > nb)
+    {
+      for (unsigned i = 0; i < na; i += nb)
+	mul_words (a + i, std::min (nb, na - i), b, nb, r + i);
+      return;
+    }
+  
+  // a = a0 + x^64h a1, b = b0 + x^64h b1
+  unsigned h = na / 2,
+    n1 = na - h;
+  std::vector<uint64> sa (n1), sb (n1);
+  for (unsigned i = 0; i < n1; i ++)
+    {
+      sa[i] = a[h + i] ^ (i < h ? a[i] : 0);
+      sb[i] = b[h + i] ^ (i < h ? b[i] : 0);
+    }
   
-  for (set_const_iter<unsigned> i = coeffs; i; i ++)
-    for (set_const_iter<unsigned> j = p.coeffs; j; j ++)
-      r_coeffs.toggle (i.val () + j.val ());
+  std::vector<uint64> z0 (2 * h, 0),
+    z2 (2 * n1, 0),
+    zm (2 * n1, 0);
+  mul_words (a, h, b, h, &z0[0]);
+  mul_words (a + h, n1, b + h, n1, &z2[0]);
+  mul_words (&sa[0], n1, &sb[0], n1, &zm[0]);
   
-  return polynomial<Z2> (r_coeffs);
+  // zm + z0 + z2 is the middle term
+  for (unsigned k = 0; k < z0.size (); k ++)
+    {
+      r[k] ^= z0[k];
+      zm[k] ^= z0[k];
+    }
+  for (unsigned k = 0; k < z2.size (); k ++)
+    {
+      r[2 * h + k] ^= z2[k];
+      zm[k] ^= z2[k];
+    }
+  for (unsigned k = 0; k < zm.size (); k ++)
+    r[h + k] ^= zm[k];
 }
 
-pair<polynomial<Z2>, polynomial<Z2> > 
-polynomial<Z2>::divide_with_remainder (polynomial d) const
+// r ^= x^s p
+static void
+xor_shifted (std::vector<uint64> &r, const std::vector<uint64> &p, unsigned s)
 {
-  assert (d != 0);
+  unsigned ws = s / 64,
+    bs = s % 64;
+  for (unsigned i = 0; i < p.size (); i ++)
+    {
+      r[i + ws] ^= p[i] << bs;
+      if (bs && i + ws + 1 < r.size ())
+	r[i + ws + 1] ^= p[i] >> (64 - bs);
+    }
+}
+
+polynomial<Z2> &
+polynomial<Z2>::operator += (const polynomial &p)
+{
+  if (w.size () < p.w.size ())
+    w.resize (p.w.size (), 0);
+  for (unsigned i = 0; i < p.w.size (); i ++)
+    w[i] ^= p.w[i];
+  trim ();
+  return *this;
+}
+
+polynomial<Z2>
+polynomial<Z2>::operator * (const polynomial &p) const
+{
+  polynomial<Z2> r;
+  if (w.empty () || p.w.empty ())
+    return r;
   
-  polynomial<Z2> r (COPY, *this);
-  polynomial<Z2> q;
+  r.w.assign (w.size () + p.w.size (), 0);
+  mul_words (&w[0], w.size (), &p.w[0], p.w.size (), &r.w[0]);
+  r.trim ();
+  return r;
+}
   
-  unsigned d_leading_exponent = d.coeffs.tail ();
-  for (;;)
+polynomial<Z2>
+polynomial<Z2>::low (unsigned n) const
+{
+  polynomial<Z2> r;
+  unsigned nw = (n + 63) / 64;
+  if (nw >= w.size ())
     {
-      if (r == 0)
-	break;
-      
-      unsigned r_leading_exponent = r.coeffs.tail ();
-      if (r_leading_exponent < d_leading_exponent)
-	break;
-      
-      for (set_const_iter<unsigned> i = d.coeffs; i; i ++)
-	r.coeffs.toggle (r_leading_exponent - d_leading_exponent + i.val ());
-      q.coeffs.toggle (r_leading_exponent - d_leading_exponent);
+      r.w = w;
+      return r;
     }
   
-  assert (r == 0 || r.degree () < d.degree ());
-  // assert (*this == q*d + r);
+  r.w.assign (w.begin (), w.begin () + nw);
+  if (n % 64)
+    r.w.back () &= ((uint64)1 << (n % 64)) - 1;
+  r.trim ();
+  return r;
+}
+
+polynomial<Z2>
+polynomial<Z2>::high (unsigned n) const
+{
+  polynomial<Z2> r;
+  unsigned ws = n / 64,
+    bs = n % 64;
+  if (ws >= w.size ())
+    return r;
   
-  return pair<polynomial<Z2>, polynomial<Z2> > (q, r);
+  r.w.assign (w.size () - ws, 0);
+  for (unsigned i = ws; i < w.size (); i ++)
+    {
+      r.w[i - ws] = w[i] >> bs;
+      if (bs && i + 1 < w.size ())
+	r.w[i - ws] |= w[i + 1] << (64 - bs);
+    }
+  r.trim ();
+  return r;
 }
 
 polynomial<Z2>
-polynomial<Z2>::mod (polynomial d) const
+polynomial<Z2>::reversed (unsigned n) const
+{
+  assert (deg () <= (int)n);
+  
+  polynomial<Z2> r;
+  r.w.assign (n / 64 + 1, 0);
+  for (unsigned i = 0; i < w.size (); i ++)
+    {
+      uint64 x = w[i];
+      while (x)
+	{
+	  unsigned e = 64 * i + __builtin_ctzll (x);
+	  x &= x - 1;
+	  r.w[(n - e) / 64] |= (uint64)1 << ((n - e) % 64);
+	}
+    }
+  r.trim ();
+  return r;
+}
+
+void
+polynomial<Z2>::slow_divide (const polynomial &d, polynomial &q, polynomial &r) const
 {
   assert (d != 0);
   
-  polynomial<Z2> r (COPY, *this);
+  int m = d.deg ();
+  r = *this;
+  q = polynomial<Z2> ();
+  if (deg () < m)
+    return;
   
-  unsigned d_leading_exponent = d.coeffs.tail ();
-  for (;;)
+  q.w.assign ((deg () - m) / 64 + 1, 0);
+  for (int e = deg (); e >= m; e --)
     {
-      if (r == 0)
-	break;
+      if (! ((r.w[e / 64] >> (e % 64)) & 1))
+	continue;
       
-      unsigned r_leading_exponent = r.coeffs.tail ();
-      if (r_leading_exponent < d_leading_exponent)
-	break;
-      
-      for (set_const_iter<unsigned> i = d.coeffs; i; i ++)
-	r.coeffs.toggle (r_leading_exponent - d_leading_exponent + i.val ());
+      q.w[(e - m) / 64] |= (uint64)1 << ((e - m) % 64);
+      xor_shifted (r.w, d.w, e - m);
     }
+  q.trim ();
+  r.trim ();
+}
+
+pair<polynomial<Z2>, polynomial<Z2> > 
+polynomial<Z2>::divide_with_remainder (const polynomial &d) const
+{
+  assert (d != 0);
+  
+  polynomial<Z2> q, r;
+  dense_divide (*this, d, q, r);
   
   assert (r == 0 || r.degree () < d.degree ());
   
-  return r;
+  return pair<polynomial<Z2>, polynomial<Z2> > (q, r);
+}
+
+polynomial<Z2>
+polynomial<Z2>::mod (const polynomial &d) const
+{
+  return divide_with_remainder (d).second;
 }
 
 bool
-polynomial<Z2>::divides (polynomial d) const
+polynomial<Z2>::divides (const polynomial &d) const
 {
   return mod (d) == 0;
 }
   
 polynomial<Z2>
-polynomial<Z2>::divide_exact (polynomial d) const
+polynomial<Z2>::divide_exact (const polynomial &d) const
 {
   pair<polynomial<Z2>, polynomial<Z2> > qr = divide_with_remainder (d);
   assert (qr.second == 0);
   return qr.first;
 }
   
-polynomial<Z2>
-polynomial<Z2>::gcd (polynomial b) const
-{
-  // ??? can return *this
-  polynomial a = *this;
-  
-  while (b != 0)
-    {
-      pair<polynomial<Z2>, polynomial<Z2> > a_qr = a.divide_with_remainder (b);
-      a = b;
-      b = a_qr.second;
-    }
-  return a;
-}
-
 void
 polynomial<Z2>::show_self () const
 {
   unsigned first = 1;
-  for (set_const_iter<unsigned> i = coeffs; i; i ++)
+  for (unsigned e = 0; (int)e <= deg (); e ++)
     {
-      unsigned e = i.val ();
+      if (coeff (e) == 0)
+	continue;
       
       if (first)
 	first = 0;
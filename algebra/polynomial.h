@@ -386,78 +386,229 @@ polynomial<T>::show_self () const
     printf ("0");
 }
 
+/* Fast algorithms for the dense polynomials over fields below.  P
+   provides deg () (-1 for 0), coeff (e), low (n) (mod x^n), high (n)
+   (div x^n), reversed (n) (x^n P(1/x), deg <= n), monic (),
+   slow_divide (d, q, r) and the ring operations, and fast_threshold,
+   the degree from which the fast algorithms pay off. */
+
+// the inverse of the power series f mod x^n, f(0) != 0
+template<class P> P
+dense_inverse_series (const P &f, unsigned n)
+{
+  P g (f.coeff (0).recip ());
+  for (unsigned k = 1; k < n;)
+    {
+      k = std::min (2 * k, n);
+      // Newton: g = g (2 - f g) mod x^k
+      P e = (f.low (k) * g).low (k);
+      g = (g * (P (2) - e)).low (k);
+    }
+  return g;
+}
+
+template<class P> void
+dense_divide (const P &a, const P &b, P &q, P &r)
+{
+  int n = a.deg (),
+    m = b.deg ();
+  assert (m >= 0);
+  if (n < m)
+    {
+      q = 0;
+      r = a;
+      return;
+    }
+  if (m < P::fast_threshold || n - m < P::fast_threshold)
+    {
+      a.slow_divide (b, q, r);
+      return;
+    }
+  
+  // reversed, the quotient is a power series quotient
+  unsigned k = n - m + 1;
+  P inv = dense_inverse_series (b.reversed (m), k);
+  q = (a.reversed (n).low (k) * inv).low (k).reversed (k - 1);
+  r = a - q * b;
+}
+
+// [[a, b], [c, d]]
+template<class P>
+class dense_matrix
+{
+ public:
+  P a, b, c, d;
+  
+ public:
+  dense_matrix () : a(1), b(0), c(0), d(1) { }
+  dense_matrix (const P &a_, const P &b_, const P &c_, const P &d_)
+    : a(a_), b(b_), c(c_), d(d_)
+  { }
+  
+  dense_matrix operator * (const dense_matrix &m) const
+  {
+    return dense_matrix (a * m.a + b * m.c, a * m.b + b * m.d,
+			 c * m.a + d * m.c, c * m.b + d * m.d);
+  }
+  
+  // (x, y) = M (x, y)
+  void apply (P &x, P &y) const
+  {
+    P x2 = a * x + b * y;
+    y = c * x + d * y;
+    x = x2;
+  }
+};
+
+/* The half-gcd: M with (c, d) = M (a, b) consecutive remainders in
+   the Euclidean algorithm for a, b and deg c >= ceil (deg a / 2) >
+   deg d.  Quotients depend only on the top coefficients, so the
+   first half of them comes from the top half of a and b, and the
+   rest from the top half of what is left. */
+template<class P> dense_matrix<P>
+dense_half_gcd (const P &a, const P &b)
+{
+  assert (a.deg () > b.deg ());
+  
+  int m = (a.deg () + 1) / 2;
+  if (b.deg () < m)
+    return dense_matrix<P> ();
+  
+  P c = a,
+    d = b;
+  if (a.deg () < P::fast_threshold)
+    {
+      dense_matrix<P> M;
+      while (d.deg () >= m)
+	{
+	  P q, r;
+	  dense_divide (c, d, q, r);
+	  M = dense_matrix<P> (0, 1, 1, -q) * M;
+	  c = d;
+	  d = r;
+	}
+      return M;
+    }
+  
+  dense_matrix<P> R = dense_half_gcd (a.high (m), b.high (m));
+  R.apply (c, d);
+  if (d.deg () < m)
+    return R;
+  
+  P q, r;
+  dense_divide (c, d, q, r);
+  dense_matrix<P> Q (0, 1, 1, -q);
+  c = d;
+  d = r;
+  if (d.deg () < m)
+    return Q * R;
+  
+  int k = 2 * m - c.deg ();
+  return dense_half_gcd (c.high (k), d.high (k)) * (Q * R);
+}
+
+// monic gcd
+template<class P> P
+dense_gcd (P a, P b)
+{
+  if (a.deg () < b.deg ())
+    std::swap (a, b);
+  while (b != 0)
+    {
+      P q, r;
+      dense_divide (a, b, q, r);
+      a = b;
+      b = r;
+      if (b.deg () >= P::fast_threshold)
+	dense_half_gcd (a, b).apply (a, b);
+    }
+  return a == 0 ? a : a.monic ();
+}
+
+// the product of a and b as polynomials over Z2
+unsigned __int128 clmul (uint64 a, uint64 b);
+
+/* Over Z2 the coefficients are bits, packed 64 to a word, lowest
+   degree first, with no trailing zero word.  Multiplication is
+   Karatsuba on words. */
 template<>
 class polynomial<Z2>
 {
  private:
-  set<unsigned> coeffs;
+  std::vector<uint64> w;
   
-  explicit polynomial (const set<unsigned> &coeffs_) : coeffs(coeffs_) { }
+  void trim ()
+  {
+    while (!w.empty () && w.back () == 0)
+      w.pop_back ();
+  }
+  
+ public:
+  static const int fast_threshold = 512;
   
  public:
   polynomial () { }
   polynomial (int x)
   {
-    Z2 c (x);
-    if (c != 0)
-      coeffs.push (0);
+    if (Z2 (x) != 0)
+      w.push_back (1);
   }
   
   polynomial (Z2 c)
   {
     if (c != 0)
-      coeffs.push (0);
+      w.push_back (1);
   }
   
-  polynomial (Z2 c, unsigned e)
+  polynomial (Z2 c, unsigned e) { add_term (c, e); }
+  
+  polynomial (const polynomial &p) : w(p.w) { }
+  polynomial (copy, const polynomial &p) : w(p.w) { }
+  polynomial (reader &r)
   {
-    if (c != 0)
-      coeffs.push (e);
+    w.resize (r.read_unsigned ());
+    for (unsigned i = 0; i < w.size (); i ++)
+      w[i] = r.read_uint64 ();
   }
-  
-  polynomial (const polynomial &p) : coeffs(p.coeffs) { }
-  polynomial (copy, const polynomial &p) : coeffs(COPY, p.coeffs) { }
   ~polynomial () { }
   
-  polynomial &operator = (const polynomial &p) { coeffs = p.coeffs; return *this; }
+  polynomial &operator = (const polynomial &p) { w = p.w; return *this; }
   
-  polynomial &operator = (int x)
-  {
-    coeffs = set<unsigned> ();
-    Z2 c (x);
-    if (c != 0)
-      coeffs.push (0);
-    return *this;
-  }
+  polynomial &operator = (int x) { return operator = (Z2 (x)); }
   
   polynomial &operator = (Z2 c)
   {
-    coeffs = set<unsigned> ();
+    w.clear ();
     if (c == 1)
-      coeffs.push (0);
+      w.push_back (1);
     return *this;
   }
   
-  bool operator == (const polynomial &p) const { return coeffs == p.coeffs; }
+  bool operator == (const polynomial &p) const { return w == p.w; }
   bool operator != (const polynomial &p) const { return !operator == (p); }
   
   bool operator == (int x) const
   {
     Z2 c (x);
     if (c == 0)
-      return coeffs.is_empty ();
+      return w.empty ();
     else
-      return coeffs.card () == 1
-	&& coeffs.head () == 0;
+      return is_unit ();
   }
   
   bool operator != (int x) const { return !operator == (x); }
   
-  unsigned degree () const { return coeffs.tail (); }
+  int deg () const
+  {
+    if (w.empty ())
+      return -1;
+    return (int)(64 * (w.size () - 1)) + 63 - __builtin_clzll (w.back ());
+  }
+  unsigned degree () const { assert (!w.empty ()); return deg (); }
   bool is_unit () const
   {
-    return coeffs.card () == 1
-      && coeffs.head () == 0;
+    return w.size () == 1
+      && w[0] == 1;
   }
   
   polynomial recip () const
@@ -466,52 +617,456 @@ class polynomial<Z2>
     return 1;
   }
   
-  polynomial &operator += (polynomial p) { coeffs ^= p.coeffs; return *this; }
-  polynomial &operator -= (polynomial p) { coeffs ^= p.coeffs; return *this; }
-  polynomial &operator *= (polynomial p) { return operator = (*this * p); }
+  Z2 coeff (unsigned e) const
+  {
+    return Z2 (e / 64 < w.size ()
+	       && ((w[e / 64] >> (e % 64)) & 1));
+  }
+  
+  polynomial &operator += (const polynomial &p);
+  polynomial &operator -= (const polynomial &p) { return operator += (p); }
+  polynomial &operator *= (const polynomial &p) { return operator = (*this * p); }
   polynomial &operator *= (Z2 s)
   {
     if (s == 0)
-      coeffs.clear ();
+      w.clear ();
     return *this;
   }
   
   polynomial &add_term (Z2 c, unsigned e)
   {
     if (c == 1)
-      coeffs.toggle (e);
+      {
+	if (w.size () <= e / 64)
+	  w.resize (e / 64 + 1, 0);
+	w[e / 64] ^= (uint64)1 << (e % 64);
+	trim ();
+      }
     return *this;
   }
   
   polynomial operator - () const { return polynomial (COPY, *this); };
-  polynomial operator + (polynomial p) const
+  polynomial operator + (const polynomial &p) const
   {
     polynomial r (COPY, *this);
     r += p;
     return r;
   }
   
-  polynomial operator - (polynomial p) const
+  polynomial operator - (const polynomial &p) const
   {
     polynomial r (COPY, *this);
     r -= p;
     return r;
   }
   
-  polynomial operator * (polynomial p) const;
+  polynomial operator * (const polynomial &p) const;
+  
+  // for the dense_ algorithms
+  polynomial low (unsigned n) const;
+  polynomial high (unsigned n) const;
+  polynomial reversed (unsigned n) const;
+  polynomial monic () const { return *this; }
+  void slow_divide (const polynomial &d, polynomial &q, polynomial &r) const;
   
-  pair<polynomial, polynomial> divide_with_remainder (polynomial d) const;
+  pair<polynomial, polynomial> divide_with_remainder (const polynomial &d) const;
   
-  polynomial mod (polynomial d) const;
+  polynomial mod (const polynomial &d) const;
   
-  bool divides (polynomial d) const;
-  polynomial divide_exact (polynomial d) const;
+  bool divides (const polynomial &d) const;
+  polynomial divide_exact (const polynomial &d) const;
   
-  polynomial gcd (polynomial b) const;
+  polynomial gcd (const polynomial &b) const { return dense_gcd (*this, b); }
   
+  void write_self (writer &wr) const
+  {
+    wr.write_unsigned (w.size ());
+    for (unsigned i = 0; i < w.size (); i ++)
+      wr.write_uint64 (w[i]);
+  }
   static void show_ring () { printf ("Z2[x]"); }
   void display_self () const { show_self (); newline (); }
   void show_self () const;
 };
 
+/* Over Z/p, coefficients are kept in a vector, lowest degree first,
+   with no trailing zero.  Multiplication is Karatsuba; division and
+   gcd go to Newton iteration and the half-gcd for large degree. */
+template<unsigned p>
+class polynomial<Zp<p> >
+{
+  typedef Zp<p> T;
+  
+ private:
+  std::vector<unsigned> c;
+  
+  void trim ()
+  {
+    while (!c.empty () && c.back () == 0)
+      c.pop_back ();
+  }
+  
+  static const unsigned karatsuba_threshold = 32;
+  
+  // r[0, na + nb - 1) += a b
+  static void mul_coeffs (const unsigned *a, unsigned na,
+			  const unsigned *b, unsigned nb,
+			  unsigned *r);
+  
+ public:
+  static const int fast_threshold = 64;
+  
+ public:
+  polynomial () { }
+  polynomial (int x) { operator = (T (x)); }
+  polynomial (T x) { operator = (x); }
+  polynomial (int x, unsigned e) { add_term (T (x), e); }
+  polynomial (T x, unsigned e) { add_term (x, e); }
+  
+  polynomial (const polynomial &q) : c(q.c) { }
+  polynomial (copy, const polynomial &q) : c(q.c) { }
+  polynomial (reader &r)
+  {
+    map<unsigned, T> coeffs (r);
+    for (typename map<unsigned, T>::const_iter i = coeffs; i; i ++)
+      add_term (i.val (), i.key ());
+  }
+  ~polynomial () { }
+  
+  polynomial &operator = (const polynomial &q) { c = q.c; return *this; }
+  polynomial &operator = (int x) { return operator = (T (x)); }
+  polynomial &operator = (T x)
+  {
+    c.clear ();
+    if (x != 0)
+      c.push_back (x.get_ui ());
+    return *this;
+  }
+  
+  int deg () const { return (int)c.size () - 1; }
+  unsigned degree () const { assert (!c.empty ()); return deg (); }
+  bool is_unit () const { return c.size () == 1; }
+  
+  polynomial recip () const
+  {
+    assert (is_unit ());
+    return polynomial (T (c[0]).recip ());
+  }
+  
+  T coeff (unsigned e) const { return e < c.size () ? T (c[e]) : T (); }
+  
+  bool operator == (const polynomial &q) const { return c == q.c; }
+  bool operator != (const polynomial &q) const { return !operator == (q); }
+  
+  bool operator == (int x) const
+  {
+    T y (x);
+    if (y == 0)
+      return c.empty ();
+    return c.size () == 1 && c[0] == y.get_ui ();
+  }
+  bool operator != (int x) const { return !operator == (x); }
+  
+  polynomial &operator += (const polynomial &q)
+  {
+    if (c.size () < q.c.size ())
+      c.resize (q.c.size (), 0);
+    for (unsigned i = 0; i < q.c.size (); i ++)
+      c[i] = (c[i] + q.c[i]) % p;
+    trim ();
+    return *this;
+  }
+  polynomial &operator -= (const polynomial &q)
+  {
+    if (c.size () < q.c.size ())
+      c.resize (q.c.size (), 0);
+    for (unsigned i = 0; i < q.c.size (); i ++)
+      c[i] = (c[i] + p - q.c[i]) % p;
+    trim ();
+    return *this;
+  }
+  polynomial &operator *= (const polynomial &q) { return operator = (*this * q); }
+  polynomial &operator *= (T s)
+  {
+    unsigned v = s.get_ui ();
+    for (unsigned i = 0; i < c.size (); i ++)
+      c[i] = (unsigned)((uint64)c[i] * v % p);
+    trim ();
+    return *this;
+  }
+  
+  polynomial &add_term (T x, unsigned e)
+  {
+    if (c.size () <= e)
+      c.resize (e + 1, 0);
+    c[e] = (c[e] + x.get_ui ()) % p;
+    trim ();
+    return *this;
+  }
+  
+  polynomial operator - () const { return polynomial () - *this; }
+  polynomial operator + (const polynomial &q) const
+  {
+    polynomial r (*this);
+    r += q;
+    return r;
+  }
+  polynomial operator - (const polynomial &q) const
+  {
+    polynomial r (*this);
+    r -= q;
+    return r;
+  }
+  polynomial operator * (const polynomial &q) const
+  {
+    polynomial r;
+    if (c.empty () || q.c.empty ())
+      return r;
+    r.c.assign (c.size () + q.c.size () - 1, 0);
+    mul_coeffs (&c[0], c.size (), &q.c[0], q.c.size (), &r.c[0]);
+    r.trim ();
+    return r;
+  }
+  
+  // for the dense_ algorithms
+  polynomial low (unsigned n) const
+  {
+    polynomial r;
+    r.c.assign (c.begin (), c.begin () + std::min (n, (unsigned)c.size ()));
+    r.trim ();
+    return r;
+  }
+  polynomial high (unsigned n) const
+  {
+    polynomial r;
+    if (n < c.size ())
+      r.c.assign (c.begin () + n, c.end ());
+    return r;
+  }
+  polynomial reversed (unsigned n) const
+  {
+    assert (deg () <= (int)n);
+    polynomial r;
+    r.c.assign (n + 1, 0);
+    std::reverse_copy (c.begin (), c.end (), r.c.begin () + (n + 1 - c.size ()));
+    r.trim ();
+    return r;
+  }
+  polynomial monic () const
+  {
+    polynomial r (*this);
+    r *= T (c.back ()).recip ();
+    return r;
+  }
+  void slow_divide (const polynomial &d, polynomial &q, polynomial &r) const;
+  
+  bool divides (const polynomial &num) const;
+  
+  // *this | num
+  bool operator | (const polynomial &num) const { return divides (num); }
+  
+  tuple<polynomial, polynomial> divide_with_remainder (const polynomial &d) const
+  {
+    polynomial q, r;
+    dense_divide (*this, d, q, r);
+    return make_tuple (q, r);
+  }
+  
+  polynomial mod (const polynomial &d) const
+  {
+    polynomial q, r;
+    dense_divide (*this, d, q, r);
+    return r;
+  }
+  
+  polynomial divide_exact (const polynomial &d) const
+  {
+    polynomial q, r;
+    dense_divide (*this, d, q, r);
+    assert (r == 0);
+    return q;
+  }
+  polynomial div (const polynomial &d) const { return divide_exact (d); }
+  
+  polynomial gcd (const polynomial &b) const { return dense_gcd (*this, b); }
+  polynomial lcm (const polynomial &b) const { return divide_exact (gcd (b)) * b; }
+  tuple<polynomial, polynomial, polynomial> extended_gcd (const polynomial &b) const;
+  
+#ifndef NDEBUG
+  void check () const { assert (c.empty () || c.back () != 0); }
+#endif
+  
+  void write_self (writer &w) const
+  {
+    map<unsigned, T> coeffs;
+    for (unsigned i = 0; i < c.size (); i ++)
+      {
+	if (c[i])
+	  coeffs.push (i, T (c[i]));
+      }
+    write (w, coeffs);
+  }
+  static void show_ring () { T::show_ring (); printf ("[x]"); }
+  void display_self () const { show_self (); newline (); }
+  void show_self () const;
+};
+
+template<unsigned p> void
+polynomial<Zp<p> >::mul_coeffs (const unsigned *a, unsigned na,
+				const unsigned *b, unsigned nb,
+				unsigned *r)
+{
+  if (na < nb)
+    {
+      std::swap (a, b);
+      std::swap (na, nb);
+    }
+  
+  if (nb < karatsuba_threshold)
+    {
+      // p^2 < 2^32, so sums of fewer than 2^32 products fit
+      std::vector<uint64> acc (na + nb - 1, 0);
+      for (unsigned i = 0; i < na; i ++)
+	{
+	  if (a[i] == 0)
+	    continue;
+	  for (unsigned j = 0; j < nb; j ++)
+	    acc[i + j] += (uint64)a[i] * b[j];
+	}
+      for (unsigned k = 0; k < na + nb - 1; k ++)
+	r[k] = (unsigned)((r[k] + acc[k]) % p);
+      return;
+    }
+  
+  if (na > nb)
+    {
+      for (unsigned i = 0; i < na; i += nb)
+	mul_coeffs (a + i, std::min (nb, na - i), b, nb, r + i);
+      return;
+    }
+  
+  // a = a0 + x^h a1, b = b0 + x^h b1
+  unsigned n = na,
+    h = n / 2,
+    n1 = n - h;
+  std::vector<unsigned> sa (n1), sb (n1);
+  for (unsigned i = 0; i < n1; i ++)
+    {
+      sa[i] = (a[h + i] + (i < h ? a[i] : 0)) % p;
+      sb[i] = (b[h + i] + (i < h ? b[i] : 0)) % p;
+    }
+  
+  std::vector<unsigned> z0 (2 * h - 1, 0),
+    z2 (2 * n1 - 1, 0),
+    zm (2 * n1 - 1, 0);
+  mul_coeffs (a, h, b, h, &z0[0]);
+  mul_coeffs (a + h, n1, b + h, n1, &z2[0]);
+  mul_coeffs (&sa[0], n1, &sb[0], n1, &zm[0]);
+  
+  // zm - z0 - z2 is the middle term
+  for (unsigned k = 0; k < z0.size (); k ++)
+    {
+      r[k] = (r[k] + z0[k]) % p;
+      zm[k] = (zm[k] + p - z0[k]) % p;
+    }
+  for (unsigned k = 0; k < z2.size (); k ++)
+    {
+      r[2 * h + k] = (r[2 * h + k] + z2[k]) % p;
+      zm[k] = (zm[k] + p - z2[k]) % p;
+    }
+  for (unsigned k = 0; k < zm.size (); k ++)
+    r[h + k] = (r[h + k] + zm[k]) % p;
+}
+
+template<unsigned p> void
+polynomial<Zp<p> >::slow_divide (const polynomial &d, polynomial &q, polynomial &r) const
+{
+  int m = d.deg ();
+  assert (m >= 0);
+  
+  r = *this;
+  q = polynomial ();
+  if (deg () < m)
+    return;
+  
+  q.c.assign (deg () - m + 1, 0);
+  unsigned inv = T (d.c[m]).recip ().get_ui ();
+  for (int i = deg (); i >= m; i --)
+    {
+      unsigned x = (unsigned)((uint64)r.c[i] * inv % p);
+      if (x == 0)
+	continue;
+      
+      q.c[i - m] = x;
+      for (int j = 0; j <= m; j ++)
+	r.c[i - m + j] = (unsigned)((r.c[i - m + j] + (uint64)(p - x) * d.c[j]) % p);
+    }
+  q.trim ();
+  r.trim ();
+}
+
+template<unsigned p> bool
+polynomial<Zp<p> >::divides (const polynomial &num) const
+{
+  // denom = *this
+  return num.mod (*this) == 0;
+}
+
+template<unsigned p> tuple<polynomial<Zp<p> >, polynomial<Zp<p> >, polynomial<Zp<p> > >
+polynomial<Zp<p> >::extended_gcd (const polynomial &b) const
+{
+  // a = *this; r0 = s0 a + t0 b
+  polynomial r0 = *this, s0 = 1, t0 = 0,
+    r1 = b, s1 = 0, t1 = 1;
+  while (r1 != 0)
+    {
+      polynomial q, r;
+      dense_divide (r0, r1, q, r);
+      polynomial s = s0 - q * s1,
+	t = t0 - q * t1;
+      r0 = r1; s0 = s1; t0 = t1;
+      r1 = r; s1 = s; t1 = t;
+    }
+  return make_tuple (r0, s0, t0);
+}
+
+template<unsigned p> void
+polynomial<Zp<p> >::show_self () const
+{
+  unsigned first = 1;
+  for (unsigned e = 0; e < c.size (); e ++)
+    {
+      if (c[e] == 0)
+	continue;
+      
+      T x (c[e]);
+      if (first)
+	first = 0;
+      else
+	printf (" + ");
+      
+      if (e == 0 && x == 1)
+	printf ("1");
+      else if (e == 0)
+	show (x);
+      else if (x == 1)
+	{
+	  if (e == 1)
+	    printf ("x");
+	  else
+	    printf ("x^%d", e);
+	}
+      else
+	{
+	  show (x);
+	  if (e == 1)
+	    printf ("*x");
+	  else
+	    printf ("*x^%d", e);
+	}
+    }
+  if (first)
+    printf ("0");
+}
+
 #endif // _KNOTKIT_ALGEBRA_POLYNOMIAL_H
@@ -0,0 +1,131 @@
+#ifndef _KNOTKIT_ALGEBRA_SPARSE_FIELD_MATRIX_H
+#define _KNOTKIT_ALGEBRA_SPARSE_FIELD_MATRIX_H
+
+/* A sparse matrix over a field K held as plain vectors, with none of
+   the sharing of module and mod_map, so that different matrices may
+   be used from different threads.  Row i is the image of generator
+   i.  The reduced rows found by rank () are, restricted to their
+   leading columns, triangular, so the rows and columns of the pivots
+   pick out a nonsingular minor of the original matrix. */
+
+template<class K>
+class sparse_field_matrix
+{
+ public:
+  typedef std::vector<std::pair<unsigned, K> > entries;
+  
+  // image of a generator, as map_builder<R>::operator []
+  class row
+  {
+   public:
+    entries e;
+  
+   public:
+    row &muladd (const K &x, unsigned j)
+    {
+      if (x != 0)
+	e.push_back (std::make_pair (j, x));
+      return *this;
+    }
+  };
+  
+  std::vector<row> rows;
+  
+ public:
+  sparse_field_matrix (unsigned n) : rows(n) { }
+  
+  row &operator [] (unsigned i) { return rows[i - 1]; }
+  
+  // sort rows by column and combine
+  void finish ();
+  
+  /* rank of rows which[0], ...; if pivots is given, also the rows
+     and columns of a nonsingular minor of that size */
+  unsigned rank (const std::vector<unsigned> &which,
+		 std::vector<std::pair<unsigned, unsigned> > *pivots = 0) const;
+};
+
+template<class K> void
+sparse_field_matrix<K>::finish ()
+{
+  for (unsigned i = 0; i < rows.size (); i ++)
+    {
+      entries &e = rows[i].e;
+      std::sort (e.begin (), e.end (),
+		 [] (const std::pair<unsigned, K> &a, const std::pair<unsigned, K> &b)
+		 { return a.first < b.first; });
+  
+      unsigned n = 0;
+      for (unsigned j = 0; j < e.size (); j ++)
+	{
+	  if (n > 0 && e[n - 1].first == e[j].first)
+	    e[n - 1].second += e[j].second;
+	  else
+	    e[n ++] = e[j];
+	  if (e[n - 1].second == 0)
+	    n --;
+	}
+      e.resize (n);
+    }
+}
+
+template<class K> unsigned
+sparse_field_matrix<K>::rank (const std::vector<unsigned> &which,
+			      std::vector<std::pair<unsigned, unsigned> > *pivots_out) const
+{
+  // pivot rows, leading coefficient 1, by leading column
+  std::map<unsigned, entries> pivots;
+  
+  if (pivots_out)
+    pivots_out->clear ();
+  
+  unsigned r = 0;
+  for (unsigned i = 0; i < which.size (); i ++)
+    {
+      entries v = rows[which[i] - 1].e;
+      while (!v.empty ())
+	{
+	  typename std::map<unsigned, entries>::const_iterator p = pivots.find (v[0].first);
+	  if (p == pivots.end ())
+	    {
+	      K c = v[0].second.recip ();
+	      for (unsigned j = 0; j < v.size (); j ++)
+		v[j].second *= c;
+	      pivots[v[0].first] = v;
+	      if (pivots_out)
+		pivots_out->push_back (std::make_pair (which[i], v[0].first));
+	      r ++;
+	      break;
+	    }
+  
+	  // v -= v[0] pivot
+	  const entries &w = p->second;
+	  K c = v[0].second;
+	  entries u;
+	  unsigned a = 1, b = 1;
+	  while (a < v.size () || b < w.size ())
+	    {
+	      if (b == w.size ()
+		  || (a < v.size () && v[a].first < w[b].first))
+		u.push_back (v[a ++]);
+	      else if (a == v.size () || w[b].first < v[a].first)
+		{
+		  u.push_back (std::make_pair (w[b].first, - (c * w[b].second)));
+		  b ++;
+		}
+	      else
+		{
+		  K x = v[a].second - c * w[b].second;
+		  if (x != 0)
+		    u.push_back (std::make_pair (v[a].first, x));
+		  a ++;
+		  b ++;
+		}
+	    }
+	  v.swap (u);
+	}
+    }
+  return r;
+}
+
+#endif // _KNOTKIT_ALGEBRA_SPARSE_FIELD_MATRIX_H
@@ -0,0 +1,58 @@
+
+#include <knotkit.h>
+
+std::string checkpoint_dir;
+unsigned checkpoint_interval = 600;
+
+void
+hash_writer::write_block (const void *p, size_t nbytes)
+{
+  const uint8 *b = (const uint8 *)p;
+  for (size_t i = 0; i < nbytes; i ++)
+    h = hash_combine (h, hash (b[i]));
+}
+
+checkpoint::checkpoint (const char *kind, hash_t key_)
+  : key(key_),
+    last(time (0))
+{
+  if (checkpoint_dir.empty ())
+    return;
+  
+  char buf[100];
+  sprintf (buf, "/%s-%016llx.ckpt", kind, (uint64)key);
+  file = checkpoint_dir + buf;
+}
+
+file_reader *
+checkpoint::open () const
+{
+  if (!enabled ())
+    return 0;
+  
+  struct stat st;
+  if (stat (file.c_str (), &st) != 0)
+    return 0;
+  
+  file_reader *r = new file_reader (file);
+  if (r->read_uint64 () != (uint64)key)
+    {
+      fprintf (stderr, "%s: checkpoint key mismatch, ignoring\n", file.c_str ());
+      delete r;
+      return 0;
+    }
+  
+  if (verbose)
+    fprintf (stderr, "resuming from checkpoint %s\n", file.c_str ());
+  return r;
+}
+
+void
+checkpoint::remove () const
+{
+  if (enabled ())
+    {
+      unlink (file.c_str ());
+      unlink ((file + ".tmp").c_str ());
+    }
+}
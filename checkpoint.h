@@ -0,0 +1,97 @@
+#ifndef _KNOTKIT_CHECKPOINT_H
+#define _KNOTKIT_CHECKPOINT_H
+#include <unistd.h>
+#include <time.h>
+#include <typeinfo>
+
+/* Periodic checkpoints for long computations (cube<R>::compute_map,
+   chain_complex_simplifier).  Disabled unless checkpoint_dir is set
+   (kk -c <dir>).  A checkpoint file is named by a key hashing the
+   inputs of the computation; a computation that finds its file
+   resumes from it, and removes it when it finishes.  Files are
+   written to a temporary, synced and renamed, so a job killed while
+   saving leaves the previous checkpoint intact. */
+
+extern std::string checkpoint_dir;
+extern unsigned checkpoint_interval;  // seconds
+
+/* Hashes what is written to it, for keys over values that can be
+   written but have no hash_self (coefficients). */
+class hash_writer : public writer
+{
+  hash_t h;
+  
+ public:
+  hash_writer () : writer(0), h(0) { }
+  hash_writer (const hash_writer &) = delete;
+  ~hash_writer () { flush (); }
+  
+  hash_writer &operator = (const hash_writer &) = delete;
+  
+  hash_t hash_value () { flush (); return h; }
+  
+ protected:
+  void write_block (const void *p, size_t nbytes);
+};
+
+class checkpoint
+{
+ public:
+  std::string file;
+  hash_t key;
+  time_t last;
+  
+ public:
+  checkpoint (const char *kind, hash_t key_);
+  checkpoint (const checkpoint &) = delete;
+  ~checkpoint () { }
+  
+  checkpoint &operator = (const checkpoint &) = delete;
+  
+  bool enabled () const { return !file.empty (); }
+  bool due () const
+  {
+    return enabled ()
+      && time (0) - last >= (time_t)checkpoint_interval;
+  }
+  
+  /* opens the checkpoint for resuming, 0 if there is none.  The
+     header has been read and checked. */
+  file_reader *open () const;
+  
+  /* write_state (w) writes the state after the header. */
+  template<class F> void save (F write_state);
+  
+  void remove () const;
+};
+
+template<class F> void
+checkpoint::save (F write_state)
+{
+  assert (enabled ());
+  
+  std::string tmp = file + ".tmp";
+  {
+    file_writer w (tmp);
+    w.write_uint64 (key);
+    write_state (w);
+    w.flush ();
+    if (fflush (w.fp) != 0
+	|| fsync (fileno (w.fp)) != 0)
+      {
+	stderror ("fsync: %s", tmp.c_str ());
+	exit (EXIT_FAILURE);
+      }
+  }
+  if (rename (tmp.c_str (), file.c_str ()) != 0)
+    {
+      stderror ("rename: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  
+  last = time (0);
+  if (verbose)
+    fprintf (stderr, "checkpoint written to %s\n", file.c_str ());
+}
+
+#endif // _KNOTKIT_CHECKPOINT_H
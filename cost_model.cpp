@@ -0,0 +1,438 @@
+
+#include <knotkit.h>
+
+#include <mutex>
+#include <unistd.h>
+
+// states sampled above cube_shape_exact_crossings
+static const unsigned cube_shape_samples = 1 << 14;
+
+cube_shape::cube_shape (const knot_diagram &kd, bool reduced)
+  : n_crossings(kd.n_crossings),
+    generators(0),
+    nonzeros(0)
+{
+  // too large to walk, and to compute
+  if (n_crossings > smallbitset::max_size)
+    {
+      generators = nonzeros = HUGE_VAL;
+      return;
+    }
+  
+  unsigned n_states = n_crossings <= cube_shape_exact_crossings
+    ? ((unsigned)1) << n_crossings
+    : cube_shape_samples;
+  uint64 mask = n_crossings < 64
+    ? (((uint64)1) << n_crossings) - 1
+    : ~(uint64)0;
+  
+  // xorshift, so that estimates are the same from run to run
+  uint64 x = 88172645463325252ull;
+  
+  smoothing s (kd);
+  for (unsigned i = 0; i < n_states; i ++)
+    {
+      uint64 state = i;
+      if (n_crossings > cube_shape_exact_crossings)
+	{
+	  x ^= x << 13;
+	  x ^= x >> 7;
+	  x ^= x << 17;
+	  state = x & mask;
+	}
+  
+      smallbitset st (n_crossings, state);
+      s.init (kd, st);
+  
+      double g = ldexp (1.0, s.n_circles);
+      generators += g;
+      for (unsigned c = 1; c <= n_crossings; c ++)
+	{
+	  if (st % c)
+	    continue;
+  
+	  // same circle on both sides: the 1-smoothing splits it
+	  if (s.crossing_from_circle (kd, c) == s.crossing_to_circle (kd, c))
+	    nonzeros += 1.5 * g;
+	  else
+	    nonzeros += 0.75 * g;
+	}
+    }
+  
+  if (n_crossings > cube_shape_exact_crossings)
+    {
+      double scale = ldexp (1.0, n_crossings) / n_states;
+      generators *= scale;
+      nonzeros *= scale;
+    }
+  if (reduced)
+    {
+      generators /= 2;
+      nonzeros /= 2;
+    }
+}
+
+cost_model::cost_model ()
+{
+  /* from runs of kk_from_file -record, one worker on one core: the
+     nonalternating Rolfsen knots, alternating knots and MT links up
+     to 12 crossings, over Z2, Z3 and Q.  Where t[1] came out
+     negative, or the key needs no cube, its term was folded into
+     t[0] and t[2] by log (nonzeros + 1) ~ 1.62 + 0.944 n, the fit
+     over those diagrams. */
+  static const struct {
+    const char *key;
+    unsigned runs;
+    double t[3];
+    double m[3];
+  } builtin[] = {
+    { "alexander", 195, { -6.733, 0, 0.02254 }, { 3.39e+06, 0, 0 } },
+    { "components", 417, { -6.754, 0, 0.01122 }, { 3.082e+06, 0, 0 } },
+    { "crossings", 195, { -6.738, 0, 0.01011 }, { 2.798e+06, 0, 0 } },
+    { "jones", 417, { -6.789, 0, 0.03707 }, { 3.567e+06, 0, 0 } },
+    { "jones reduced", 74, { -6.819, 0, 0.029 }, { 3.784e+06, 0, 0 } },
+    { "khp Q", 90, { -12.68, 0.8927, 0.206 }, { 4.127e+06, 491.9, 476.1 } },
+    { "khp Q reduced", 53, { -13.82, 0.6843, 0.5191 }, { 3.27e+06, 1430, 212.9 } },
+    { "khp Z", 65, { -11.02, 0.3517, 0.569 }, { 3.782e+06, 534, 270.6 } },
+    { "khp Z2", 90, { -12.94, 0.249, 0.8403 }, { 4.042e+06, 258.9, 166.6 } },
+    { "khp Z2 reduced", 37, { -12.44, 0.5859, 0.4353 }, { 4.082e+06, 118, 160.6 } },
+    { "khp Z3", 90, { -12.71, 0.4848, 0.5676 }, { 4.096e+06, 221.7, 172.7 } },
+    { "khp thin", 196, { -6.638, 0, 0.03036 }, { 3.786e+06, 0, 0 } },
+    { "s Q", 65, { -12.19, 0, 1.053 }, { 2.217e+06, 0, 224.8 } },
+    { "s Q reduced", 65, { -13.87, 0, 1.018 }, { 2.098e+06, 0, 449.8 } },
+    { "s Z2", 65, { -11.33, 0, 0.8547 }, { 3.318e+06, 0, 72.89 } },
+    { "s Z3", 65, { -11.78, 0, 0.9173 }, { 3.001e+06, 0, 79.8 } },
+    { "signature", 417, { -6.702, 0, 0.0128 }, { 3.498e+06, 0, 0 } },
+    { "ttkh", 417, { -8.285, 0, 0.3004 }, { 3.692e+06, 0, 1.083 } },
+  };
+  
+  for (unsigned i = 0; i < sizeof (builtin) / sizeof (builtin[0]); i ++)
+    {
+      coefficients &c = keys[builtin[i].key];
+      c.runs = builtin[i].runs;
+      for (unsigned j = 0; j < 3; j ++)
+	{
+	  c.t[j] = builtin[i].t[j];
+	  c.m[j] = builtin[i].m[j];
+	}
+    }
+}
+
+cost_model::cost_model (const std::string &file)
+{
+  FILE *fp = open_file (file, "r");
+  
+  char *line = 0;
+  size_t line_size = 0;
+  ssize_t len;
+  unsigned line_no = 0;
+  while ((len = getline (&line, &line_size, fp)) > 0)
+    {
+      line_no ++;
+      if (line[0] == '#' || line[0] == '\n')
+	continue;
+  
+      char *tab = strchr (line, '\t');
+      coefficients c;
+      if (!tab
+	  || sscanf (tab + 1, "%u %lf %lf %lf %lf %lf %lf",
+		     &c.runs, &c.t[0], &c.t[1], &c.t[2],
+		     &c.m[0], &c.m[1], &c.m[2]) != 7)
+	{
+	  fprintf (stderr, "%s:%d: bad cost model line\n", file.c_str (), line_no);
+	  exit (EXIT_FAILURE);
+	}
+      keys[std::string (line, tab)] = c;
+    }
+  free (line);
+  close_file (fp);
+  
+  if (keys.find ("khp Z2") == keys.end ())
+    keys["khp Z2"] = cost_model ().keys["khp Z2"];
+}
+
+const cost_model::coefficients &
+cost_model::find (const std::string &key) const
+{
+  std::map<std::string, coefficients>::const_iterator i = keys.find (key);
+  if (i != keys.end ())
+    return i->second;
+  
+  // "s Q reduced" falls back to "s Q", then "s"
+  size_t space = key.rfind (' ');
+  if (space != std::string::npos)
+    return find (key.substr (0, space));
+  
+  i = keys.find ("khp Z2");
+  assert (i != keys.end ());
+  return i->second;
+}
+
+std::string
+cost_model::key (const knot_diagram &kd, const std::string &invariant,
+		 const std::string &field, bool reduced)
+{
+  if (invariant == "khp"
+      && field != "Z"
+      && kd.num_components () == 1
+      && kd.is_alternating ())
+    return "khp thin";
+  
+  // the others are computed the same whatever the field
+  std::string k = invariant;
+  if (invariant == "khp" || invariant == "s")
+    k += " " + field;
+  if (reduced)
+    k += " reduced";
+  return k;
+}
+
+bool
+cost_model::needs_cube (const std::string &key)
+{
+  std::string invariant = key.substr (0, key.find (' '));
+  return key != "khp thin"
+    && invariant != "jones"
+    && invariant != "alexander"
+    && invariant != "signature"
+    && invariant != "crossings"
+    && invariant != "components";
+}
+
+cost_estimate
+cost_model::estimate (const cube_shape &shape, const std::string &key) const
+{
+  const coefficients &c = find (key);
+  
+  cost_estimate e;
+  e.generators = shape.generators;
+  e.nonzeros = shape.nonzeros;
+  if (std::isinf (shape.nonzeros))
+    {
+      // over any budget
+      e.seconds = e.bytes = HUGE_VAL;
+      return e;
+    }
+  e.seconds = exp (c.t[0]
+		   + c.t[1] * log (shape.nonzeros + 1)
+		   + c.t[2] * shape.n_crossings);
+  e.bytes = std::max (c.m[0],
+		      c.m[0] + c.m[1] * shape.generators + c.m[2] * shape.nonzeros);
+  return e;
+}
+
+cost_estimate
+cost_model::estimate (const knot_diagram &kd, const std::string &invariant,
+		      const std::string &field, bool reduced) const
+{
+  std::string k = key (kd, invariant, field, reduced);
+  return estimate (needs_cube (k)
+		   ? cube_shape (kd, reduced)
+		   : cube_shape (kd.n_crossings),
+		   k);
+}
+
+/* Least squares for y ~ sum_j a[j] x[j] over the features j in use,
+   through the normal equations; the others get 0. */
+static void
+least_squares (const std::vector<std::vector<double> > &x,
+	       const std::vector<double> &y,
+	       const bool *use, double *a)
+{
+  static const unsigned k = 3;
+  
+  double A[k][k + 1];
+  for (unsigned i = 0; i < k; i ++)
+    for (unsigned j = 0; j <= k; j ++)
+      A[i][j] = 0;
+  
+  for (unsigned r = 0; r < x.size (); r ++)
+    for (unsigned i = 0; i < k; i ++)
+      {
+	if (!use[i])
+	  continue;
+	for (unsigned j = 0; j < k; j ++)
+	  {
+	    if (use[j])
+	      A[i][j] += x[r][i] * x[r][j];
+	  }
+	A[i][k] += x[r][i] * y[r];
+      }
+  
+  // features unused, or constant across the runs, stay 0
+  for (unsigned i = 0; i < k; i ++)
+    A[i][i] += use[i] ? 1e-9 * (1 + A[i][i]) : 1;
+  
+  for (unsigned i = 0; i < k; i ++)
+    {
+      unsigned p = i;
+      for (unsigned j = i + 1; j < k; j ++)
+	{
+	  if (fabs (A[j][i]) > fabs (A[p][i]))
+	    p = j;
+	}
+      for (unsigned j = 0; j <= k; j ++)
+	std::swap (A[i][j], A[p][j]);
+  
+      for (unsigned j = 0; j < k; j ++)
+	{
+	  if (j == i)
+	    continue;
+	  double f = A[j][i] / A[i][i];
+	  for (unsigned l = i; l <= k; l ++)
+	    A[j][l] -= f * A[i][l];
+	}
+    }
+  for (unsigned i = 0; i < k; i ++)
+    a[i] = use[i] ? A[i][k] / A[i][i] : 0;
+}
+
+void
+cost_model::fit (const std::vector<cost_sample> &samples)
+{
+  std::map<std::string, std::vector<const cost_sample *> > by_key;
+  for (unsigned i = 0; i < samples.size (); i ++)
+    by_key[samples[i].key].push_back (&samples[i]);
+  
+  for (std::map<std::string, std::vector<const cost_sample *> >::const_iterator i = by_key.begin ();
+       i != by_key.end ();
+       i ++)
+    {
+      const std::vector<const cost_sample *> &v = i->second;
+      if (v.size () < 5)
+	{
+	  fprintf (stderr, "warning: %d runs of %s, too few to fit\n",
+		   (int)v.size (), i->first.c_str ());
+	  continue;
+	}
+  
+      coefficients c;
+      c.runs = v.size ();
+  
+      std::vector<std::vector<double> > tx, mx;
+      std::vector<double> ty, my;
+      for (unsigned j = 0; j < v.size (); j ++)
+	{
+	  const cube_shape &sh = v[j]->shape;
+  
+	  std::vector<double> t (3);
+	  t[0] = 1;
+	  t[1] = log (sh.nonzeros + 1);
+	  t[2] = sh.n_crossings;
+	  tx.push_back (t);
+	  ty.push_back (log (v[j]->seconds + 0.001));
+  
+	  std::vector<double> m (3);
+	  m[0] = 1;
+	  m[1] = sh.generators;
+	  m[2] = sh.nonzeros;
+	  mx.push_back (m);
+	  my.push_back (v[j]->bytes);
+	}
+  
+      // time and memory only grow with the complex: drop a term that
+      // comes out negative
+      bool use_t[3] = { 1, 1, 1 };
+      least_squares (tx, ty, use_t, c.t);
+      if (c.t[1] < 0)
+	{
+	  use_t[1] = 0;
+	  least_squares (tx, ty, use_t, c.t);
+	}
+  
+      bool use[3] = { 1, 1, 1 };
+      least_squares (mx, my, use, c.m);
+      for (unsigned j = 1; j < 3; j ++)
+	{
+	  if (c.m[j] < 0)
+	    {
+	      use[j] = 0;
+	      least_squares (mx, my, use, c.m);
+	      j = 0;
+	    }
+	}
+  
+      keys[i->first] = c;
+    }
+}
+
+void
+cost_model::save (FILE *fp) const
+{
+  for (std::map<std::string, coefficients>::const_iterator i = keys.begin ();
+       i != keys.end ();
+       i ++)
+    {
+      const coefficients &c = i->second;
+      fprintf (fp, "%s\t%u\t%.6g %.6g %.6g\t%.6g %.6g %.6g\n",
+	       i->first.c_str (), c.runs,
+	       c.t[0], c.t[1], c.t[2],
+	       c.m[0], c.m[1], c.m[2]);
+    }
+}
+
+const cost_model &
+cost_model::standard ()
+{
+  static std::mutex model_mutex;
+  static const cost_model *model = 0;
+  
+  std::lock_guard<std::mutex> lock (model_mutex);
+  if (!model)
+    {
+      std::string file = knot_table_file ("cost_model");
+      if (access (file.c_str (), R_OK) == 0)
+	model = new cost_model (file);
+      else
+	model = new cost_model;
+    }
+  return *model;
+}
+
+void
+write_cost_sample (FILE *fp, const cost_sample &sample)
+{
+  fprintf (fp, "%s\t%d\t%.17g\t%.17g\t%.6g\t%.17g\n",
+	   sample.key.c_str (),
+	   sample.shape.n_crossings,
+	   sample.shape.generators,
+	   sample.shape.nonzeros,
+	   sample.seconds,
+	   sample.bytes);
+}
+
+std::vector<cost_sample>
+read_cost_samples (const std::string &file)
+{
+  std::vector<cost_sample> samples;
+  
+  FILE *fp = open_file (file, "r");
+  char *line = 0;
+  size_t line_size = 0;
+  ssize_t len;
+  unsigned line_no = 0;
+  while ((len = getline (&line, &line_size, fp)) > 0)
+    {
+      line_no ++;
+  
+      cost_sample s;
+      char *tab = strchr (line, '\t');
+      if (!tab
+	  || sscanf (tab + 1, "%u %lf %lf %lf %lf",
+		     &s.shape.n_crossings,
+		     &s.shape.generators,
+		     &s.shape.nonzeros,
+		     &s.seconds,
+		     &s.bytes) != 5)
+	{
+	  fprintf (stderr, "%s:%d: bad run line\n", file.c_str (), line_no);
+	  exit (EXIT_FAILURE);
+	}
+      s.key = std::string (line, tab);
+      samples.push_back (s);
+    }
+  free (line);
+  close_file (fp);
+  
+  return samples;
+}
@@ -0,0 +1,121 @@
+
+/* Estimates of what computing an invariant of a diagram costs, for
+   the drivers to order and admit work by.  The estimate starts from
+   the shape of the cube of resolutions: the number of generators of
+   the Khovanov complex, sum over states of 2^circles, and of nonzero
+   entries in its differential, 3/4 of the generators of a state
+   along each merge and 3/2 along each split.  Both are exact up to
+   cube_shape_exact_crossings crossings and estimated from a sample of
+   states above that.  Keys that need no cube (needs_cube ()) are
+   estimated from the crossings alone, and a cube too large for
+   smallbitset is taken to be over any budget.
+
+   Time and peak memory are then modelled per invariant key, e.g.
+   "khp Q reduced", as
+
+     log (seconds + 0.001) = t[0] + t[1] log (nonzeros + 1) + t[2] n
+     bytes = m[0] + m[1] generators + m[2] nonzeros
+
+   with n the number of crossings; the n term takes up whatever grows
+   with the cube rather than with the complex.  The coefficients are
+   fit by least squares to recorded runs (kk_from_file -record, then
+   -calibrate), and a model file holds one line per key:
+
+     <key> TAB <runs> TAB t[0] t[1] t[2] TAB m[0] m[1] m[2]
+
+   Keys with no line of their own fall back to the key without its
+   field, then to "khp Z2", and finally to coefficients built in from
+   runs on a workstation. */
+
+static const unsigned cube_shape_exact_crossings = 14;
+
+class cube_shape
+{
+ public:
+  unsigned n_crossings;
+  double generators;
+  double nonzeros;
+  
+ public:
+  cube_shape () : n_crossings(0), generators(0), nonzeros(0) { }
+  // no cube
+  explicit cube_shape (unsigned n_crossings_)
+    : n_crossings(n_crossings_), generators(0), nonzeros(0)
+  { }
+  // generators and nonzeros are HUGE_VAL past smallbitset::max_size
+  cube_shape (const knot_diagram &kd, bool reduced);
+  ~cube_shape () { }
+};
+
+class cost_estimate
+{
+ public:
+  double generators;
+  double nonzeros;
+  double seconds;
+  double bytes;
+  
+ public:
+  cost_estimate () : generators(0), nonzeros(0), seconds(0), bytes(0) { }
+  ~cost_estimate () { }
+};
+
+// a recorded run
+class cost_sample
+{
+ public:
+  std::string key;
+  cube_shape shape;
+  double seconds;
+  double bytes;
+};
+
+class cost_model
+{
+  class coefficients
+  {
+   public:
+    unsigned runs;
+    double t[3];
+    double m[3];
+  };
+  
+  std::map<std::string, coefficients> keys;
+  
+  const coefficients &find (const std::string &key) const;
+  
+ public:
+  // the built in coefficients
+  cost_model ();
+  // those of a model file
+  cost_model (const std::string &file);
+  ~cost_model () { }
+  
+  // the key for invariant of kd: "<invariant>[ <field>][ reduced]",
+  // with the field for khp and s only, or "khp thin" for khp of an
+  // alternating knot other than over Z, which needs no cube
+  static std::string key (const knot_diagram &kd, const std::string &invariant,
+			  const std::string &field, bool reduced);
+  
+  // 0 for keys computed without the cube of resolutions, e.g. jones
+  // or "khp thin"
+  static bool needs_cube (const std::string &key);
+  
+  cost_estimate estimate (const cube_shape &shape, const std::string &key) const;
+  cost_estimate estimate (const knot_diagram &kd, const std::string &invariant,
+			  const std::string &field, bool reduced) const;
+  
+  // fits the keys with enough runs among samples, keeping the others
+  void fit (const std::vector<cost_sample> &samples);
+  
+  void save (FILE *fp) const;
+  
+  // the model file knot_table_file ("cost_model") if there is one,
+  // the built in model otherwise
+  static const cost_model &standard ();
+};
+
+// one recorded run per line:
+// <key> TAB <crossings> TAB <generators> TAB <nonzeros> TAB <seconds> TAB <bytes>
+extern void write_cost_sample (FILE *fp, const cost_sample &sample);
+extern std::vector<cost_sample> read_cost_samples (const std::string &file);
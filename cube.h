@@ -26,6 +26,11 @@ public:
   unsigned n_crossings;
   unsigned n_resolutions;
   
+  /* Only states with between min_level and max_level 1-smoothings
+     have generators, and compute_map and H_i only connect those.
+     compute_nu, compute_X and compute_dinv need the whole cube. */
+  unsigned min_level, max_level;
+  
   unsigned n_generators;
   vector<unsigned> resolution_circles;
   vector<unsigned> resolution_generator1;
@@ -57,9 +62,17 @@ public:
   void check_reverse_orientation ();
   
 public:
-  cube (knot_diagram &d_, bool markedp_only_ = 0);
+  cube (knot_diagram &d_, bool markedp_only_ = 0,
+	unsigned min_level_ = 0, unsigned max_level_ = (unsigned)-1);
   ~cube () { }
   
+  bool in_levels (unsigned state) const
+  {
+    unsigned k = unsigned_bitcount (state);
+    return k >= min_level && k <= max_level;
+  }
+  bool whole () const { return min_level == 0 && max_level >= n_crossings; }
+  
   grading compute_generator_grading (unsigned g) const;
   grading compute_state_monomial_grading (unsigned state, unsigned monomial) const;
   
@@ -106,6 +119,19 @@ class twisted_cube
   
   twisted_cube &operator = (const twisted_cube &) = delete;
   
+  /* The entries of the twisted maps are sums of 1 + t^w.  The build_
+     templates fill b (a map_builder<K> or sparse_field_matrix<K>) with
+     t^w = tw (w) in K, for the maps over R below or their values at
+     points (twisted_evaluation.h). */
+  template<class K, class T, class M>
+    void build_twisted_map (basedvector<int, 1> edge_weight,
+			    unsigned dh,
+			    unsigned to_reverse,
+			    const twisted_map_rules &rules,
+			    T tw, M &b) const;
+  template<class K, class T, class M>
+    void build_twisted_d0 (basedvector<int, 1> edge_weight, T tw, M &b) const;
+  
   mod_map<R> compute_twisted_map (basedvector<int, 1> edge_weight,
 				  unsigned dh,
 				  unsigned to_reverse,
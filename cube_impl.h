@@ -45,15 +45,57 @@ cube<R>::compute_map (unsigned dh, unsigned max_n,
       fprintf (stderr, "%d resolutions.\n", n_resolutions);
     }
   
+  hash_t key = hash_combine (hash (kd.crossings), hash (kd.marked_edge));
+  key = hash_combine (key, hash (std::string (typeid (R).name ())));
+  key = hash_combine (key, hash (std::string (typeid (rules).name ())));
+  key = hash_combine (key, hash ((markedp_only << 3)
+				 | (mirror << 2)
+				 | (reverse_orientation << 1)));
+  key = hash_combine (key, hash_combine (hash (dh),
+					 hash_combine (hash (max_n),
+						       hash (to_reverse))));
+  if (!whole ())
+    key = hash_combine (key, hash_combine (hash (min_level), hash (max_level)));
+  checkpoint ckpt ("map", key);
+  
+  // columns of states < start are complete
+  unsigned start = 0;
+  if (file_reader *r = ckpt.open ())
+    {
+      start = r->read_unsigned ();
+      for (unsigned i = 1; i <= n_generators; i ++)
+	{
+	  b[i] = linear_combination (khC, *r);
+	  b.spill_if_needed ();
+	}
+      delete r;
+    }
+  
   basedvector<pair<unsigned, unsigned>, 1> out;
-  for (unsigned fromstate = 0; fromstate < n_resolutions; fromstate ++)
+  for (unsigned fromstate = start; fromstate < n_resolutions; fromstate ++)
     {
+      if (ckpt.due ())
+	{
+	  const map_builder<R> &cb = b;
+	  ckpt.save ([&] (writer &w) {
+	      w.write_unsigned (fromstate);
+	      for (unsigned i = 1; i <= n_generators; i ++)
+		cb[i].write_column (w);
+	    });
+	}
+      
+      // columns of states < fromstate are complete
+      b.spill_if_needed ();
+      
       if (verbose
 	  &&  (fromstate & unsigned_fill (n_crossings > 4
 					  ? n_crossings - 4
 					  : 0)) == 0)
 	fprintf (stderr, "%d / %d resolutions done.\n", fromstate, n_resolutions);
       
+      if (!in_levels (fromstate))
+	continue;
+      
       unsigned n_zerocrossings = n_crossings - unsigned_bitcount (fromstate);
       unsigned n_cobordisms = ((unsigned)1) << n_zerocrossings;
       
@@ -73,6 +115,8 @@ cube<R>::compute_map (unsigned dh, unsigned max_n,
 	    continue;
 	  
 	  unsigned tostate = unsigned_pack (n_crossings, fromstate, j);
+	  if (!in_levels (tostate))
+	    continue;
 	  unsigned crossings = tostate & ~fromstate;
 	  
 	  int sign = 1;
@@ -180,6 +224,8 @@ cube<R>::compute_map (unsigned dh, unsigned max_n,
       fprintf (stderr, "computing differential done.\n");
     }
   
+  ckpt.remove ();
+  
   return mod_map<R> (b);
 }
 
@@ -246,6 +292,7 @@ template<class R> mod_map<R>
 cube<R>::compute_nu () const
 {
   assert (!markedp_only);
+  assert (whole ());
   
   map_builder<R> b (khC);
   for (unsigned i = 0, j = 1; i < n_resolutions; i ++)
@@ -276,6 +323,7 @@ template<class R> mod_map<R>
 cube<R>::compute_X (unsigned p) const
 {
   assert (!markedp_only);
+  assert (whole ());
   
   /* define Khovanov's map X */
   map_builder<R> b (khC);
@@ -308,9 +356,12 @@ cube<R>::H_i (unsigned c)
       if (unsigned_bittest (i, c))
 	continue;
       
+      unsigned i2 = unsigned_bitset (i, c);
+      if (!in_levels (i) || !in_levels (i2))
+	continue;
+      
       smoothing from_s (kd, smallbitset (n_crossings, i));
       
-      unsigned i2 = unsigned_bitset (i, c);
       smoothing to_s (kd, smallbitset (n_crossings, i2));
       
       basedvector<unsigned, 1> from_circle_edge_rep (from_s.n_circles);
@@ -374,6 +425,8 @@ cube<R>::H_i (unsigned c)
 template<class R> mod_map<R>
 cube<R>::compute_dinv (unsigned c)
 {
+  assert (whole ());
+  
   map_builder<R> p (khC);
   for (unsigned i = 0; i < n_resolutions; i ++)
     {
@@ -516,11 +569,14 @@ cube<R>::check_reverse_orientation ()
 }
 
 template<class R>
-cube<R>::cube (knot_diagram &kd_, bool markedp_only_)
+cube<R>::cube (knot_diagram &kd_, bool markedp_only_,
+	       unsigned min_level_, unsigned max_level_)
   : markedp_only(markedp_only_),
     kd(kd_),
     n_crossings(kd.n_crossings),
     n_resolutions(((unsigned)1) << n_crossings),
+    min_level(min_level_),
+    max_level(max_level_),
     n_generators(0),
     resolution_circles(n_resolutions),
     resolution_generator1(n_resolutions)
@@ -532,6 +588,13 @@ cube<R>::cube (knot_diagram &kd_, bool markedp_only_)
   smoothing s (kd);
   for (unsigned i = 0; i < n_resolutions; i ++)
     {
+      resolution_generator1[i] = n_generators + 1;
+      if (!in_levels (i))
+	{
+	  resolution_circles[i] = 0;
+	  continue;
+	}
+      
       smallbitset state (n_crossings, i);
       s.init (kd, state);
       
@@ -579,7 +642,6 @@ cube<R>::cube (knot_diagram &kd_, bool markedp_only_)
 #endif
       
       resolution_circles[i] = s.n_circles;
-      resolution_generator1[i] = n_generators + 1;
       n_generators += s.num_generators (markedp_only);
       
 #if 0
@@ -694,7 +756,18 @@ twisted_cube<F>::compute_twisted_map (basedvector<int, 1> edge_weight,
 				      const twisted_map_rules &rules) const
 {
   map_builder<R> b (c.khC);
+  build_twisted_map<R> (edge_weight, dh, to_reverse, rules,
+			[] (int w) { return R (polynomial<F> (1, w)); },
+			b);
+  return mod_map<R> (b);
+}
   
+template<class F> template<class K, class T, class M> void
+twisted_cube<F>::build_twisted_map (basedvector<int, 1> edge_weight,
+				    unsigned dh, unsigned to_reverse,
+				    const twisted_map_rules &rules,
+				    T tw, M &b) const
+{
   knot_diagram &kd = c.kd;
   unsigned n_crossings = c.n_crossings;
   unsigned n_resolutions = c.n_resolutions;
@@ -825,14 +898,12 @@ twisted_cube<F>::compute_twisted_map (basedvector<int, 1> edge_weight,
 		  
 		  // ??? sign
 		  b[c.generator (fromstate, v_from)].muladd
-		    (polynomial<F> (1) + polynomial<F> (1, w),
+		    (K (1) + tw (w),
 		     c.generator (tostate, v_to));
 		}
 	    }
 	}
     }
-  
-  return mod_map<R> (b);
 }
 
 class twisted_barE_rules : public twisted_map_rules
@@ -864,6 +935,15 @@ template<class F> mod_map<typename twisted_cube<F>::R>
 twisted_cube<F>::twisted_d0 (basedvector<int, 1> edge_weight) const
 {
   map_builder<R> b (c.khC);
+  build_twisted_d0<R> (edge_weight,
+		       [] (int w) { return R (polynomial<F> (1, w)); },
+		       b);
+  return mod_map<R> (b);
+}
+
+template<class F> template<class K, class T, class M> void
+twisted_cube<F>::build_twisted_d0 (basedvector<int, 1> edge_weight, T tw, M &b) const
+{
   for (unsigned i = 0, j = 1; i < c.n_resolutions; i ++)
     {
       smoothing r (c.kd, smallbitset (c.n_crossings, i));
@@ -889,11 +969,10 @@ twisted_cube<F>::twisted_d0 (basedvector<int, 1> edge_weight) const
 		      w += edge_weight[k];
 		  
 		  unsigned j2 = unsigned_bitclear (j, s);
-		  b[c.generator (i, j)].muladd (polynomial<F> (1) + polynomial<F> (1, w),
+		  b[c.generator (i, j)].muladd (K (1) + tw (w),
 						c.generator (i, j2));
 		}
 	    }
 	}
     }
-  return mod_map<R> (b);
 }
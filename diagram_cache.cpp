@@ -0,0 +1,315 @@
+
+#include <knotkit.h>
+
+#include <mutex>
+#include <unistd.h>
+
+static const char diagram_cache_magic[8] = { 'k', 'k', 'd', 'i', 'a', 'g', 's', 0 };
+
+class diagram_cache_header
+{
+ public:
+  char magic[8];
+  unsigned version;
+  unsigned t, i;
+  unsigned n_knots;
+  unsigned n_crossings;
+  unsigned record_size;
+  uint64 name_offsets_offset;
+};
+
+static uint64
+align8 (uint64 x)
+{
+  return (x + 7) & ~(uint64)7;
+}
+
+static void
+put (FILE *fp, const std::string &file, const void *p, size_t nbytes)
+{
+  if (fwrite (p, 1, nbytes, fp) != nbytes)
+    {
+      stderror ("fwrite: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+}
+
+static unsigned
+diagram_record_size (unsigned n)
+{
+  return 4 * n + 2 + (2 * n + 7) / 8;
+}
+
+void
+write_diagram_cache (const std::string &file,
+		     knot_desc::table t, unsigned i)
+{
+  unsigned n_knots = knot_desc (t, i, 1).table_crossing_knots ();
+  if (i > 63)
+    {
+      fprintf (stderr, "error: %d crossings too many for a diagram cache\n", i);
+      exit (EXIT_FAILURE);
+    }
+  unsigned record_size = diagram_record_size (i);
+  
+  std::vector<uint8> records ((uint64)n_knots * record_size, 0);
+  std::vector<uint64> name_offsets (n_knots + 1);
+  std::string names;
+  for (unsigned j = 1; j <= n_knots; j ++)
+    {
+      knot_diagram kd = knot_desc (t, i, j).compute_diagram ();
+      assert (kd.n_crossings == i
+	      && kd.nminus < 256 && kd.nplus < 256);
+  
+      uint8 *r = &records[(uint64)(j - 1) * record_size];
+      for (unsigned c = 1; c <= i; c ++)
+	for (unsigned k = 1; k <= 4; k ++)
+	  *r++ = kd.crossings[c][k];
+      *r++ = kd.nminus;
+      *r++ = kd.nplus;
+      for (unsigned e = 1; e <= kd.num_edges (); e ++)
+	{
+	  if (kd.edge_smoothing_oriented % e)
+	    r[(e - 1) / 8] |= 1 << ((e - 1) % 8);
+	}
+  
+      name_offsets[j - 1] = names.size ();
+      names += kd.name;
+    }
+  name_offsets[n_knots] = names.size ();
+  
+  diagram_cache_header h;
+  memset (&h, 0, sizeof h);
+  memcpy (h.magic, diagram_cache_magic, sizeof h.magic);
+  h.version = diagram_cache_version;
+  h.t = t;
+  h.i = i;
+  h.n_knots = n_knots;
+  h.n_crossings = i;
+  h.record_size = record_size;
+  uint64 pos = sizeof h + records.size ();
+  h.name_offsets_offset = align8 (pos);
+  
+  // write to a temporary and rename, so readers never see a partial file
+  std::string tmp = file + ".tmp";
+  FILE *fp = open_file (tmp, "w");
+  put (fp, tmp, &h, sizeof h);
+  put (fp, tmp, records.data (), records.size ());
+  static const char zeros[8] = { 0 };
+  put (fp, tmp, zeros, h.name_offsets_offset - pos);
+  put (fp, tmp, name_offsets.data (), name_offsets.size () * sizeof (uint64));
+  put (fp, tmp, names.data (), names.size ());
+  close_file (fp);
+  
+  if (rename (tmp.c_str (), file.c_str ()) != 0)
+    {
+      stderror ("rename: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+}
+
+diagram_cache::diagram_cache (const std::string &file)
+  : f(new mapped_file (file))
+{
+  const diagram_cache_header *h = f->at<diagram_cache_header> (0);
+  if (memcmp (h->magic, diagram_cache_magic, sizeof h->magic) != 0)
+    {
+      fprintf (stderr, "%s: not a diagram cache file\n", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  if (h->version != diagram_cache_version)
+    {
+      fprintf (stderr, "%s: unsupported version %d (expected %d)\n",
+	       file.c_str (), h->version, diagram_cache_version);
+      exit (EXIT_FAILURE);
+    }
+  
+  t = (knot_desc::table)h->t;
+  i = h->i;
+  n_knots = h->n_knots;
+  n_crossings = h->n_crossings;
+  record_size = h->record_size;
+  if (record_size != diagram_record_size (n_crossings))
+    {
+      fprintf (stderr, "%s: corrupt header\n", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  
+  records = f->at<uint8> (sizeof (diagram_cache_header), (uint64)n_knots * record_size);
+  name_offsets = f->at<uint64> (h->name_offsets_offset, (uint64)n_knots + 1);
+  f->at<char> (h->name_offsets_offset + ((uint64)n_knots + 1) * sizeof (uint64),
+	       name_offsets[n_knots]);
+}
+
+knot_diagram
+diagram_cache::diagram (unsigned j) const
+{
+  assert (between (1, j, n_knots));
+  
+  const char *names = (const char *)(name_offsets + n_knots + 1);
+  const uint8 *r = records + (uint64)(j - 1) * record_size;
+  
+  knot_diagram kd;
+  kd.name = std::string (names + name_offsets[j - 1],
+			 names + name_offsets[j]);
+  kd.n_crossings = n_crossings;
+  kd.crossings = basedvector<basedvector<unsigned, 1>, 1> (n_crossings);
+  kd.ept_crossing = basedvector<unsigned, 1> (kd.num_epts ());
+  kd.ept_index = basedvector<unsigned, 1> (kd.num_epts ());
+  for (unsigned c = 1; c <= n_crossings; c ++)
+    {
+      basedvector<unsigned, 1> v (4);
+      for (unsigned k = 1; k <= 4; k ++)
+	{
+	  unsigned p = *r++;
+	  v[k] = p;
+	  kd.ept_crossing[p] = c;
+	  kd.ept_index[p] = k;
+	}
+      kd.crossings[c] = v;
+    }
+  kd.nminus = *r++;
+  kd.nplus = *r++;
+  for (unsigned e = 1; e <= kd.num_edges (); e ++)
+    {
+      if (r[(e - 1) / 8] & (1 << ((e - 1) % 8)))
+	kd.edge_smoothing_oriented.push (e);
+    }
+  return kd;
+}
+
+// knot_table_file ("cache/<table>_<i>.<suffix>")
+static std::string
+cache_file_name (knot_desc::table t, unsigned i, const char *suffix)
+{
+  static const char *table_names[] = {
+    "none", "rolfsen", "htw", "htw_alt", "htw_nonalt", "mt", "mt_alt", "mt_nonalt", "torus",
+  };
+  assert (t < sizeof (table_names) / sizeof (table_names[0]));
+  
+  char buf[100];
+  sprintf (buf, "cache/%s_%d.%s", table_names[t], i, suffix);
+  return knot_table_file (buf);
+}
+
+std::string
+diagram_cache::file_name (knot_desc::table t, unsigned i)
+{
+  return cache_file_name (t, i, "kdc");
+}
+
+const diagram_cache *
+diagram_cache::find (knot_desc::table t, unsigned i)
+{
+  static std::mutex caches_mutex;
+  static std::map<std::pair<unsigned, unsigned>, diagram_cache *> caches;
+  
+  std::lock_guard<std::mutex> lock (caches_mutex);
+  
+  std::pair<unsigned, unsigned> key (t, i);
+  std::map<std::pair<unsigned, unsigned>, diagram_cache *>::const_iterator c = caches.find (key);
+  if (c != caches.end ())
+    return c->second;
+  
+  diagram_cache *dc = 0;
+  std::string file = file_name (t, i);
+  if (access (file.c_str (), R_OK) == 0)
+    {
+      dc = new diagram_cache (file);
+      if (dc->t != t || dc->i != i
+	  || dc->n_knots != knot_desc (t, i, 1).table_crossing_knots ())
+	{
+	  fprintf (stderr, "%s: does not match its table\n", file.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+    }
+  caches[key] = dc;
+  return dc;
+}
+
+/* sq1, sq2 copied onto an explicit module: the homology the
+   simplifier gives looks its gradings up in the cube, which does not
+   outlive the knot. */
+static void
+append_squares (basedvector<mod_map<Z2>, 1> &maps,
+		mod_map<Z2> sq1, mod_map<Z2> sq2)
+{
+  ptr<const module<Z2> > H = sq1.domain ();
+  unsigned n = H->dim ();
+  
+  basedvector<grading, 1> hq (n);
+  for (unsigned j = 1; j <= n; j ++)
+    hq[j] = H->generator_grading (j);
+  ptr<const module<Z2> > E = new explicit_module<Z2> (n, basedvector<Z2, 1> (), hq);
+  
+  mod_map<Z2> sqs[2] = { sq1, sq2 };
+  for (unsigned k = 0; k < 2; k ++)
+    {
+      map_builder<Z2> b (E);
+      for (unsigned j = 1; j <= n; j ++)
+	{
+	  for (linear_combination_const_iter<Z2> l = sqs[k].column (j); l; l ++)
+	    b[j].muladd (l.val (), l.key ());
+	}
+      maps.append (mod_map<Z2> (b));
+    }
+}
+
+void
+write_sq_cache (const std::string &file,
+		knot_desc::table t, unsigned i)
+{
+  unsigned n_knots = knot_desc (t, i, 1).table_crossing_knots ();
+  
+  basedvector<mod_map<Z2>, 1> maps;
+  for (unsigned j = 1; j <= n_knots; j ++)
+    {
+      knot_diagram kd = knot_desc (t, i, j).diagram ();
+      kd.marked_edge = 1;
+  
+      cube<Z2> c (kd);
+      mod_map<Z2> d = c.compute_d (1, 0, 0, 0, 0);
+  
+      chain_complex_simplifier<Z2> s (c.khC, d, maybe<int> (1), maybe<int> (0));
+      assert (s.new_d == 0);
+  
+      steenrod_square sq (c, d, s);
+      append_squares (maps, sq.sq1 (), sq.sq2 ());
+    }
+  
+  write_mapped_maps (file, maps);
+}
+
+std::string
+sq_cache::file_name (knot_desc::table t, unsigned i)
+{
+  return cache_file_name (t, i, "sq");
+}
+
+const mapped_maps *
+sq_cache::find (knot_desc::table t, unsigned i)
+{
+  static std::mutex caches_mutex;
+  static std::map<std::pair<unsigned, unsigned>, mapped_maps *> caches;
+  
+  std::lock_guard<std::mutex> lock (caches_mutex);
+  
+  std::pair<unsigned, unsigned> key (t, i);
+  std::map<std::pair<unsigned, unsigned>, mapped_maps *>::const_iterator c = caches.find (key);
+  if (c != caches.end ())
+    return c->second;
+  
+  mapped_maps *m = 0;
+  std::string file = file_name (t, i);
+  if (access (file.c_str (), R_OK) == 0)
+    {
+      m = new mapped_maps (file);
+      if (m->n_maps () != 2 * knot_desc (t, i, 1).table_crossing_knots ())
+	{
+	  fprintf (stderr, "%s: does not match its table\n", file.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+    }
+  caches[key] = m;
+  return m;
+}
@@ -0,0 +1,73 @@
+
+/* Precomputed knot_diagrams of one table: the knots of a knot_desc
+   table t with i crossings, written once by write_diagram_cache ()
+   (see kk_cache) and used in place through mmap.  A diagram is read
+   back from its crossings, signs and smoothing orientation, with no
+   dt_code layout.
+
+   Layout (native byte order):
+
+     header        magic "kkdiags\0", unsigned version, t, i,
+                   n_knots, n_crossings, record_size,
+                   uint64 name_offsets_offset
+     records       n_knots x record_size bytes: 4 n_crossings uint8
+                   crossing epts, uint8 nminus, nplus, then the edges
+                   with smoothing orientation as a bitmask
+     name offsets  n_knots + 1 uint64s into the names, 8-byte aligned
+     names         the diagram names, not terminated
+
+   knot_desc::diagram (), and so parse_knot for table names, uses the
+   cache file for its table if one is present, as knot_table_file
+   ("cache/<table>_<i>.kdc"). */
+
+static const unsigned diagram_cache_version = 1;
+
+extern void write_diagram_cache (const std::string &file,
+				 knot_desc::table t, unsigned i);
+
+class diagram_cache
+{
+  ptr<mapped_file> f;
+  const uint8 *records;
+  const uint64 *name_offsets;
+  
+ public:
+  knot_desc::table t;
+  unsigned i;
+  unsigned n_knots;
+  unsigned n_crossings;
+  unsigned record_size;
+  
+ public:
+  diagram_cache (const std::string &file);
+  diagram_cache (const diagram_cache &) = delete;
+  ~diagram_cache () { }
+  
+  diagram_cache &operator = (const diagram_cache &) = delete;
+  
+  // knot j of the table, from 1
+  knot_diagram diagram (unsigned j) const;
+  
+  static std::string file_name (knot_desc::table t, unsigned i);
+  
+  // the cache for t, i if there is one, or 0; thread-safe
+  static const diagram_cache *find (knot_desc::table t, unsigned i);
+};
+
+/* The Steenrod squares sq1 and sq2 on Z2 Kh of the knots of a table,
+   precomputed by write_sq_cache () (see kk_cache -sq) as mapped maps,
+   see algebra/mapped_map.h: maps 2j - 1 and 2j are sq1 and sq2 of
+   knot j, for the table diagram with edge 1 marked.  kk sq2 reads
+   them from knot_table_file ("cache/<table>_<i>.sq") if present. */
+
+extern void write_sq_cache (const std::string &file,
+			    knot_desc::table t, unsigned i);
+
+class sq_cache
+{
+ public:
+  static std::string file_name (knot_desc::table t, unsigned i);
+  
+  // the squares of t, i if there is a cache, or 0; thread-safe
+  static const mapped_maps *find (knot_desc::table t, unsigned i);
+};
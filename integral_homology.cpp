@@ -0,0 +1,344 @@
+
+#include <knotkit.h>
+
+#include <thread>
+#include <atomic>
+
+/* A graded piece of d: the images of its generators, numbered from 1
+   within the piece, in the generators of its target piece. */
+class integral_block
+{
+ public:
+  unsigned n_cols;
+  std::vector<std::vector<std::pair<unsigned, mpz_class> > > rows;
+  
+ public:
+  integral_block () : n_cols(0) { }
+  
+  std::vector<std::vector<mpz_class> > dense () const;
+};
+
+std::vector<std::vector<mpz_class> >
+integral_block::dense () const
+{
+  std::vector<std::vector<mpz_class> > a (rows.size (), std::vector<mpz_class> (n_cols));
+  for (unsigned i = 0; i < rows.size (); i ++)
+    for (unsigned k = 0; k < rows[i].size (); k ++)
+      a[i][rows[i][k].first - 1] = rows[i][k].second;
+  return a;
+}
+
+template<class F> static unsigned
+block_rank (const integral_block &b, unsigned p,
+	    std::vector<std::pair<unsigned, unsigned> > *pivots)
+{
+  unsigned n = b.rows.size ();
+  sparse_field_matrix<F> m (n);
+  std::vector<unsigned> which (n);
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      const std::vector<std::pair<unsigned, mpz_class> > &e = b.rows[i - 1];
+      for (unsigned k = 0; k < e.size (); k ++)
+	m[i].muladd (F ((int)mpz_fdiv_ui (e[k].second.get_mpz_t (), p)), e[k].first);
+      which[i - 1] = i;
+    }
+  m.finish ();
+  return m.rank (which, pivots);
+}
+
+static const unsigned n_small_primes = 4;
+
+static const struct
+{
+  unsigned p;
+  unsigned (*rank) (const integral_block &, unsigned,
+		    std::vector<std::pair<unsigned, unsigned> > *);
+} moduli[] = {
+  { 2, block_rank<Z2> },
+  { 3, block_rank<Zp<3> > },
+  { 5, block_rank<Zp<5> > },
+  { 7, block_rank<Zp<7> > },
+  { 65521, block_rank<Zp<65521> > },
+  { 65519, block_rank<Zp<65519> > },
+  { 65497, block_rank<Zp<65497> > },
+};
+
+static const unsigned n_moduli = sizeof (moduli) / sizeof (moduli[0]);
+
+// Bareiss' fraction-free elimination
+static mpz_class
+determinant (std::vector<std::vector<mpz_class> > a)
+{
+  unsigned n = a.size ();
+  mpz_class prev = 1;
+  int sign = 1;
+  for (unsigned k = 0; k < n; k ++)
+    {
+      unsigned r = k;
+      while (r < n && sgn (a[r][k]) == 0)
+	r ++;
+      if (r == n)
+	return 0;
+      if (r != k)
+	{
+	  a[r].swap (a[k]);
+	  sign = -sign;
+	}
+  
+      for (unsigned i = k + 1; i < n; i ++)
+	{
+	  for (unsigned j = k + 1; j < n; j ++)
+	    {
+	      mpz_class x = a[i][j] * a[k][k] - a[i][k] * a[k][j];
+	      mpz_divexact (a[i][j].get_mpz_t (), x.get_mpz_t (), prev.get_mpz_t ());
+	    }
+	}
+      prev = a[k][k];
+    }
+  return sign < 0 ? mpz_class (-prev) : prev;
+}
+
+/* The rank of a, and its invariant factors greater than 1: each
+   pivot, of least absolute value, clears its row and column by
+   division with remainder until nothing is left, and the diagonal is
+   then put in divisibility order. */
+static unsigned
+smith_normal_form (std::vector<std::vector<mpz_class> > a,
+		   std::vector<mpz_class> &factors)
+{
+  unsigned m = a.size (),
+    n = m ? a[0].size () : 0;
+  
+  std::vector<mpz_class> diag;
+  for (unsigned t = 0; t < std::min (m, n); t ++)
+    {
+      for (;;)
+	{
+	  unsigned pi = m, pj = n;
+	  for (unsigned i = t; i < m; i ++)
+	    for (unsigned j = t; j < n; j ++)
+	      {
+		if (sgn (a[i][j]) != 0
+		    && (pi == m
+			|| mpz_cmpabs (a[i][j].get_mpz_t (), a[pi][pj].get_mpz_t ()) < 0))
+		  {
+		    pi = i;
+		    pj = j;
+		  }
+	      }
+	  if (pi == m)
+	    break;
+  
+	  a[pi].swap (a[t]);
+	  for (unsigned i = 0; i < m; i ++)
+	    std::swap (a[i][pj], a[i][t]);
+  
+	  bool clear = 1;
+	  mpz_class q;
+	  for (unsigned i = t + 1; i < m; i ++)
+	    {
+	      if (sgn (a[i][t]) == 0)
+		continue;
+	      mpz_tdiv_q (q.get_mpz_t (), a[i][t].get_mpz_t (), a[t][t].get_mpz_t ());
+	      for (unsigned j = t; j < n; j ++)
+		a[i][j] -= q * a[t][j];
+	      if (sgn (a[i][t]) != 0)
+		clear = 0;
+	    }
+	  for (unsigned j = t + 1; j < n; j ++)
+	    {
+	      if (sgn (a[t][j]) == 0)
+		continue;
+	      mpz_tdiv_q (q.get_mpz_t (), a[t][j].get_mpz_t (), a[t][t].get_mpz_t ());
+	      for (unsigned i = t; i < m; i ++)
+		a[i][j] -= q * a[i][t];
+	      if (sgn (a[t][j]) != 0)
+		clear = 0;
+	    }
+	  if (clear)
+	    {
+	      diag.push_back (abs (a[t][t]));
+	      break;
+	    }
+	}
+      if (diag.size () == t)
+	break;
+    }
+  
+  // (d_i, d_j) -> (gcd, lcm)
+  for (unsigned i = 0; i < diag.size (); i ++)
+    for (unsigned j = i + 1; j < diag.size (); j ++)
+      {
+	mpz_class g, l;
+	mpz_gcd (g.get_mpz_t (), diag[i].get_mpz_t (), diag[j].get_mpz_t ());
+	mpz_lcm (l.get_mpz_t (), diag[i].get_mpz_t (), diag[j].get_mpz_t ());
+	diag[i] = g;
+	diag[j] = l;
+      }
+  
+  factors.clear ();
+  for (unsigned i = 0; i < diag.size (); i ++)
+    {
+      if (cmp (diag[i], 1) != 0)
+	factors.push_back (diag[i]);
+    }
+  return diag.size ();
+}
+
+integral_homology::integral_homology (ptr<const module<Z> > C, const mod_map<Z> &d,
+				      unsigned n_threads)
+  : n_snf(0)
+{
+  unsigned n = C->dim ();
+  
+  std::map<std::pair<int, int>, unsigned> block_idx;
+  std::vector<std::pair<int, int> > block_gr;
+  basedvector<unsigned, 1> gen_block (n),
+    gen_pos (n);
+  std::vector<unsigned> block_size;
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      grading gr = C->generator_grading (i);
+      std::pair<int, int> hq (gr.h, gr.q);
+      std::map<std::pair<int, int>, unsigned>::const_iterator b = block_idx.find (hq);
+      if (b == block_idx.end ())
+	{
+	  b = block_idx.insert (std::make_pair (hq, block_gr.size ())).first;
+	  block_gr.push_back (hq);
+	  block_size.push_back (0);
+	}
+      gen_block[i] = b->second;
+      gen_pos[i] = ++ block_size[b->second];
+    }
+  unsigned n_blocks = block_gr.size ();
+  
+  // plain copies of the pieces of d, for the threads
+  std::vector<integral_block> blocks (n_blocks);
+  std::vector<unsigned> target (n_blocks, n_blocks);
+  for (unsigned b = 0; b < n_blocks; b ++)
+    blocks[b].rows.resize (block_size[b]);
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      unsigned b = gen_block[i];
+      std::vector<std::pair<unsigned, mpz_class> > &row = blocks[b].rows[gen_pos[i] - 1];
+      for (linear_combination_const_iter<Z> j = d.column (i); j; j ++)
+	{
+	  unsigned t = gen_block[j.key ()];
+	  assert (target[b] == n_blocks || target[b] == t);
+	  target[b] = t;
+	  row.push_back (std::make_pair (gen_pos[j.key ()], j.val ().get_mpz ()));
+	}
+    }
+  for (unsigned b = 0; b < n_blocks; b ++)
+    {
+      if (target[b] != n_blocks)
+	blocks[b].n_cols = block_size[target[b]];
+    }
+  
+  unsigned nt = n_threads;
+  if (nt == 0)
+    nt = std::max (1u, std::thread::hardware_concurrency ());
+  
+  // ranks of the pieces mod each prime
+  unsigned n_tasks = n_blocks * n_moduli;
+  std::vector<unsigned> ranks (n_tasks, 0);
+  std::vector<std::vector<std::pair<unsigned, unsigned> > > pivots (n_tasks);
+  std::atomic<unsigned> next (0);
+  auto rank_worker = [&] () {
+    for (unsigned t; (t = next ++) < n_tasks;)
+      {
+	unsigned b = t / n_moduli,
+	  l = t % n_moduli;
+	if (target[b] != n_blocks)
+	  ranks[t] = moduli[l].rank (blocks[b], moduli[l].p,
+				     l >= n_small_primes ? &pivots[t] : 0);
+      }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < std::min (nt, n_tasks); i ++)
+    pool.push_back (std::thread (rank_worker));
+  rank_worker ();
+  for (unsigned i = 0; i < pool.size (); i ++)
+    pool[i].join ();
+  
+  std::vector<unsigned> rank (n_blocks, 0);
+  std::vector<std::vector<mpz_class> > factors (n_blocks);
+  std::vector<unsigned> suspect;
+  for (unsigned b = 0; b < n_blocks; b ++)
+    {
+      unsigned best = n_small_primes;
+      for (unsigned l = n_small_primes; l < n_moduli; l ++)
+	{
+	  if (ranks[b * n_moduli + l] > ranks[b * n_moduli + best])
+	    best = l;
+	}
+      rank[b] = ranks[b * n_moduli + best];
+      if (target[b] == n_blocks)
+	continue;
+  
+      bool torsion_seen = 0;
+      for (unsigned l = 0; l < n_moduli; l ++)
+	{
+	  if (ranks[b * n_moduli + l] < rank[b])
+	    torsion_seen = 1;
+	}
+      if (!torsion_seen && rank[b] > 0)
+	{
+	  const std::vector<std::pair<unsigned, unsigned> > &piv = pivots[b * n_moduli + best];
+	  std::vector<std::vector<mpz_class> > a = blocks[b].dense (),
+	    minor (piv.size (), std::vector<mpz_class> (piv.size ()));
+	  for (unsigned i = 0; i < piv.size (); i ++)
+	    for (unsigned j = 0; j < piv.size (); j ++)
+	      minor[i][j] = a[piv[i].first - 1][piv[j].second - 1];
+	  mpz_class det = determinant (minor);
+	  if (mpz_cmpabs_ui (det.get_mpz_t (), 1) == 0)
+	    continue;
+	}
+      suspect.push_back (b);
+    }
+  
+  // exact, one piece per thread
+  next = 0;
+  auto snf_worker = [&] () {
+    for (unsigned t; (t = next ++) < suspect.size ();)
+      {
+	unsigned b = suspect[t];
+	rank[b] = smith_normal_form (blocks[b].dense (), factors[b]);
+      }
+  };
+  pool.clear ();
+  for (unsigned i = 1; i < std::min (nt, (unsigned)suspect.size ()); i ++)
+    pool.push_back (std::thread (snf_worker));
+  snf_worker ();
+  for (unsigned i = 0; i < pool.size (); i ++)
+    pool[i].join ();
+  n_snf = suspect.size ();
+  
+  std::vector<int> dim (block_size.begin (), block_size.end ());
+  for (unsigned b = 0; b < n_blocks; b ++)
+    {
+      if (rank[b] == 0)
+	continue;
+  
+      unsigned t = target[b];
+      dim[b] -= rank[b];
+      dim[t] -= rank[b];
+      for (unsigned k = 0; k < factors[b].size (); k ++)
+	{
+	  const mpz_class &f = factors[b][k];
+	  if (!mpz_fits_ulong_p (f.get_mpz_t ()))
+	    {
+	      fprintf (stderr, "error: torsion order too large for integral_homology\n");
+	      exit (EXIT_FAILURE);
+	    }
+	  torsion[f.get_ui ()].add_term (1, block_gr[t].first, block_gr[t].second);
+	}
+    }
+  
+  for (unsigned b = 0; b < n_blocks; b ++)
+    {
+      assert (dim[b] >= 0);
+      if (dim[b])
+	free.add_term (dim[b], block_gr[b].first, block_gr[b].second);
+    }
+}
@@ -0,0 +1,30 @@
+
+/* The homology over Z of a complex C, d over Z, usually simplified
+   first with chain_complex_simplifier<Z>.  d is split into its graded
+   pieces, whose ranks are found in parallel modulo 2, 3, 5, 7 and
+   three primes just below 2^16.  The rank over Q is the largest of
+   these, and the cokernel of a piece has p-torsion exactly when its
+   rank mod p is smaller.  A piece with no torsion so detected is
+   checked with the determinant of a nonsingular minor found by the
+   elimination mod the large primes: if it is a unit, the piece has no
+   torsion at all.  Only the remaining pieces are reduced to Smith
+   normal form over Z.  The rank over Q is exact for those, and for
+   the others wrong only if all three large primes divide every
+   minor of full size. */
+class integral_homology
+{
+ public:
+  // ranks of the free part, in h (x1) and q (x2)
+  bivariate_laurentpoly free;
+  
+  // ranks of the Z/n summands by n > 1
+  std::map<unsigned long, bivariate_laurentpoly> torsion;
+  
+  // graded pieces reduced to Smith normal form
+  unsigned n_snf;
+  
+ public:
+  // 0 for one thread per core
+  integral_homology (ptr<const module<Z> > C, const mod_map<Z> &d,
+		     unsigned n_threads = 0);
+};
@@ -0,0 +1,116 @@
+
+#include <knotkit.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string store_dir;
+
+static const char store_magic[] = "kkstore 1";
+
+std::string
+invariant_store::diagram_text (const knot_diagram &kd)
+{
+  std::string s;
+  char buf[100];
+  sprintf (buf, "%d %d", kd.n_crossings, kd.marked_edge);
+  s += buf;
+  for (unsigned i = 1; i <= kd.n_crossings; i ++)
+    {
+      sprintf (buf, " %d,%d,%d,%d",
+	       kd.crossings[i][1], kd.crossings[i][2],
+	       kd.crossings[i][3], kd.crossings[i][4]);
+      s += buf;
+    }
+  s += " /";
+  for (set_const_iter<unsigned> i = kd.edge_smoothing_oriented; i; i ++)
+    {
+      sprintf (buf, " %d", i.val ());
+      s += buf;
+    }
+  return s;
+}
+
+static uint64
+fnv1a (const std::string &s, uint64 h = 0xcbf29ce484222325ull)
+{
+  for (unsigned i = 0; i < s.size (); i ++)
+    {
+      h ^= (uint8)s[i];
+      h *= 0x100000001b3ull;
+    }
+  return h;
+}
+
+static std::string
+entry_file (const std::string &diagram, const std::string &key)
+{
+  uint64 h = fnv1a (key, fnv1a (diagram + "\n"));
+  char buf[100];
+  sprintf (buf, "/%02x/%014llx",
+	   (unsigned)(h >> 56), (unsigned long long)(h & ((1ull << 56) - 1)));
+  return store_dir + buf;
+}
+
+bool
+invariant_store::find (const knot_diagram &kd, const std::string &key,
+		       std::string &value)
+{
+  if (!enabled ())
+    return 0;
+  
+  std::string diagram = diagram_text (kd);
+  FILE *fp = fopen (entry_file (diagram, key).c_str (), "r");
+  if (!fp)
+    return 0;
+  
+  std::string contents;
+  char buf[4096];
+  size_t n;
+  while ((n = fread (buf, 1, sizeof buf, fp)) > 0)
+    contents.append (buf, n);
+  fclose (fp);
+  
+  // magic, diagram, key, each on a line, then the value
+  std::string header = std::string (store_magic) + "\n" + diagram + "\n" + key + "\n";
+  if (contents.compare (0, header.size (), header) != 0)
+    return 0;
+  
+  value = contents.substr (header.size ());
+  return 1;
+}
+
+void
+invariant_store::save (const knot_diagram &kd, const std::string &key,
+		       const std::string &value)
+{
+  if (!enabled ())
+    return;
+  
+  assert (key.find ('\n') == std::string::npos);
+  
+  std::string diagram = diagram_text (kd);
+  std::string file = entry_file (diagram, key);
+  
+  mkdir (store_dir.c_str (), 0777);
+  mkdir (file.substr (0, file.rfind ('/')).c_str (), 0777);
+  
+  char buf[100];
+  sprintf (buf, ".%d.tmp", (int)getpid ());
+  std::string tmp = file + buf;
+  
+  FILE *fp = open_file (tmp, "w");
+  fprintf (fp, "%s\n%s\n%s\n", store_magic, diagram.c_str (), key.c_str ());
+  if (fwrite (value.data (), 1, value.size (), fp) != value.size ())
+    {
+      stderror ("fwrite: %s", tmp.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  close_file (fp);
+  
+  if (rename (tmp.c_str (), file.c_str ()) != 0)
+    {
+      stderror ("rename: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+}
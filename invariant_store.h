@@ -0,0 +1,32 @@
+
+/* A store of computed invariants on disk, shared between runs and
+   between kk, kk serve and kk_from_file.  Disabled unless store_dir
+   is set (kk -store <dir>).  An entry holds the value of one
+   invariant of one diagram, as text, under a key naming the invariant
+   and whatever else it depends on (field, reduced, ...).  Entries are
+   addressed by a 64-bit hash of the diagram and the key:
+
+     <store_dir>/<first 2 hex digits>/<remaining 14>
+
+   and hold the diagram and the key in full, so a hash collision is a
+   miss rather than a wrong answer.  Entries are written to a
+   temporary and renamed, so concurrent writers are safe.  Callers put
+   the diagram in canonical form first (knot_diagram (CANONICAL, ...)),
+   so that every numbering of it finds the same entries. */
+
+extern std::string store_dir;
+
+class invariant_store
+{
+ public:
+  static bool enabled () { return !store_dir.empty (); }
+  
+  // the diagram as the store sees it: crossings, marked edge, orientation
+  static std::string diagram_text (const knot_diagram &kd);
+  
+  // 1 and the value if kd has an entry under key
+  static bool find (const knot_diagram &kd, const std::string &key,
+		    std::string &value);
+  static void save (const knot_diagram &kd, const std::string &key,
+		    const std::string &value);
+};
@@ -0,0 +1,391 @@
+
+#include <knotkit.h>
+
+/* The state sum is swept one crossing at a time.  Once some crossings
+   are resolved, all that matters about a partial state is its weight
+   and how its arcs pair up the edges leaving the resolved part (the
+   frontier), so partial states with the same pairing are added
+   together.  The crossings are taken in a greedy order which keeps
+   the frontier small: the cost is exponential in the width of the
+   sweep rather than in the number of crossings. */
+
+/* dense Laurent polynomial in q */
+class bracket_poly
+{
+ public:
+  int low;
+  std::vector<mpz_class> c;
+  
+ public:
+  bracket_poly () : low(0) { }
+  bracket_poly (int x) : low(0), c(1, mpz_class (x)) { }
+  
+  void add (const bracket_poly &p, int shift, bool negate);
+  // times (q + q^-1)^k
+  void mul_circles (unsigned k);
+  // exact quotient by q + q^-1
+  void div_circle ();
+};
+
+void
+bracket_poly::add (const bracket_poly &p, int shift, bool negate)
+{
+  if (p.c.size () == 0)
+    return;
+  
+  int plow = p.low + shift;
+  if (c.size () == 0)
+    low = plow;
+  else if (plow < low)
+    {
+      c.insert (c.begin (), low - plow, mpz_class (0));
+      low = plow;
+    }
+  
+  unsigned off = plow - low;
+  if (c.size () < off + p.c.size ())
+    c.resize (off + p.c.size ());
+  for (unsigned i = 0; i < p.c.size (); i ++)
+    {
+      if (negate)
+	c[off + i] -= p.c[i];
+      else
+	c[off + i] += p.c[i];
+    }
+}
+
+void
+bracket_poly::mul_circles (unsigned k)
+{
+  for (unsigned j = 0; j < k; j ++)
+    {
+      std::vector<mpz_class> r (c.size () + 2);
+      for (unsigned i = 0; i < c.size (); i ++)
+	{
+	  r[i] += c[i];
+	  r[i + 2] += c[i];
+	}
+      c.swap (r);
+      low --;
+    }
+}
+
+void
+bracket_poly::div_circle ()
+{
+  unsigned n = c.size ();
+  assert (n >= 2);
+  
+  std::vector<mpz_class> r (n - 2);
+  for (unsigned i = 0; i < n - 2; i ++)
+    {
+      r[i] = c[i];
+      if (i >= 2)
+	r[i] -= r[i - 2];
+    }
+  assert (c[n - 2] == (n >= 4 ? r[n - 4] : mpz_class (0)));
+  assert (c[n - 1] == (n >= 3 ? r[n - 3] : mpz_class (0)));
+  
+  c.swap (r);
+  low ++;
+}
+
+/* crossings in sweep order: each step takes the crossing which grows
+   the frontier least */
+static basedvector<unsigned, 1>
+sweep_order (const knot_diagram &kd)
+{
+  unsigned n = kd.n_crossings;
+  
+  basedvector<unsigned, 1> order;
+  std::vector<bool> done (n + 1);
+  for (unsigned k = 1; k <= n; k ++)
+    {
+      unsigned best = 0;
+      int best_growth = 0;
+      for (unsigned c = 1; c <= n; c ++)
+	{
+	  if (done[c])
+	    continue;
+  
+	  // edges to resolved crossings leave the frontier, the others
+	  // join it (twice if both ends are at c)
+	  int growth = 0;
+	  for (unsigned i = 1; i <= 4; i ++)
+	    {
+	      unsigned p = kd.crossings[c][i];
+	      unsigned oc = kd.ept_crossing[kd.edge_other_ept (p)];
+	      if (done[oc])
+		growth --;
+	      else if (oc != c)
+		growth ++;
+	    }
+	  if (!best || growth < best_growth)
+	    {
+	      best = c;
+	      best_growth = growth;
+	    }
+	}
+      done[best] = 1;
+      order.append (best);
+    }
+  return order;
+}
+
+multivariate_laurentpoly<Z>
+jones_polynomial (const knot_diagram &kd, bool reduced)
+{
+  typedef std::vector<unsigned char> pairing;
+  
+  unsigned n = kd.n_crossings;
+  basedvector<unsigned, 1> order = sweep_order (kd);
+  
+  // frontier edges, increasing, and the position of each
+  std::vector<unsigned> frontier;
+  std::vector<int> edge_pos (kd.num_edges () + 1, -1);
+  std::vector<bool> done (n + 1);
+  
+  // partial states by the pairing they induce on the frontier
+  std::map<pairing, bracket_poly> states;
+  states[pairing ()] = bracket_poly (1);
+  
+  for (unsigned k = 1; k <= n; k ++)
+    {
+      unsigned c = order[k];
+      unsigned m = frontier.size ();
+  
+      /* The nodes of a graph in which every node has degree at most
+	 2: frontier positions 0, ..., m - 1, then the endpoints of c
+	 at m, ..., m + 3.  Links are the pairing of the state, the
+	 edges at c and the resolution of c.  Paths join the nodes
+	 which make up the new frontier; cycles are circles. */
+      std::vector<unsigned> new_frontier;
+      std::vector<std::pair<unsigned, unsigned> > fixed_links;
+      for (unsigned i = 1; i <= 4; i ++)
+	{
+	  unsigned p = kd.crossings[c][i];
+	  unsigned e = kd.ept_edge (p);
+	  unsigned q = kd.edge_other_ept (p);
+	  unsigned oc = kd.ept_crossing[q];
+	  if (done[oc])
+	    fixed_links.push_back (std::pair<unsigned, unsigned> (m + i - 1, edge_pos[e]));
+	  else if (oc == c)
+	    {
+	      unsigned j = kd.ept_index[q];
+	      if (i < j)
+		fixed_links.push_back (std::pair<unsigned, unsigned> (m + i - 1, m + j - 1));
+	    }
+	  else
+	    new_frontier.push_back (e);
+	}
+      for (unsigned j = 0; j < m; j ++)
+	{
+	  unsigned e = frontier[j];
+	  if (kd.ept_crossing[kd.edge_to_ept (e)] != c
+	      && kd.ept_crossing[kd.edge_from_ept (e)] != c)
+	    new_frontier.push_back (e);
+	}
+      std::sort (new_frontier.begin (), new_frontier.end ());
+      assert (new_frontier.size () < 256);
+  
+      std::vector<int> new_pos (kd.num_edges () + 1, -1);
+      for (unsigned j = 0; j < new_frontier.size (); j ++)
+	new_pos[new_frontier[j]] = j;
+  
+      // new frontier position of each node, or -1 if it is interior
+      std::vector<int> node_pos (m + 4, -1);
+      for (unsigned j = 0; j < m; j ++)
+	node_pos[j] = new_pos[frontier[j]];
+      for (unsigned i = 1; i <= 4; i ++)
+	{
+	  unsigned p = kd.crossings[c][i];
+	  unsigned oc = kd.ept_crossing[kd.edge_other_ept (p)];
+	  if (!done[oc] && oc != c)
+	    node_pos[m + i - 1] = new_pos[kd.ept_edge (p)];
+	}
+  
+      std::map<pairing, bracket_poly> new_states;
+      for (std::map<pairing, bracket_poly>::const_iterator s = states.begin ();
+	   s != states.end ();
+	   s ++)
+	{
+	  const pairing &pr = s->first;
+	  for (unsigned r = 0; r <= 1; r ++)
+	    {
+	      std::vector<std::pair<unsigned, unsigned> > links = fixed_links;
+	      for (unsigned j = 0; j < m; j ++)
+		{
+		  if (j < pr[j])
+		    links.push_back (std::pair<unsigned, unsigned> (j, pr[j]));
+		}
+  
+	      // see knot_diagram::resolve_next_ept
+	      if (r == 0)
+		{
+		  links.push_back (std::pair<unsigned, unsigned> (m, m + 1));
+		  links.push_back (std::pair<unsigned, unsigned> (m + 2, m + 3));
+		}
+	      else
+		{
+		  links.push_back (std::pair<unsigned, unsigned> (m, m + 3));
+		  links.push_back (std::pair<unsigned, unsigned> (m + 1, m + 2));
+		}
+  
+	      std::vector<int> inc (2 * (m + 4), -1);
+	      for (unsigned l = 0; l < links.size (); l ++)
+		{
+		  unsigned a = links[l].first,
+		    b = links[l].second;
+		  inc[2 * a + (inc[2 * a] >= 0)] = l;
+		  inc[2 * b + (inc[2 * b] >= 0)] = l;
+		}
+  
+	      std::vector<bool> used (links.size ());
+	      pairing new_pr (new_frontier.size ());
+	      for (unsigned x = 0; x < m + 4; x ++)
+		{
+		  if (node_pos[x] < 0)
+		    continue;
+  
+		  unsigned y = x;
+		  int l = inc[2 * x];
+		  if (used[l])
+		    continue;
+		  for (;;)
+		    {
+		      used[l] = 1;
+		      y = links[l].first == y ? links[l].second : links[l].first;
+		      if (node_pos[y] >= 0)
+			break;
+		      l = inc[2 * y] == l ? inc[2 * y + 1] : inc[2 * y];
+		    }
+		  new_pr[node_pos[x]] = node_pos[y];
+		  new_pr[node_pos[y]] = node_pos[x];
+		}
+  
+	      unsigned circles = 0;
+	      for (unsigned l0 = 0; l0 < links.size (); l0 ++)
+		{
+		  if (used[l0])
+		    continue;
+  
+		  circles ++;
+		  unsigned y = links[l0].first;
+		  int l = l0;
+		  do {
+		    used[l] = 1;
+		    y = links[l].first == y ? links[l].second : links[l].first;
+		    l = inc[2 * y] == l ? inc[2 * y + 1] : inc[2 * y];
+		  } while (!used[l]);
+		}
+  
+	      // <X> = <0-resolution> - q <1-resolution>
+	      bracket_poly w;
+	      w.add (s->second, r, r);
+	      w.mul_circles (circles);
+	      new_states[new_pr].add (w, 0, 0);
+	    }
+	}
+      states.swap (new_states);
+  
+      done[c] = 1;
+      for (unsigned j = 0; j < m; j ++)
+	edge_pos[frontier[j]] = -1;
+      frontier.swap (new_frontier);
+      for (unsigned j = 0; j < frontier.size (); j ++)
+	edge_pos[frontier[j]] = j;
+    }
+  assert (frontier.size () == 0
+	  && states.size () == 1);
+  
+  bracket_poly b = states[pairing ()];
+  if (n == 0)
+    b.mul_circles (1);
+  if (reduced)
+    b.div_circle ();
+  
+  // (-1)^n_- q^(n_+ - 2n_-)
+  multivariate_laurentpoly<Z> jones;
+  int shift = (int)kd.nplus - 2 * (int)kd.nminus;
+  bool negate = is_odd (kd.nminus);
+  for (unsigned i = 0; i < b.c.size (); i ++)
+    {
+      if (b.c[i] == 0)
+	continue;
+      jones += multivariate_laurentpoly<Z> (Z (negate ? mpz_class (-b.c[i]) : b.c[i]),
+					    VARIABLE, 2, b.low + (int)i + shift);
+    }
+  return jones;
+}
+
+multivariate_laurentpoly<Z>
+thin_khovanov_polynomial (const knot_diagram &kd, bool reduced, bool char2)
+{
+  assert (kd.num_components () == 1);
+  
+  int s = -kd.signature ();
+  
+  // dimensions are the coefficients up to the sign (-1)^t
+  bivariate_laurentpoly khr;
+  multivariate_laurentpoly<Z> jr = jones_polynomial (kd, 1);
+  for (map<multivariate_laurent_monomial, Z>::const_iter i = jr.coeffs; i; i ++)
+    {
+      int j = i.key ().m(2, 0);
+      int64 x = i.val ().get_si ();
+      assert (is_even (j - s));
+      int h = (j - s) / 2;
+      if (is_odd (h))
+	x = -x;
+      if (x < 0)
+	{
+	  fprintf (stderr, "error: %s is not Kh-thin\n", kd.name.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+      khr.add_term (x, h, j);
+    }
+  if (reduced)
+    return khr.multivariate ();
+  
+  if (char2)
+    {
+      bivariate_laurentpoly circle (1, 0, 1);
+      circle.add_term (1, 0, -1);
+      return (khr * circle).multivariate ();
+    }
+  
+  /* J - q^(s-1) - q^(s+1) = (1 - q^4) sum_h (-1)^h c_h q^(2h+s-1),
+     c_h the pairs from t^h q^(2h+s-1) to t^(h+1) q^(2h+s+3). */
+  bivariate_laurentpoly j (jones_polynomial (kd));
+  j.add_term (-1, 0, s - 1);
+  j.add_term (-1, 0, s + 1);
+  j.trim ();
+  
+  bivariate_laurentpoly kh (1, 0, s - 1);
+  kh.add_term (1, 0, s + 1);
+  std::map<int, int64> pairs;
+  if (j.twidth)
+    {
+      // divide from the bottom
+      for (int e = j.qlow; e < j.qlow + (int)j.qwidth; e ++)
+	{
+	  int64 x = j.coeff (0, e) + (pairs.count (e - 4) ? pairs[e - 4] : 0);
+	  if (x != 0)
+	    pairs[e] = x;
+	}
+      for (std::map<int, int64>::const_iterator i = pairs.begin (); i != pairs.end (); i ++)
+	{
+	  int e = i->first;
+	  assert (is_even (e - s + 1));
+	  int h = (e - s + 1) / 2;
+	  int64 x = is_odd (h) ? -i->second : i->second;
+	  if (x < 0 || e + 4 >= j.qlow + (int)j.qwidth)
+	    {
+	      fprintf (stderr, "error: %s is not Kh-thin\n", kd.name.c_str ());
+	      exit (EXIT_FAILURE);
+	    }
+	  kh.add_term (x, h, e);
+	  kh.add_term (x, h + 1, e + 4);
+	}
+    }
+  return kh.multivariate ();
+}
@@ -0,0 +1,17 @@
+
+/* The Jones polynomial of kd straight from a Kauffman bracket state
+   sum, without building the Khovanov complex.  The result is in the
+   variable q (x2), normalized like the graded Euler characteristic of
+   Khovanov homology: the unknot is q + q^-1, or 1 when reduced. */
+multivariate_laurentpoly<Z> jones_polynomial (const knot_diagram &kd,
+					      bool reduced = 0);
+
+/* The Khovanov polynomial (in t = x1 and q = x2, like
+   free_poincare_polynomial) of a Kh-thin knot, e.g. an alternating or
+   quasi-alternating one, from its Jones polynomial and signature.
+   Reduced homology lies on the diagonal q = 2t - signature; the
+   unreduced one is that times q + q^-1 over Z2 (char2) and otherwise
+   the two Lee generators plus knight move pairs. */
+multivariate_laurentpoly<Z> thin_khovanov_polynomial (const knot_diagram &kd,
+						      bool reduced = 0,
+						      bool char2 = 0);
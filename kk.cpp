@@ -25,29 +25,56 @@ usage ()
 	    << "  s: Rasmussen's s-invariant coming from lee\n"
 	    << "  khp: computes Khovanov polynomial of a link\n"
 	    << "  jones: computes Jones polynomial of a link\n"
+	    << "  alexander: computes Alexander polynomial of a knot\n"
+	    << "  signature: signature of a knot or link\n"
+	    << "  ttkh: totally twisted Khovanov homology, over Z2(t)\n"
 	    << "  periodicity: uses periodicity criterion of Przytycki and\n"
 	    << "    the criterion in terms of Khovanov polynomial\n"
+	    << "  serve: run as a server answering kk requests, one per line,\n"
+	    << "    on stdin or a socket; see kk serve -h\n"
 	    << "output:\n"
 	    << "    kh, gss, lsss, leess: .tex file\n"
 	    << "    sq2: text in Sage format\n"
-	    << "    s, khp, jones, periodicity: text\n"
+	    << "    s, khp, jones, alexander, signature, ttkh, periodicity: text\n"
 	    << "options:\n"
 	    << "  -r         : compute reduced theory\n"
 	    << "  -h         : print this message\n"
 	    << "  -o <file>  : write output to <file>\n"
 	    << "                (stdout is the default)\n"
 	    << "  -f <field> : ground field (if applicable)\n"
-	    << "                (Z2 is the default)\n"
+	    << "                (Z2 is the default); periodicity accepts a\n"
+	    << "                comma separated list, e.g. Z2,Z3,Q\n"
 	    << "  -v         : verbose: report progress as the computation proceeds\n"
+	    << "  -c <dir>   : periodically checkpoint long computations to <dir>\n"
+	    << "                and resume from checkpoints found there\n"
+	    << "  -ci <secs> : seconds between checkpoints (600 is the default)\n"
+	    << "  -store <dir>: reuse the invariants recorded in the store <dir>\n"
+	    << "                and record new ones there\n"
+	    << "  -m <MB>    : out of core: keep about <MB> megabytes of large\n"
+	    << "                maps in memory and the rest on disk\n"
+	    << "  -md <dir>  : directory for out of core data\n"
+	    << "                ($TMPDIR or /tmp is the default)\n"
+	    << "  -thin      : khp: the knot is Kh-thin (e.g. quasi-alternating);\n"
+	    << "                compute from the Jones polynomial and signature\n"
+	    << "                (the default for alternating diagrams)\n"
+	    << "  -nothin    : khp: always compute from the cube\n"
+	    << "  -checkthin : khp: compute both ways and check they agree\n"
+	    << "                (-thin and -checkthin need a field, not -f Z)\n"
+	    << "  -exact     : ttkh: compute over Z2(t) rather than at points\n"
+	    << "                of an extension of Z2\n"
+	    << "  -j <n>     : periodicity, ttkh, khp -f Z: number of threads\n"
+	    << "                (the number of cores is the default)\n"
 	    << "  -p         : period when verifying periodicity, can be equal to\n"
 	    << "                 5,7,11,13,17 or 19\n"
 	    << "  -t         : type of periodicity test:\n"
+	    << "                 - Murasugi - Murasugi's test on the Alexander polynomial\n"
 	    << "                 - Przytycki - Przytycki's periodicity test\n"
 	    << "                 - Kh - periodicity criterion in terms of Khovanov homology\n"
-	    << "                 - all - uses both criteria and tests for all prime\n"
+	    << "                 - all - uses all criteria and tests for all prime\n"
 	    << "                         periods between 5 and 19\n"
 	    << "<field> can be one of:\n"
-	    << "  Z2, Z3, Q\n"
+	    << "  Z2, Z3, Q; khp also accepts Z5, Z7 and Z, the last\n"
+	    << "    giving the free part and the torsion of Kh over Z\n"
 	    << "<link> can be one of:\n"
 	    << "  - the unknot, e.g. U or unknot\n"
 	    << "  - a torus knot, e.g. T(2,3)\n"
@@ -62,7 +89,9 @@ usage ()
 	    << "      DT[dadbcda] or\n"
 	    << "      DT[{6, -8}, {-10, 12, -14, 2, -4}]\n"
 	    << "  - a braid, e.g. BR[2, {-1, -1, -1}]\n"
-	    << "  - disjoint union (juxtaposition), e.g. T(2,3) U\n";
+	    << "  - disjoint union (juxtaposition), e.g. T(2,3) U\n"
+	    << "The HTW and MT tables are read from the directory $KNOTKIT_TABLES,\n"
+	    << "or from the source directory if it is unset.\n";
 }
 
 FILE *outfp = stdout;
@@ -89,9 +118,15 @@ const char *invariant = 0;
 const char *field = "Z2";
 knot_diagram kd;
 bool reduced = 0;
+// khp: treat the knot as Kh-thin, never, or check against the cube
+bool assume_thin = 0,
+  no_thin = 0,
+  check_thin = 0;
+bool exact = 0;
 
 extern int period;
 extern std::string periodicity_test;
+extern unsigned periodicity_threads;
 
 class hg_grading_mapper
 {
@@ -284,8 +319,31 @@ multivariate_laurentpoly<Z> compute_khp(const knot_diagram& k, bool reduced = fa
   return C->free_poincare_polynomial();
 }
 
+integral_homology
+compute_integral_kh (knot_diagram &k, bool reduced = false)
+{
+  cube<Z> c (k, reduced);
+  mod_map<Z> d = c.compute_d (1, 0, 0, 0, 0);
+  
+  chain_complex_simplifier<Z> s (c.khC, d,
+				 maybe<int> (1), maybe<int> (0));
+  return integral_homology (s.new_C, s.new_d, periodicity_threads);
+}
+
+template<class F>
+multivariate_laurentpoly<Z> compute_ttkh(const knot_diagram& k) {
+  spanning_tree_complex<F> c (kd);
+  if(!exact)
+    return c.totally_twisted_kh_homology (periodicity_threads).multivariate ();
+  
+  typedef typename spanning_tree_complex<F>::R R;
+  chain_complex_simplifier<R> s (c.C, c.totally_twisted_kh_d (),
+				 maybe<int> (2), maybe<int> ());
+  return s.new_C->free_poincare_polynomial();
+}
+
 multivariate_laurentpoly<Z> compute_jones(const knot_diagram& k, bool reduced = false) {
-  return compute_khp<Z2>(k, reduced).evaluate(-1, 1);  
+  return jones_polynomial(k, reduced);
 }
 
 template<class R>
@@ -295,39 +353,8 @@ int compute_s_inv(knot_diagram& kd) {
     fprintf (stderr, "error: s-invariant only defined for knots\n");
     exit (EXIT_FAILURE);
   }
-      
-  cube<R> c (kd, 0);
-  ptr<const module<R> > C = c.khC;
-      
-  mod_map<R> d = c.compute_d (1, 0, 0, 0, 0);
-  for (unsigned i = 1; i <= kd.n_crossings; i ++)
-    d = d + c.H_i (i);
-  assert (d.compose (d) == 0);
-      
-  int k = 0;
-  for (;;) {
-    chain_complex_simplifier<R> s (C, d,
-				   maybe<int> (1),
-				   maybe<int> (2*k));
-    C = s.new_C;
-    d = s.new_d;
-    k ++;
-	  
-    if (d == 0)
-      break;
-  }
-      
-  assert (C->dim () == 2);
-  grading gr1 = C->generator_grading (1),
-    gr2 = C->generator_grading (2);
-  C->free_poincare_polynomial().display_self();
-  int qmin = gr1.q,
-    qmax = gr2.q;
-  if (qmax < qmin)
-    std::swap (qmin, qmax);
-      
-  assert (qmax == qmin + 2);
-  return qmin + 1;
+  
+  return s_invariant<R> (kd);
 }
 
 template<class R> void
@@ -563,6 +590,19 @@ sage_show_khsq (FILE *fp,
 void
 compute_sq2 ()
 {
+  // precomputed for table knots by kk_cache -sq
+  knot_desc desc = knot_desc::from_name (knot);
+  if (desc.t != knot_desc::NONE)
+    {
+      if (const mapped_maps *m = sq_cache::find (desc.t, desc.i))
+	{
+	  mod_map<Z2> sq1 = m->map (2 * desc.j - 1),
+	    sq2 = m->map (2 * desc.j);
+	  sage_show_khsq (outfp, sq1.domain (), sq1, sq2);
+	  return;
+	}
+    }
+  
   cube<Z2> c (kd);
   mod_map<Z2> d = c.compute_d (1, 0, 0, 0, 0);
   
@@ -611,11 +651,183 @@ run_demo ()
 	}
 }
 
-int
-main (int argc, char **argv)
+/* Writes the invariant of kd to outfp or std::cout. */
+void
+compute_output ()
 {
-  program_name = argv[0];
+  if (!strcmp (invariant, "sq2")) {
+    if (strcmp (field, "Z2")) {
+      fprintf (stderr, "warning: sq2 only defined over Z2, ignoring -f %s\n", field);
+      field = "Z2";
+    }
+      
+    compute_sq2 ();
+  }
+  else if (!strcmp (invariant, "gss")) {
+    if (strcmp (field, "Z2")) {
+      fprintf (stderr, "warning: gss only defined over Z2, ignoring -f %s\n", field);
+      field = "Z2";
+    }
+      
+    compute_gss ();
+  }
+  else if(!strcmp(invariant, "jones")) {
+    std::cout << "Jones polynomial of " << knot << " = " << compute_jones(kd, reduced) << "\n";
+  }
+  else if(!strcmp(invariant, "signature")) {
+    std::cout << "signature(" << knot << ") = " << kd.signature() << "\n";
+  }
+  else if(!strcmp(invariant, "alexander")) {
+    if(kd.num_components() != 1) {
+      fprintf(stderr, "error: alexander only defined for knots\n");
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "Alexander polynomial of " << knot << " = " << alexander_polynomial(kd) << "\n";
+  }
+  else if(!strcmp(invariant, "ttkh")) {
+    if (strcmp (field, "Z2")) {
+      fprintf (stderr, "warning: ttkh only defined over Z2, ignoring -f %s\n", field);
+      field = "Z2";
+    }
+    std::cout << "Totally twisted Khovanov polynomial (coefficients in Z2(t)) of "
+	      << knot << " = " << std::endl
+	      << compute_ttkh<Z2>(kd) << std::endl;
+  }
+  else if(!strcmp(invariant, "periodicity")) {
+    check_periodicity(kd, std::string(knot), period, std::string(field));
+  }
+  else if(!strcmp(invariant, "khp") && !strcmp(field, "Z")) {
+    // torsion has no thin shortcut
+    if(assume_thin || check_thin) {
+      std::cerr << "error: -thin and -checkthin need a field, not -f Z\n";
+      exit (EXIT_FAILURE);
+    }
+    integral_homology H = compute_integral_kh(kd, reduced);
+    std::cout << "Khovanov polynomial (coefficients in Z) of " << knot
+	      << " = " << std::endl
+	      << H.free.multivariate() << std::endl;
+    for(std::map<unsigned long, bivariate_laurentpoly>::const_iterator i = H.torsion.begin();
+	i != H.torsion.end();
+	i ++)
+      std::cout << "torsion Z/" << i->first << ": "
+		<< i->second.multivariate() << std::endl;
+  }
+  else if(!strcmp(invariant, "khp")) {
+    if(strcmp(field, "Z2") && strcmp(field, "Z3") && strcmp(field, "Z5")
+       && strcmp(field, "Z7") && strcmp(field, "Q")) {
+      std::cerr << "Unknown field: " << field << std::endl;
+      exit (EXIT_FAILURE);
+    }
+  
+    // Kh-thin knots need no cube
+    multivariate_laurentpoly<Z> khp;
+    bool thin = !no_thin
+      && kd.num_components() == 1
+      && (assume_thin || kd.is_alternating());
+    if(thin)
+      khp = thin_khovanov_polynomial(kd, reduced, !strcmp(field, "Z2"));
+    if(!thin || check_thin) {
+      multivariate_laurentpoly<Z> full;
+      if(!strcmp(field, "Z2"))
+	full = compute_khp<Z2>(kd, reduced);
+      else if(!strcmp(field, "Z3"))
+	full = compute_khp<Zp<3>>(kd, reduced);
+      else if(!strcmp(field, "Z5"))
+	full = compute_khp<Zp<5>>(kd, reduced);
+      else if (!strcmp(field, "Z7"))
+	full = compute_khp<Zp<7>>(kd,reduced);
+      else
+	full = compute_khp<Q>(kd, reduced);
+      if(thin && full != khp) {
+	std::cerr << "error: thin Khovanov polynomial of " << knot
+		  << " does not match the cube:\n" << khp << "\n";
+	exit (EXIT_FAILURE);
+      }
+      khp = full;
+    }
+    std::cout << "Khovanov polynomial (coefficients in " << field
+	      << ") of " << knot <<  " = " << std::endl
+	      << khp << std::endl;
+  }
+  else {
+    if (!strcmp (field, "Z2"))
+      compute_invariant<Z2> ();
+    else if (!strcmp (field, "Z3"))
+      compute_invariant<Zp<3>> ();
+    else if (!strcmp (field, "Q"))
+      compute_invariant<Q> ();
+    else {
+      fprintf (stderr, "error: unknown field %s\n", field);
+      exit (EXIT_FAILURE);
+    }
+  }
+}
+
+// stands for the knot's name in stored output
+static const char name_marker[] = "\001";
+
+static std::string
+replace_name_marker (std::string s)
+{
+  size_t i;
+  while ((i = s.find (name_marker[0])) != std::string::npos)
+    s.replace (i, 1, knot);
+  return s;
+}
+
+/* compute_output () through the invariant store, see
+   invariant_store.h, on the canonical numbering of kd.  The output is
+   kept with the knot's name replaced by a marker, so an entry serves
+   every name of the diagram, and what went to outfp apart from what
+   went to std::cout.  A -thin guess is not a result and is not
+   saved. */
+void
+stored_output ()
+{
+  std::string key = std::string ("kk ") + invariant + " " + field;
+  if (reduced)
+    key += " reduced";
+  if (!strcmp (invariant, "periodicity"))
+    key += " " + std::to_string (period) + " " + periodicity_test;
   
+  // the marked edge (1 of the input) is carried along: reduced
+  // theories of links depend on its component
+  kd = knot_diagram (CANONICAL, kd);
+  
+  std::string value;
+  if (!invariant_store::find (kd, key, value))
+    {
+      char *out = 0;
+      size_t out_size = 0;
+      FILE *saved_outfp = outfp;
+      outfp = open_memstream (&out, &out_size);
+      std::ostringstream os;
+      std::streambuf *saved_cout = std::cout.rdbuf (os.rdbuf ());
+      const char *saved_knot = knot;
+      knot = name_marker;
+      
+      compute_output ();
+      
+      knot = saved_knot;
+      std::cout.rdbuf (saved_cout);
+      fclose (outfp);
+      outfp = saved_outfp;
+      
+      value = std::to_string (out_size) + "\n" + std::string (out, out_size) + os.str ();
+      free (out);
+      if (!assume_thin || check_thin)
+	invariant_store::save (kd, key, value);
+    }
+  
+  size_t nl = value.find ('\n');
+  size_t out_size = std::stoul (value.substr (0, nl));
+  fputs (replace_name_marker (value.substr (nl + 1, out_size)).c_str (), outfp);
+  std::cout << replace_name_marker (value.substr (nl + 1 + out_size));
+}
+
+int
+kk_main (int argc, char **argv)
+{
   const char *file = 0;
   
   for (int i = 1; i < argc; i ++) {
@@ -632,6 +844,14 @@ main (int argc, char **argv)
       }	  
       else if (!strcmp (argv[i], "-v"))
 	verbose = 1;
+      else if (!strcmp (argv[i], "-thin"))
+	assume_thin = 1;
+      else if (!strcmp (argv[i], "-nothin"))
+	no_thin = 1;
+      else if (!strcmp (argv[i], "-checkthin"))
+	check_thin = 1;
+      else if (!strcmp (argv[i], "-exact"))
+	exact = 1;
       else if (!strcmp (argv[i], "-f")) {
 	i ++;
 	if (i == argc) {
@@ -640,6 +860,54 @@ main (int argc, char **argv)
 	}
 	field = argv[i];
       }
+      else if (!strcmp (argv[i], "-c")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-c'\n");
+	  exit (EXIT_FAILURE);
+	}
+	checkpoint_dir = argv[i];
+      }
+      else if (!strcmp (argv[i], "-store")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-store'\n");
+	  exit (EXIT_FAILURE);
+	}
+	store_dir = argv[i];
+      }
+      else if (!strcmp (argv[i], "-ci")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-ci'\n");
+	  exit (EXIT_FAILURE);
+	}
+	checkpoint_interval = std::stoi(argv[i]);
+      }
+      else if (!strcmp (argv[i], "-j")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-j'\n");
+	  exit (EXIT_FAILURE);
+	}
+	periodicity_threads = std::stoi(argv[i]);
+      }
+      else if (!strcmp (argv[i], "-m")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-m'\n");
+	  exit (EXIT_FAILURE);
+	}
+	spill_budget = (uint64)std::stoul(argv[i]) << 20;
+      }
+      else if (!strcmp (argv[i], "-md")) {
+	i ++;
+	if (i == argc) {
+	  fprintf (stderr, "error: missing argument to option `-md'\n");
+	  exit (EXIT_FAILURE);
+	}
+	spill_dir = argv[i];
+      }
       else if (!strcmp (argv[i], "-o")) {
 	i ++;
 	if (i == argc) {
@@ -719,62 +987,33 @@ main (int argc, char **argv)
     newline ();
   }
 	
-  if (!strcmp (invariant, "sq2")) {
-    if (strcmp (field, "Z2")) {
-      fprintf (stderr, "warning: sq2 only defined over Z2, ignoring -f %s\n", field);
-      field = "Z2";
-    }
-      
-    compute_sq2 ();
-  }
-  else if (!strcmp (invariant, "gss")) {
-    if (strcmp (field, "Z2")) {
-      fprintf (stderr, "warning: gss only defined over Z2, ignoring -f %s\n", field);
-      field = "Z2";
-    }
-      
-    compute_gss ();
-  }
-  else if(!strcmp(invariant, "jones")) {
-    std::cout << "Jones polynomial of " << knot << " = " << compute_jones(kd, reduced) << "\n";
-  }
-  else if(!strcmp(invariant, "periodicity")) {
-    check_periodicity(kd, std::string(knot), period, std::string(field));
-  }
-  else if(!strcmp(invariant, "khp")) {
-    multivariate_laurentpoly<Z> khp;
-    if(!strcmp(field, "Z2"))
-      khp = compute_khp<Z2>(kd, reduced);
-    else if(!strcmp(field, "Z3"))
-      khp = compute_khp<Zp<3>>(kd, reduced);
-    else if(!strcmp(field, "Z5"))
-      khp = compute_khp<Zp<5>>(kd, reduced);
-    else if (!strcmp(field, "Z7"))
-      khp = compute_khp<Zp<7>>(kd,reduced);
-    else if(!strcmp(field, "Q"))
-      khp = compute_khp<Q>(kd, reduced);
-    else
+  if (invariant_store::enabled ())
+    stored_output ();
+  else
+    compute_output ();
+  
+  if (verbose)
     {
-      std::cerr << "Unknown field: " << field << std::endl;
-      exit (EXIT_FAILURE);
-    }
-    std::cout << "Khovanov polynomial (coefficients in " << field
-	      << ") of " << knot <<  " = " << std::endl
-	      << khp << std::endl;
-  }
-  else {
-    if (!strcmp (field, "Z2"))
-      compute_invariant<Z2> ();
-    else if (!strcmp (field, "Z3"))
-      compute_invariant<Zp<3>> ();
-    else if (!strcmp (field, "Q"))
-      compute_invariant<Q> ();
-    else {
-      fprintf (stderr, "error: unknown field %s\n", field);
-      exit (EXIT_FAILURE);
+      module<Z2>::show_registry_stats ();
+      module<Zp<3> >::show_registry_stats ();
+      module<Q>::show_registry_stats ();
     }
-  }
   
   if (file)
     fclose (outfp);
+  
+  return 0;
+}
+
+extern int kk_serve (int argc, char **argv);
+
+int
+main (int argc, char **argv)
+{
+  program_name = argv[0];
+  
+  if (argc > 1 && !strcmp (argv[1], "serve"))
+    return kk_serve (argc, argv);
+  
+  return kk_main (argc, argv);
 }
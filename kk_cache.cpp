@@ -0,0 +1,155 @@
+#include <knotkit.h>
+
+#include <sys/stat.h>
+
+/* Writes the diagram caches read by knot_desc::diagram (), and with
+   -sq the Steenrod square caches read by kk sq2, see
+   diagram_cache.h. */
+
+static const struct {
+  const char *name;
+  knot_desc::table t;
+  unsigned max_n;
+} tables[] = {
+  { "rolfsen", knot_desc::ROLFSEN, 10 },
+  { "htw", knot_desc::HTW, 16 },
+  { "htw_alt", knot_desc::HTW_ALT, 16 },
+  { "htw_nonalt", knot_desc::HTW_NONALT, 16 },
+  { "mt", knot_desc::MT, 14 },
+  { "mt_alt", knot_desc::MT_ALT, 14 },
+  { "mt_nonalt", knot_desc::MT_NONALT, 14 },
+};
+
+static const unsigned n_tables = sizeof (tables) / sizeof (tables[0]);
+
+void
+usage ()
+{
+  printf ("usage: kk_cache [options...] <table> <n>...\n"
+	  "  writes the knot_diagrams of the table knots with n crossings\n"
+	  "  to $KNOTKIT_TABLES/cache (the source directory by default)\n"
+	  "<table> can be one of:\n"
+	  "  rolfsen, htw, htw_alt, htw_nonalt, mt, mt_alt, mt_nonalt\n"
+	  "options:\n"
+	  "  -h         : print this message\n"
+	  "  -o <file>  : write to <file> (one <n> only)\n"
+	  "  -check     : read the cache back and compare every diagram\n"
+	  "                with the one built from the table\n"
+	  "  -sq        : write sq1 and sq2 on Z2 Kh of the knots, for kk sq2,\n"
+	  "                to $KNOTKIT_TABLES/cache/<table>_<n>.sq instead\n");
+}
+
+static bool
+same_diagram (const knot_diagram &kd1, const knot_diagram &kd2)
+{
+  return kd1.name == kd2.name
+    && kd1.n_crossings == kd2.n_crossings
+    && kd1.marked_edge == kd2.marked_edge
+    && kd1.crossings == kd2.crossings
+    && kd1.ept_crossing == kd2.ept_crossing
+    && kd1.ept_index == kd2.ept_index
+    && kd1.edge_smoothing_oriented == kd2.edge_smoothing_oriented
+    && kd1.nminus == kd2.nminus
+    && kd1.nplus == kd2.nplus;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *file = 0;
+  bool check = 0;
+  bool sq = 0;
+  
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i ++)
+    {
+      if (!strcmp (argv[i], "-h"))
+	{
+	  usage ();
+	  exit (EXIT_SUCCESS);
+	}
+      else if (!strcmp (argv[i], "-o"))
+	{
+	  i ++;
+	  if (i == argc)
+	    {
+	      fprintf (stderr, "error: missing argument to option `-o'\n");
+	      exit (EXIT_FAILURE);
+	    }
+	  file = argv[i];
+	}
+      else if (!strcmp (argv[i], "-check"))
+	check = 1;
+      else if (!strcmp (argv[i], "-sq"))
+	sq = 1;
+      else
+	{
+	  fprintf (stderr, "error: unknown argument `%s'\n", argv[i]);
+	  fprintf (stderr, "  use -h for usage\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
+  
+  if (argc - i < 2
+      || (file && argc - i != 2))
+    {
+      fprintf (stderr, "error: expected <table> <n>...\n");
+      fprintf (stderr, "  use -h for usage\n");
+      exit (EXIT_FAILURE);
+    }
+  
+  unsigned k = 0;
+  while (k < n_tables && strcmp (tables[k].name, argv[i]))
+    k ++;
+  if (k == n_tables)
+    {
+      fprintf (stderr, "error: unknown table `%s'\n", argv[i]);
+      exit (EXIT_FAILURE);
+    }
+  knot_desc::table t = tables[k].t;
+  
+  if (!file)
+    mkdir (knot_table_file ("cache").c_str (), 0777);
+  
+  for (i ++; i < argc; i ++)
+    {
+      unsigned n = atoi (argv[i]);
+      if (n < 1 || n > tables[k].max_n)
+	{
+	  fprintf (stderr, "error: %s has no knots with %s crossings\n",
+		   tables[k].name, argv[i]);
+	  exit (EXIT_FAILURE);
+	}
+  
+      if (sq)
+	{
+	  std::string out = file ? std::string (file) : sq_cache::file_name (t, n);
+	  write_sq_cache (out, t, n);
+  
+	  mapped_maps m (out);
+	  printf ("%s: %d maps\n", out.c_str (), m.n_maps ());
+	  continue;
+	}
+  
+      std::string out = file ? std::string (file) : diagram_cache::file_name (t, n);
+      write_diagram_cache (out, t, n);
+  
+      diagram_cache dc (out);
+      printf ("%s: %d diagrams\n", out.c_str (), dc.n_knots);
+  
+      if (check)
+	{
+	  for (unsigned j = 1; j <= dc.n_knots; j ++)
+	    {
+	      if (!same_diagram (dc.diagram (j), knot_desc (t, n, j).compute_diagram ()))
+		{
+		  fprintf (stderr, "error: %s: diagram %d does not match its table\n",
+			   out.c_str (), j);
+		  exit (EXIT_FAILURE);
+		}
+	    }
+	}
+    }
+  
+  return 0;
+}
@@ -0,0 +1,1022 @@
+#include <knotkit.h>
+
+#include <deque>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Batch driver: computes a list of invariants for a stream of knots,
+   one per line, on a pool of worker processes.  The workers are
+   forked once and each computes many knots, so the tables are mapped
+   and parsed once per worker rather than once per knot.  Processes
+   rather than threads because modules and refcounts are shared
+   program-wide without locks; a worker that dies (a parse error, a
+   failed assertion) costs only the knot it was computing.  Each
+   worker has at most `depth' knots outstanding, and with ordered
+   output at most `window' knots are read ahead of the last one
+   written.
+
+   With a budget (-time, -mem) or -sort, each knot first goes to a
+   worker for an estimate of its cost (see cost_model.h); the workers
+   parse the knots, since a bad one exits.  Knots over budget are
+   refused, and the others are handed out, largest first with -sort,
+   while the estimated memory of the knots in flight stays within
+   -mem. */
+
+const char *program_name;
+
+const char *field = "Z2";
+bool reduced = 0;
+std::vector<std::string> invariants;
+
+// for estimates; 0 without a budget or -sort
+const cost_model *model = 0;
+
+// with -record, runs are recorded here, one line each
+const char *record_file = 0;
+FILE *record_fp = 0;
+
+static const char *known_invariants[] = {
+  "crossings", "components", "signature", "jones", "alexander",
+  "khp", "s", "ttkh",
+};
+
+void
+usage ()
+{
+  printf ("usage: %s [options...] [<file>]\n"
+	  "  computes invariants of the knots and links in <file>, one per\n"
+	  "  line in any form kk accepts (stdin is the default); empty lines\n"
+	  "  and lines starting with # are skipped\n"
+	  "output: one line per knot,\n"
+	  "  <n> TAB <link> TAB <invariant>=<value> TAB ...\n"
+	  "  where <n> counts the knots of the input from 1, or\n"
+	  "  <n> TAB <link> TAB error=<message>\n"
+	  "options:\n"
+	  "  -h         : print this message\n"
+	  "  -i <list>  : comma separated invariants to compute, of\n"
+	  "                crossings, components, signature, jones,\n"
+	  "                alexander, khp, s, ttkh (khp is the default)\n"
+	  "  -f <field> : ground field for khp and s: Z2, Z3, Q; khp also\n"
+	  "                accepts Z5, Z7 and Z (Z2 is the default)\n"
+	  "  -r         : reduced khp and jones\n"
+	  "  -j <n>     : number of worker processes\n"
+	  "                (the number of cores is the default)\n"
+	  "  -d <n>     : knots outstanding per worker (2 is the default)\n"
+	  "  -u         : write results as they complete rather than in\n"
+	  "                input order\n"
+	  "  -o <file>  : write output to <file> (stdout is the default)\n"
+	  "  -store <dir>: reuse the invariants recorded in the store <dir>\n"
+	  "                and record new ones there\n"
+	  "cost estimates (see cost_model.h):\n"
+	  "  -time <s>  : refuse knots estimated to take more than <s> seconds\n"
+	  "  -mem <MB>  : refuse knots estimated to need more than <MB>\n"
+	  "                megabytes, and keep the knots computed at once\n"
+	  "                within <MB> together\n"
+	  "  -over <file>: write the knots refused to <file>, one per line\n"
+	  "  -sort      : read all the knots, then compute the ones\n"
+	  "                estimated to take longest first\n"
+	  "  -model <file>: cost model to use (the default is\n"
+	  "                $KNOTKIT_TABLES/cost_model if present, or the\n"
+	  "                built in one)\n"
+	  "  -record <file>: compute each invariant in a process of its\n"
+	  "                own and append its time and peak memory to <file>\n"
+	  "  -calibrate <file>: fit the cost model to the runs recorded in\n"
+	  "                <file> and write it to the output\n",
+	  program_name);
+}
+
+template<class R> static multivariate_laurentpoly<Z>
+cube_khp (knot_diagram &kd)
+{
+  cube<R> c (kd, reduced);
+  mod_map<R> d = c.compute_d (1, 0, 0, 0, 0);
+  
+  chain_complex_simplifier<R> s (c.khC, d,
+				 maybe<int> (1), maybe<int> (0));
+  return s.new_C->free_poincare_polynomial ();
+}
+
+static multivariate_laurentpoly<Z>
+khp (knot_diagram &kd)
+{
+  // as kk: Kh-thin knots need no cube
+  if (kd.num_components () == 1
+      && kd.is_alternating ())
+    return thin_khovanov_polynomial (kd, reduced, !strcmp (field, "Z2"));
+  
+  if (!strcmp (field, "Z2"))
+    return cube_khp<Z2> (kd);
+  else if (!strcmp (field, "Z3"))
+    return cube_khp<Zp<3> > (kd);
+  else if (!strcmp (field, "Z5"))
+    return cube_khp<Zp<5> > (kd);
+  else if (!strcmp (field, "Z7"))
+    return cube_khp<Zp<7> > (kd);
+  else
+    {
+      assert (!strcmp (field, "Q"));
+      return cube_khp<Q> (kd);
+    }
+}
+
+static multivariate_laurentpoly<Z>
+dual (const multivariate_laurentpoly<Z> &p)
+{
+  return invert_variable (invert_variable (p, 1), 2);
+}
+
+/* The results for the knot spec, as the tail of an output line, or
+   an error=... field.  With a store, the diagram is put in canonical
+   form first, so that every numbering and orientation of it shares
+   the entries, and the entries for its mirror image are derived from
+   its own where duality gives them: Kh over a field and the Jones
+   polynomial in t^-1 and q^-1, the torsion of Kh over Z shifted by
+   one, s and the signature negated. */
+static std::string
+compute (const std::string &spec)
+{
+  knot_diagram kd = parse_knot (spec.c_str ());
+  kd.marked_edge = 1;
+  knot_diagram mirror_kd;
+  if (invariant_store::enabled ())
+    {
+      // the marked edge is carried along
+      kd = knot_diagram (CANONICAL, kd, 1);
+      knot_diagram m (MIRROR, kd);
+      m.marked_edge = kd.marked_edge;
+      mirror_kd = knot_diagram (CANONICAL, m, 1);
+    }
+  
+  // reduced theories of links depend on the marked component
+  bool derive_mirror = invariant_store::enabled ()
+    && (!reduced || kd.num_components () == 1);
+  
+  std::ostringstream os;
+  for (unsigned i = 0; i < invariants.size (); i ++)
+    {
+      const std::string &inv = invariants[i];
+      if (i > 0)
+	os << "\t";
+      
+      // the store holds the fields for inv, e.g. khp=... khp_torsion_2=...
+      std::string key = inv + " " + field;
+      if (reduced)
+	key += " reduced";
+      std::string value;
+      if (invariant_store::find (kd, key, value))
+	{
+	  os << value;
+	  continue;
+	}
+      std::streampos start = os.tellp ();
+      
+      // the fields for the mirror, if derived
+      std::ostringstream mos;
+      
+      if (inv == "crossings")
+	{
+	  os << "crossings=" << kd.n_crossings;
+	  mos << "crossings=" << kd.n_crossings;
+	}
+      else if (inv == "components")
+	{
+	  os << "components=" << kd.num_components ();
+	  mos << "components=" << kd.num_components ();
+	}
+      else if (inv == "signature")
+	{
+	  int sigma = kd.signature ();
+	  os << "signature=" << sigma;
+	  mos << "signature=" << -sigma;
+	}
+      else if (inv == "jones")
+	{
+	  multivariate_laurentpoly<Z> V = jones_polynomial (kd, reduced);
+	  os << "jones=" << V;
+	  mos << "jones=" << dual (V);
+	}
+      else if (inv == "alexander" || inv == "s")
+	{
+	  if (kd.num_components () != 1)
+	    return std::string ("error=") + inv + " only defined for knots";
+  
+	  if (inv == "alexander")
+	    {
+	      multivariate_laurentpoly<Z> Delta = alexander_polynomial (kd);
+	      os << "alexander=" << Delta;
+	      mos << "alexander=" << Delta;
+	    }
+	  else
+	    {
+	      int s;
+	      if (!strcmp (field, "Z2"))
+		s = s_invariant<Z2> (kd);
+	      else if (!strcmp (field, "Z3"))
+		s = s_invariant<Zp<3> > (kd);
+	      else if (!strcmp (field, "Q"))
+		s = s_invariant<Q> (kd);
+	      else
+		return std::string ("error=s not computed over ") + field;
+	      os << "s=" << s;
+	      mos << "s=" << -s;
+	    }
+	}
+      else if (inv == "khp" && !strcmp (field, "Z"))
+	{
+	  cube<Z> c (kd, reduced);
+	  mod_map<Z> d = c.compute_d (1, 0, 0, 0, 0);
+	  chain_complex_simplifier<Z> s (c.khC, d,
+					 maybe<int> (1), maybe<int> (0));
+	  integral_homology H (s.new_C, s.new_d, 1);
+  
+	  os << "khp=" << H.free.multivariate ();
+	  mos << "khp=" << dual (H.free.multivariate ());
+	  for (std::map<unsigned long, bivariate_laurentpoly>::const_iterator j = H.torsion.begin ();
+	       j != H.torsion.end ();
+	       j ++)
+	    {
+	      os << "\tkhp_torsion_" << j->first << "=" << j->second.multivariate ();
+  
+	      // Kh^{i,j} of the mirror has the torsion of Kh^{1-i,-j}
+	      multivariate_laurentpoly<Z> t (Z (1), VARIABLE, 1);
+	      mos << "\tkhp_torsion_" << j->first << "=" << t * dual (j->second.multivariate ());
+	    }
+	}
+      else if (inv == "khp")
+	{
+	  multivariate_laurentpoly<Z> P = khp (kd);
+	  os << "khp=" << P;
+	  mos << "khp=" << dual (P);
+	}
+      else
+	{
+	  assert (inv == "ttkh");
+	  spanning_tree_complex<Z2> c (kd);
+	  os << "ttkh=" << c.totally_twisted_kh_homology (1).multivariate ();
+	}
+      
+      invariant_store::save (kd, key, os.str ().substr (start));
+      if (derive_mirror && !mos.str ().empty ())
+	invariant_store::save (mirror_kd, key, mos.str ());
+    }
+  return os.str ();
+}
+
+static void
+write_all (int fd, const std::string &s)
+{
+  const char *p = s.data ();
+  size_t n = s.size ();
+  while (n > 0)
+    {
+      ssize_t r = write (fd, p, n);
+      if (r < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  // the reader has gone away; it notices on its side
+	  return;
+	}
+      p += r;
+      n -= r;
+    }
+}
+
+static std::string
+describe_status (int status)
+{
+  char buf[100];
+  if (WIFSIGNALED (status))
+    sprintf (buf, "worker killed by signal %d", WTERMSIG (status));
+  else
+    sprintf (buf, "worker exited with status %d", WEXITSTATUS (status));
+  return buf;
+}
+
+/* The shape of the cube of kd if one of the invariants needs it,
+   since walking it is most of an estimate. */
+static cube_shape
+invariants_shape (const knot_diagram &kd)
+{
+  for (unsigned i = 0; i < invariants.size (); i ++)
+    {
+      if (cost_model::needs_cube (cost_model::key (kd, invariants[i], field, reduced)))
+	return cube_shape (kd, reduced);
+    }
+  return cube_shape (kd.n_crossings);
+}
+
+/* The estimated cost of the knot spec, as "?<seconds> <bytes>": the
+   total time of its invariants, and the largest peak memory. */
+static std::string
+estimate (const std::string &spec)
+{
+  knot_diagram kd = parse_knot (spec.c_str ());
+  kd.marked_edge = 1;
+  cube_shape shape = invariants_shape (kd);
+  
+  double seconds = 0,
+    bytes = 0;
+  for (unsigned i = 0; i < invariants.size (); i ++)
+    {
+      std::string key = cost_model::key (kd, invariants[i], field, reduced);
+      cost_estimate e = model->estimate (cost_model::needs_cube (key)
+					 ? shape
+					 : cube_shape (kd.n_crossings),
+					 key);
+      seconds += e.seconds;
+      bytes = std::max (bytes, e.bytes);
+    }
+  
+  char buf[100];
+  sprintf (buf, "?%.6g %.6g", seconds, bytes);
+  return buf;
+}
+
+/* With -record: as compute, but each invariant in a child of its own,
+   whose time and peak memory are recorded with the shape of the cube
+   as a run of the invariant, for -calibrate. */
+static std::string
+compute_recorded (const std::string &spec)
+{
+  knot_diagram kd = parse_knot (spec.c_str ());
+  kd.marked_edge = 1;
+  cube_shape shape = invariants_shape (kd);
+  
+  std::vector<std::string> all = invariants;
+  std::string results;
+  for (unsigned i = 0; i < all.size (); i ++)
+    {
+      int fds[2];
+      if (pipe (fds) != 0)
+	{
+	  stderror ("pipe");
+	  exit (EXIT_FAILURE);
+	}
+  
+      fflush (record_fp);
+      pid_t pid = fork ();
+      if (pid < 0)
+	{
+	  stderror ("fork");
+	  exit (EXIT_FAILURE);
+	}
+      if (pid == 0)
+	{
+	  close (fds[0]);
+	  invariants = std::vector<std::string> (1, all[i]);
+	  write_all (fds[1], compute (spec));
+	  _exit (EXIT_SUCCESS);
+	}
+      close (fds[1]);
+  
+      std::string r;
+      char buf[4096];
+      ssize_t k;
+      while ((k = read (fds[0], buf, sizeof buf)) != 0)
+	{
+	  if (k < 0)
+	    {
+	      if (errno == EINTR)
+		continue;
+	      stderror ("read");
+	      exit (EXIT_FAILURE);
+	    }
+	  r.append (buf, k);
+	}
+      close (fds[0]);
+  
+      int status;
+      struct rusage ru;
+      while (wait4 (pid, &status, 0, &ru) < 0)
+	{
+	  if (errno != EINTR)
+	    {
+	      stderror ("wait4");
+	      exit (EXIT_FAILURE);
+	    }
+	}
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	return "error=" + describe_status (status);
+      if (r.compare (0, 6, "error=") == 0)
+	return r;
+  
+      cost_sample sample;
+      sample.key = cost_model::key (kd, all[i], field, reduced);
+      sample.shape = (cost_model::needs_cube (sample.key)
+		      ? shape
+		      : cube_shape (kd.n_crossings));
+      sample.seconds = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+			+ 1e-6 * (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec));
+      sample.bytes = 1024.0 * ru.ru_maxrss;
+      write_cost_sample (record_fp, sample);
+      fflush (record_fp);
+  
+      if (i > 0)
+	results += "\t";
+      results += r;
+    }
+  return results;
+}
+
+/* Reads "<n> TAB c TAB <link>" lines from fd_in until EOF and answers
+   each with "<n> TAB <results>" on fd_out, or "<n> TAB e TAB <link>"
+   lines with "<n> TAB ?<seconds> <bytes>", the estimated cost.  The
+   request is a field of its own, so no link can pass for one. */
+static void
+worker_main (int fd_in, int fd_out)
+{
+  FILE *fp = fdopen (fd_in, "r");
+  if (!fp)
+    {
+      stderror ("fdopen");
+      exit (EXIT_FAILURE);
+    }
+  
+  char *line = 0;
+  size_t line_size = 0;
+  ssize_t len;
+  while ((len = getline (&line, &line_size, fp)) > 0)
+    {
+      if (line[len - 1] == '\n')
+	line[len - 1] = 0;
+      char *tab = strchr (line, '\t');
+      assert (tab && tab[1] && tab[2] == '\t');
+      *tab = 0;
+      char request = tab[1];
+      std::string spec (tab + 3);
+  
+      std::string result;
+      if (request == 'e')
+	result = estimate (spec);
+      else if (record_fp)
+	result = compute_recorded (spec);
+      else
+	result = compute (spec);
+      write_all (fd_out, std::string (line) + "\t" + result + "\n");
+    }
+  free (line);
+  
+  // not exit: the parent's stdio buffers are not ours to flush
+  _exit (EXIT_SUCCESS);
+}
+
+class worker
+{
+ public:
+  pid_t pid;
+  int to, from;
+  
+  // knots sent and not yet answered, oldest first
+  std::deque<unsigned> outstanding;
+  
+  // partial line read from the worker
+  std::string buf;
+  
+ public:
+  worker () : pid(0), to(-1), from(-1) { }
+};
+
+static std::vector<worker> workers;
+
+static void
+spawn_worker (worker &w, FILE *infp, FILE *outfp)
+{
+  int down[2], up[2];
+  if (pipe (down) != 0
+      || pipe (up) != 0)
+    {
+      stderror ("pipe");
+      exit (EXIT_FAILURE);
+    }
+  
+  // don't let the child inherit buffered output
+  fflush (outfp);
+  fflush (stdout);
+  
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      stderror ("fork");
+      exit (EXIT_FAILURE);
+    }
+  if (pid == 0)
+    {
+      // the other workers see EOF only once every copy of their pipes is closed
+      for (unsigned i = 0; i < workers.size (); i ++)
+	{
+	  if (workers[i].to >= 0)
+	    close (workers[i].to);
+	  if (workers[i].from >= 0)
+	    close (workers[i].from);
+	}
+      close (down[1]);
+      close (up[0]);
+  
+      /* exit () in a worker, from the parser say, would seek the input
+	 back to where its copy of the stdio buffer starts, and the
+	 master would read those knots again */
+      close (fileno (infp));
+  
+      worker_main (down[0], up[1]);
+    }
+  
+  close (down[0]);
+  close (up[1]);
+  w.pid = pid;
+  w.to = down[1];
+  w.from = up[0];
+  w.buf.clear ();
+  assert (w.outstanding.empty ());
+}
+
+int
+main (int argc, char **argv)
+{
+  program_name = argv[0];
+  
+  const char *in_file = 0,
+    *out_file = 0;
+  std::string invariant_list = "khp";
+  unsigned n_workers = 0,
+    depth = 2;
+  bool ordered = 1;
+  bool sort = 0;
+  double time_budget = 0,
+    mem_budget = 0;
+  const char *over_file = 0,
+    *model_file = 0,
+    *calibrate_file = 0;
+  
+  for (int i = 1; i < argc; i ++)
+    {
+      if (argv[i][0] == '-' && argv[i][1] != 0)
+	{
+	  if (!strcmp (argv[i], "-h"))
+	    {
+	      usage ();
+	      exit (EXIT_SUCCESS);
+	    }
+	  else if (!strcmp (argv[i], "-r"))
+	    reduced = 1;
+	  else if (!strcmp (argv[i], "-u"))
+	    ordered = 0;
+	  else if (!strcmp (argv[i], "-sort"))
+	    sort = 1;
+	  else if (!strcmp (argv[i], "-time")
+		   || !strcmp (argv[i], "-mem")
+		   || !strcmp (argv[i], "-over")
+		   || !strcmp (argv[i], "-model")
+		   || !strcmp (argv[i], "-record")
+		   || !strcmp (argv[i], "-calibrate"))
+	    {
+	      const char *opt = argv[i];
+	      i ++;
+	      if (i == argc)
+		{
+		  fprintf (stderr, "error: missing argument to option `%s'\n", opt);
+		  exit (EXIT_FAILURE);
+		}
+	      if (!strcmp (opt, "-time"))
+		time_budget = atof (argv[i]);
+	      else if (!strcmp (opt, "-mem"))
+		mem_budget = atof (argv[i]) * 1024 * 1024;
+	      else if (!strcmp (opt, "-over"))
+		over_file = argv[i];
+	      else if (!strcmp (opt, "-model"))
+		model_file = argv[i];
+	      else if (!strcmp (opt, "-record"))
+		record_file = argv[i];
+	      else
+		calibrate_file = argv[i];
+	    }
+	  else if (!strcmp (argv[i], "-i")
+		   || !strcmp (argv[i], "-f")
+		   || !strcmp (argv[i], "-j")
+		   || !strcmp (argv[i], "-d")
+		   || !strcmp (argv[i], "-o")
+		   || !strcmp (argv[i], "-store"))
+	    {
+	      const char *opt = argv[i];
+	      i ++;
+	      if (i == argc)
+		{
+		  fprintf (stderr, "error: missing argument to option `%s'\n", opt);
+		  exit (EXIT_FAILURE);
+		}
+	      if (opt[1] == 'i')
+		invariant_list = argv[i];
+	      else if (opt[1] == 'f')
+		field = argv[i];
+	      else if (opt[1] == 'j')
+		n_workers = atoi (argv[i]);
+	      else if (opt[1] == 'd')
+		depth = std::max (1, atoi (argv[i]));
+	      else if (opt[1] == 'o')
+		out_file = argv[i];
+	      else
+		store_dir = argv[i];
+	    }
+	  else
+	    {
+	      fprintf (stderr, "error: unknown argument `%s'\n", argv[i]);
+	      fprintf (stderr, "  use -h for usage\n");
+	      exit (EXIT_FAILURE);
+	    }
+	}
+      else
+	{
+	  if (in_file)
+	    {
+	      fprintf (stderr, "error: too many arguments\n");
+	      fprintf (stderr, "  use -h for usage\n");
+	      exit (EXIT_FAILURE);
+	    }
+	  in_file = argv[i];
+	}
+    }
+  
+  std::istringstream is (invariant_list);
+  std::string inv;
+  while (std::getline (is, inv, ','))
+    {
+      unsigned k = 0;
+      while (k < sizeof (known_invariants) / sizeof (known_invariants[0])
+	     && inv != known_invariants[k])
+	k ++;
+      if (k == sizeof (known_invariants) / sizeof (known_invariants[0]))
+	{
+	  fprintf (stderr, "error: unknown invariant `%s'\n", inv.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+      invariants.push_back (inv);
+    }
+  if (invariants.empty ())
+    {
+      fprintf (stderr, "error: no invariants given\n");
+      exit (EXIT_FAILURE);
+    }
+  
+  if (strcmp (field, "Z2") && strcmp (field, "Z3") && strcmp (field, "Z5")
+      && strcmp (field, "Z7") && strcmp (field, "Q") && strcmp (field, "Z"))
+    {
+      fprintf (stderr, "error: unknown field %s\n", field);
+      exit (EXIT_FAILURE);
+    }
+  
+  if (calibrate_file)
+    {
+      // fit before opening the output, which may be the model read
+      cost_model m = model_file ? cost_model (model_file) : cost_model::standard ();
+      m.fit (read_cost_samples (calibrate_file));
+  
+      FILE *fp = out_file ? open_file (out_file, "w") : stdout;
+      m.save (fp);
+      if (fp != stdout)
+	close_file (fp);
+      return 0;
+    }
+  
+  FILE *outfp = stdout;
+  if (out_file)
+    outfp = open_file (out_file, "w");
+  
+  if (over_file && !time_budget && !mem_budget)
+    {
+      fprintf (stderr, "error: -over needs -time or -mem\n");
+      exit (EXIT_FAILURE);
+    }
+  if (record_file && !store_dir.empty ())
+    {
+      fprintf (stderr, "error: -record would time the store, not the computation\n");
+      exit (EXIT_FAILURE);
+    }
+  
+  bool budgeted = sort || time_budget > 0 || mem_budget > 0;
+  if (budgeted)
+    model = model_file ? new cost_model (model_file) : &cost_model::standard ();
+  if (record_file)
+    record_fp = open_file (record_file, "a");
+  FILE *overfp = 0;
+  if (over_file)
+    overfp = open_file (over_file, "w");
+  
+  FILE *infp = stdin;
+  if (in_file && strcmp (in_file, "-"))
+    infp = open_file (in_file, "r");
+  
+  if (n_workers == 0)
+    n_workers = std::max (1u, std::thread::hardware_concurrency ());
+  unsigned window = 4 * n_workers * depth;
+  
+  // a worker that died is noticed by EOF on its pipe, not by a signal
+  signal (SIGPIPE, SIG_IGN);
+  
+  workers.resize (n_workers);
+  for (unsigned i = 0; i < n_workers; i ++)
+    spawn_worker (workers[i], infp, outfp);
+  
+  // knots read and not yet written, by number
+  std::map<unsigned, std::string> specs;
+  // ordered: results waiting for an earlier knot
+  std::map<unsigned, std::string> done;
+  unsigned n_read = 0,
+    next_out = 1;
+  bool eof = 0;
+  char *line = 0;
+  size_t line_size = 0;
+  
+  // knots sent to a worker that died before getting to them, to
+  // compute or, budgeted, to estimate
+  std::deque<unsigned> retry;
+  
+  // budgeted: the estimated seconds and bytes of the knots waiting
+  // to be computed or being computed
+  std::map<unsigned, std::pair<double, double> > estimates;
+  // knots estimated and waiting, by priority: the estimated time with
+  // -sort (longest first), the number otherwise
+  std::multimap<double, unsigned> ready;
+  // knots read and not yet estimated, and those being estimated
+  unsigned n_unestimated = 0;
+  std::set<unsigned> estimating;
+  // knots being computed, and their estimated memory
+  unsigned n_in_flight = 0;
+  double bytes_in_flight = 0;
+  
+  // the next ready knot that fits in memory with those in flight, or 0;
+  // with -sort, none until every knot is estimated
+  auto take_ready = [&] () -> unsigned
+    {
+      if (sort && (!eof || n_unestimated > 0))
+	return 0;
+      for (std::multimap<double, unsigned>::iterator j = ready.begin ();
+	   j != ready.end ();
+	   j ++)
+	{
+	  unsigned n = j->second;
+	  double bytes = estimates[n].second;
+	  if (n_in_flight == 0
+	      || !mem_budget
+	      || bytes_in_flight + bytes <= mem_budget)
+	    {
+	      ready.erase (j);
+	      n_in_flight ++;
+	      bytes_in_flight += bytes;
+	      return n;
+	    }
+	}
+      return 0;
+    };
+  
+  auto make_ready = [&] (unsigned n)
+    {
+      ready.insert (std::make_pair (sort ? -estimates[n].first : (double)n, n));
+    };
+  
+  // a knot being computed is done, or is handed back
+  auto land = [&] (unsigned n)
+    {
+      n_in_flight --;
+      bytes_in_flight -= estimates[n].second;
+    };
+  
+  for (;;)
+    {
+      // hand out work while the workers and the window have room, a
+      // knot to each worker in turn, so that with -sort the longest go
+      // to different workers
+      for (unsigned d = 1; d <= depth; d ++)
+	for (unsigned i = 0; i < n_workers; i ++)
+	  {
+	    worker &w = workers[i];
+	    while (w.outstanding.size () < d)
+	      {
+		unsigned n;
+		bool estimate = 0;
+		if (!retry.empty ())
+		  {
+		    n = retry.front ();
+		    retry.pop_front ();
+		    estimate = budgeted;
+		  }
+		else if (budgeted
+			 && (n = take_ready ()) != 0)
+		  ;
+		else
+		  {
+		    if (eof
+			|| (ordered && !sort && n_read + 1 - next_out >= window)
+			|| (budgeted && !sort && ready.size () >= window))
+		      break;
+  
+		    ssize_t len = getline (&line, &line_size, infp);
+		    if (len < 0)
+		      {
+			eof = 1;
+			break;
+		      }
+		    std::string spec (line, len);
+		    while (!spec.empty ()
+			   && isspace (spec[spec.size () - 1]))
+		      spec.erase (spec.size () - 1);
+		    size_t start = spec.find_first_not_of (" \t");
+		    if (start == std::string::npos
+			|| spec[start] == '#')
+		      continue;
+		    spec = spec.substr (start);
+  
+		    n = ++ n_read;
+		    specs[n] = spec;
+		    if (budgeted)
+		      {
+			estimate = 1;
+			n_unestimated ++;
+		      }
+		  }
+  
+		char buf[32];
+		sprintf (buf, "%u\t%c\t", n, estimate ? 'e' : 'c');
+		if (estimate)
+		  estimating.insert (n);
+		write_all (w.to, buf + specs[n] + "\n");
+		w.outstanding.push_back (n);
+	      }
+	  }
+  
+      bool busy = 0;
+      for (unsigned i = 0; i < n_workers; i ++)
+	{
+	  if (!workers[i].outstanding.empty ())
+	    busy = 1;
+	}
+      if (!busy)
+	break;
+  
+      std::vector<struct pollfd> fds (n_workers);
+      for (unsigned i = 0; i < n_workers; i ++)
+	{
+	  fds[i].fd = workers[i].from;
+	  fds[i].events = POLLIN;
+	  fds[i].revents = 0;
+	}
+      if (poll (&fds[0], n_workers, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  stderror ("poll");
+	  exit (EXIT_FAILURE);
+	}
+  
+      for (unsigned i = 0; i < n_workers; i ++)
+	{
+	  if (!fds[i].revents)
+	    continue;
+  
+	  worker &w = workers[i];
+	  char buf[4096];
+	  ssize_t r = read (w.from, buf, sizeof buf);
+	  if (r < 0 && errno == EINTR)
+	    continue;
+  
+	  std::vector<std::pair<unsigned, std::string> > results;
+	  if (r > 0)
+	    {
+	      w.buf.append (buf, r);
+	      size_t nl;
+	      while ((nl = w.buf.find ('\n')) != std::string::npos)
+		{
+		  std::string result = w.buf.substr (0, nl);
+		  w.buf.erase (0, nl + 1);
+  
+		  unsigned n = atoi (result.c_str ());
+		  assert (!w.outstanding.empty ()
+			  && w.outstanding.front () == n);
+		  w.outstanding.pop_front ();
+		  results.push_back (std::make_pair (n, result.substr (result.find ('\t') + 1)));
+		}
+	    }
+	  else
+	    {
+	      // the worker died: fail the knot it was on, resend the rest
+	      close (w.to);
+	      close (w.from);
+  
+	      int status = 0;
+	      waitpid (w.pid, &status, 0);
+  
+	      if (!w.outstanding.empty ())
+		{
+		  results.push_back (std::make_pair (w.outstanding.front (),
+						     "error=" + describe_status (status)));
+		  w.outstanding.pop_front ();
+		  while (!w.outstanding.empty ())
+		    {
+		      unsigned n = w.outstanding.front ();
+		      w.outstanding.pop_front ();
+		      if (budgeted && !estimating.count (n))
+			{
+			  land (n);
+			  make_ready (n);
+			}
+		      else
+			{
+			  estimating.erase (n);
+			  retry.push_back (n);
+			}
+		    }
+		}
+  
+	      w.to = w.from = -1;
+	      spawn_worker (w, infp, outfp);
+	    }
+  
+	  for (unsigned k = 0; k < results.size (); k ++)
+	    {
+	      unsigned n = results[k].first;
+	      if (estimating.count (n))
+		{
+		  estimating.erase (n);
+		  n_unestimated --;
+  
+		  double seconds, bytes;
+		  if (sscanf (results[k].second.c_str (), "?%lf %lf", &seconds, &bytes) == 2)
+		    {
+		      if ((time_budget > 0 && seconds > time_budget)
+			  || (mem_budget > 0 && bytes > mem_budget))
+			{
+			  char buf[128];
+			  if (std::isinf (seconds))
+			    sprintf (buf, "error=over budget: too many crossings to estimate");
+			  else
+			    sprintf (buf, "error=over budget: estimated %.3gs, %.3gMB",
+				     seconds, bytes / (1024 * 1024));
+			  results[k].second = buf;
+			  if (overfp)
+			    {
+			      fprintf (overfp, "%s\n", specs[n].c_str ());
+			      fflush (overfp);
+			    }
+			}
+		      else
+			{
+			  estimates[n] = std::make_pair (seconds, bytes);
+			  make_ready (n);
+			  continue;
+			}
+		    }
+		  // otherwise the estimate failed, and says why
+		}
+	      else if (budgeted)
+		{
+		  land (n);
+		  estimates.erase (n);
+		}
+  
+	      if (ordered)
+		done[n] = results[k].second;
+	      else
+		{
+		  fprintf (outfp, "%u\t%s\t%s\n", n, specs[n].c_str (), results[k].second.c_str ());
+		  specs.erase (n);
+		}
+	    }
+	}
+  
+      if (ordered)
+	{
+	  std::map<unsigned, std::string>::iterator j;
+	  while ((j = done.find (next_out)) != done.end ())
+	    {
+	      fprintf (outfp, "%u\t%s\t%s\n", next_out, specs[next_out].c_str (), j->second.c_str ());
+	      done.erase (j);
+	      specs.erase (next_out);
+	      next_out ++;
+	    }
+	}
+      fflush (outfp);
+    }
+  free (line);
+  
+  for (unsigned i = 0; i < n_workers; i ++)
+    {
+      close (workers[i].to);
+      close (workers[i].from);
+      waitpid (workers[i].pid, 0, 0);
+    }
+  
+  if (infp != stdin)
+    close_file (infp);
+  if (outfp != stdout)
+    close_file (outfp);
+  if (overfp)
+    close_file (overfp);
+  if (record_fp)
+    close_file (record_fp);
+}
@@ -0,0 +1,668 @@
+#include <knotkit.h>
+
+#include <deque>
+#include <thread>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* kk serve: a long-running kk answering requests, one per line, on
+   stdin or on the connections to a Unix domain socket.
+
+     <id> [-time <secs>] [-mem <MB>] <kk arguments...>
+     cancel <id>
+
+   where <id> is any word chosen by the client, and the kk arguments
+   are those of the command line, quoted with '' or "" where they hold
+   spaces, e.g.
+
+     7 khp -f Q 10_124
+     8 -time 60 kh "PD[X[1, 4, 2, 5], X[3, 6, 4, 1], X[5, 2, 6, 3]]"
+
+   The answers, in the order they complete, are
+
+     <id> ok <n>      followed by the n bytes kk wrote to stdout
+     <id> error <message>
+
+   The server maps the knot tables and diagram caches once, and keeps
+   the output of each request that succeeded, so a repeated request is
+   answered from memory.  Each request runs in a child forked from the
+   server, so it starts with the tables warm and cannot corrupt the
+   server; at most max_jobs run at once.  Cancelling a request, or
+   exceeding its time budget, kills its child.  The memory budget is a
+   limit on the child's address space beyond the server's. */
+
+extern int kk_main (int argc, char **argv);
+
+static const uint64 result_cache_bytes = (uint64)64 << 20;
+
+class connection
+{
+ public:
+  int in, out;
+  std::string buf;
+  bool eof;
+  unsigned n_requests;
+  
+ public:
+  connection (int in_, int out_) : in(in_), out(out_), eof(0), n_requests(0) { }
+};
+
+class request
+{
+ public:
+  unsigned conn;
+  std::string id;
+  std::vector<std::string> args;
+  std::string key;
+  double time_budget;
+  uint64 mem_budget;
+  
+  pid_t pid;
+  int out_fd, err_fd;
+  std::string out, err;
+  double deadline;
+  const char *killed;
+  
+ public:
+  request ()
+    : conn(0), time_budget(0), mem_budget(0),
+      pid(0), out_fd(-1), err_fd(-1), deadline(0), killed(0)
+  { }
+};
+
+static std::vector<connection> connections;
+static std::deque<request *> queued;
+static std::vector<request *> running;
+
+static std::map<std::string, std::string> results;
+static std::deque<std::string> results_order;
+static uint64 results_bytes = 0;
+
+static int listen_fd = -1;
+
+static double
+now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+write_all (int fd, const std::string &s)
+{
+  const char *p = s.data ();
+  size_t n = s.size ();
+  while (n > 0)
+    {
+      ssize_t r = write (fd, p, n);
+      if (r < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  // the client has gone away
+	  return;
+	}
+      p += r;
+      n -= r;
+    }
+}
+
+static void
+reply_ok (request *r, const std::string &output)
+{
+  char buf[100];
+  sprintf (buf, " ok %lu\n", (unsigned long)output.size ());
+  write_all (connections[r->conn].out, r->id + buf + output);
+}
+
+static void
+reply_error (request *r, std::string message)
+{
+  for (unsigned i = 0; i < message.size (); i ++)
+    {
+      if (message[i] == '\n')
+	message[i] = ' ';
+    }
+  write_all (connections[r->conn].out, r->id + " error " + message + "\n");
+}
+
+static void
+finish (request *r)
+{
+  connections[r->conn].n_requests --;
+  delete r;
+}
+
+/* Splits line into words at white space, except inside '' or "". */
+static bool
+split_words (const std::string &line, std::vector<std::string> &words)
+{
+  unsigned i = 0;
+  for (;;)
+    {
+      while (i < line.size () && isspace (line[i]))
+	i ++;
+      if (i == line.size ())
+	return 1;
+  
+      std::string w;
+      while (i < line.size () && !isspace (line[i]))
+	{
+	  if (line[i] == '\'' || line[i] == '"')
+	    {
+	      size_t e = line.find (line[i], i + 1);
+	      if (e == std::string::npos)
+		return 0;
+	      w += line.substr (i + 1, e - i - 1);
+	      i = e + 1;
+	    }
+	  else
+	    w += line[i ++];
+	}
+      words.push_back (w);
+    }
+}
+
+static void
+remember (const std::string &key, const std::string &output)
+{
+  if (output.size () > result_cache_bytes / 4
+      || results.find (key) != results.end ())
+    return;
+  
+  results[key] = output;
+  results_order.push_back (key);
+  results_bytes += key.size () + output.size ();
+  while (results_bytes > result_cache_bytes)
+    {
+      std::map<std::string, std::string>::iterator i = results.find (results_order.front ());
+      results_bytes -= i->first.size () + i->second.size ();
+      results.erase (i);
+      results_order.pop_front ();
+    }
+}
+
+static void
+set_budget (uint64 mem_budget)
+{
+  if (!mem_budget)
+    return;
+  
+  // address space already in use: the server's tables and heap
+  uint64 in_use = 0;
+  FILE *fp = fopen ("/proc/self/statm", "r");
+  if (fp)
+    {
+      unsigned long pages;
+      if (fscanf (fp, "%lu", &pages) == 1)
+	in_use = (uint64)pages * sysconf (_SC_PAGESIZE);
+      fclose (fp);
+    }
+  
+  struct rlimit rl;
+  getrlimit (RLIMIT_AS, &rl);
+  rl.rlim_cur = in_use + mem_budget;
+  if (rl.rlim_max != RLIM_INFINITY
+      && rl.rlim_cur > rl.rlim_max)
+    rl.rlim_cur = rl.rlim_max;
+  setrlimit (RLIMIT_AS, &rl);
+}
+
+static void
+start (request *r)
+{
+  int out[2], err[2];
+  if (pipe (out) != 0
+      || pipe (err) != 0)
+    {
+      stderror ("pipe");
+      exit (EXIT_FAILURE);
+    }
+  
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      stderror ("fork");
+      exit (EXIT_FAILURE);
+    }
+  if (pid == 0)
+    {
+      if (listen_fd >= 0)
+	close (listen_fd);
+      for (unsigned i = 0; i < connections.size (); i ++)
+	{
+	  if (connections[i].in >= 0 && connections[i].in != 0)
+	    close (connections[i].in);
+	  if (connections[i].out >= 0 && connections[i].out != 1)
+	    close (connections[i].out);
+	}
+      for (unsigned i = 0; i < running.size (); i ++)
+	{
+	  if (running[i]->out_fd >= 0)
+	    close (running[i]->out_fd);
+	  if (running[i]->err_fd >= 0)
+	    close (running[i]->err_fd);
+	}
+  
+      dup2 (out[1], 1);
+      dup2 (err[1], 2);
+      close (out[0]);
+      close (out[1]);
+      close (err[0]);
+      close (err[1]);
+  
+      set_budget (r->mem_budget);
+  
+      std::vector<char *> argv;
+      argv.push_back ((char *)"kk");
+      for (unsigned i = 0; i < r->args.size (); i ++)
+	argv.push_back ((char *)r->args[i].c_str ());
+      argv.push_back (0);
+  
+      int status = kk_main (argv.size () - 1, &argv[0]);
+      fflush (stdout);
+      fflush (stderr);
+      _exit (status);
+    }
+  
+  close (out[1]);
+  close (err[1]);
+  r->pid = pid;
+  r->out_fd = out[0];
+  r->err_fd = err[0];
+  r->deadline = r->time_budget > 0 ? now () + r->time_budget : 0;
+  running.push_back (r);
+}
+
+static void
+reap (unsigned k)
+{
+  request *r = running[k];
+  running.erase (running.begin () + k);
+  
+  int status = 0;
+  waitpid (r->pid, &status, 0);
+  
+  if (r->killed)
+    reply_error (r, r->killed);
+  else if (WIFEXITED (status) && WEXITSTATUS (status) == 0)
+    {
+      remember (r->key, r->out);
+      reply_ok (r, r->out);
+    }
+  else
+    {
+      // the last thing kk said, if anything
+      std::string message = r->err;
+      while (!message.empty () && isspace (message[message.size () - 1]))
+	message.erase (message.size () - 1);
+      size_t nl = message.rfind ('\n');
+      if (nl != std::string::npos)
+	message = message.substr (nl + 1);
+  
+      if (message.empty ())
+	{
+	  char buf[100];
+	  if (WIFSIGNALED (status))
+	    sprintf (buf, "killed by signal %d%s", WTERMSIG (status),
+		     r->mem_budget ? " (memory budget exceeded?)" : "");
+	  else
+	    sprintf (buf, "exited with status %d", WEXITSTATUS (status));
+	  message = buf;
+	}
+      reply_error (r, message);
+    }
+  finish (r);
+}
+
+static void
+cancel (unsigned conn, const std::string &id)
+{
+  for (std::deque<request *>::iterator i = queued.begin (); i != queued.end (); i ++)
+    {
+      request *r = *i;
+      if (r->conn == conn && r->id == id)
+	{
+	  queued.erase (i);
+	  reply_error (r, "cancelled");
+	  finish (r);
+	  return;
+	}
+    }
+  for (unsigned i = 0; i < running.size (); i ++)
+    {
+      request *r = running[i];
+      if (r->conn == conn && r->id == id && !r->killed)
+	{
+	  r->killed = "cancelled";
+	  kill (r->pid, SIGKILL);
+	  return;
+	}
+    }
+}
+
+static void
+handle_line (unsigned conn, const std::string &line,
+	     double default_time, uint64 default_mem)
+{
+  std::vector<std::string> words;
+  bool ok = split_words (line, words);
+  if (ok && words.empty ())
+    return;
+  
+  request *r = new request;
+  r->conn = conn;
+  r->id = ok ? words[0] : line.substr (0, line.find_first_of (" \t"));
+  r->time_budget = default_time;
+  r->mem_budget = default_mem;
+  connections[conn].n_requests ++;
+  
+  if (!ok)
+    {
+      reply_error (r, "unbalanced quotes");
+      finish (r);
+      return;
+    }
+  
+  if (words[0] == "cancel")
+    {
+      for (unsigned i = 1; i < words.size (); i ++)
+	cancel (conn, words[i]);
+      finish (r);
+      return;
+    }
+  
+  unsigned i = 1;
+  for (; i + 1 < words.size (); i += 2)
+    {
+      if (words[i] == "-time")
+	r->time_budget = atof (words[i + 1].c_str ());
+      else if (words[i] == "-mem")
+	r->mem_budget = (uint64)atof (words[i + 1].c_str ()) << 20;
+      else
+	break;
+    }
+  for (; i < words.size (); i ++)
+    {
+      if (words[i] == "-o" || words[i] == "-demo" || words[i] == "serve")
+	{
+	  reply_error (r, words[i] + " not supported by kk serve");
+	  finish (r);
+	  return;
+	}
+      r->args.push_back (words[i]);
+      r->key += words[i];
+      r->key += '\0';
+    }
+  if (r->args.empty ())
+    {
+      reply_error (r, "empty request");
+      finish (r);
+      return;
+    }
+  
+  std::map<std::string, std::string>::const_iterator j = results.find (r->key);
+  if (j != results.end ())
+    {
+      reply_ok (r, j->second);
+      finish (r);
+      return;
+    }
+  
+  queued.push_back (r);
+}
+
+static void
+serve_usage ()
+{
+  printf ("usage: kk serve [options...]\n"
+	  "  answers kk requests, one per line, from stdin or a socket;\n"
+	  "  see kk_serve.cpp or README for the protocol\n"
+	  "options:\n"
+	  "  -h          : print this message\n"
+	  "  -s <path>   : listen on the Unix domain socket <path>\n"
+	  "                 rather than stdin and stdout\n"
+	  "  -j <n>      : requests run at once\n"
+	  "                 (the number of cores is the default)\n"
+	  "  -time <secs>: time budget of a request (none is the default)\n"
+	  "  -mem <MB>   : memory budget of a request (none is the default)\n"
+	  "  -store <dir>: reuse the invariants recorded in the store <dir>\n"
+	  "                 and record new ones there\n");
+}
+
+int
+kk_serve (int argc, char **argv)
+{
+  const char *socket_path = 0;
+  unsigned max_jobs = 0;
+  double default_time = 0;
+  uint64 default_mem = 0;
+  
+  // argv[1] is "serve"
+  for (int i = 2; i < argc; i ++)
+    {
+      if (!strcmp (argv[i], "-h"))
+	{
+	  serve_usage ();
+	  exit (EXIT_SUCCESS);
+	}
+      else if (!strcmp (argv[i], "-s")
+	       || !strcmp (argv[i], "-j")
+	       || !strcmp (argv[i], "-time")
+	       || !strcmp (argv[i], "-mem")
+	       || !strcmp (argv[i], "-store"))
+	{
+	  const char *opt = argv[i];
+	  i ++;
+	  if (i == argc)
+	    {
+	      fprintf (stderr, "error: missing argument to option `%s'\n", opt);
+	      exit (EXIT_FAILURE);
+	    }
+	  if (!strcmp (opt, "-s"))
+	    socket_path = argv[i];
+	  else if (!strcmp (opt, "-j"))
+	    max_jobs = atoi (argv[i]);
+	  else if (!strcmp (opt, "-time"))
+	    default_time = atof (argv[i]);
+	  else if (!strcmp (opt, "-store"))
+	    store_dir = argv[i];
+	  else
+	    default_mem = (uint64)atof (argv[i]) << 20;
+	}
+      else
+	{
+	  fprintf (stderr, "error: unknown argument `%s'\n", argv[i]);
+	  fprintf (stderr, "  use kk serve -h for usage\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
+  if (max_jobs == 0)
+    max_jobs = std::max (1u, std::thread::hardware_concurrency ());
+  
+  // a client that went away is noticed by EOF, not by a signal
+  signal (SIGPIPE, SIG_IGN);
+  
+  open_knot_tables ();
+  
+  if (socket_path)
+    {
+      struct sockaddr_un addr;
+      memset (&addr, 0, sizeof addr);
+      addr.sun_family = AF_UNIX;
+      if (strlen (socket_path) >= sizeof addr.sun_path)
+	{
+	  fprintf (stderr, "error: socket path too long: %s\n", socket_path);
+	  exit (EXIT_FAILURE);
+	}
+      strcpy (addr.sun_path, socket_path);
+      unlink (socket_path);
+  
+      listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+      if (listen_fd < 0
+	  || bind (listen_fd, (struct sockaddr *)&addr, sizeof addr) != 0
+	  || listen (listen_fd, 16) != 0)
+	{
+	  stderror ("%s", socket_path);
+	  exit (EXIT_FAILURE);
+	}
+    }
+  else
+    connections.push_back (connection (0, 1));
+  
+  for (;;)
+    {
+      while (running.size () < max_jobs && !queued.empty ())
+	{
+	  request *r = queued.front ();
+	  queued.pop_front ();
+	  
+	  // an identical request may have finished while this one waited
+	  std::map<std::string, std::string>::const_iterator j = results.find (r->key);
+	  if (j != results.end ())
+	    {
+	      reply_ok (r, j->second);
+	      finish (r);
+	    }
+	  else
+	    start (r);
+	}
+  
+      // close connections that are done; on stdin, stop
+      for (unsigned i = 0; i < connections.size (); i ++)
+	{
+	  connection &c = connections[i];
+	  if (c.in >= 0 && c.eof && c.n_requests == 0)
+	    {
+	      if (!socket_path)
+		return 0;
+	      close (c.in);
+	      c.in = c.out = -1;
+	    }
+	}
+  
+      std::vector<struct pollfd> fds;
+      std::vector<std::pair<int, unsigned> > what;
+      struct pollfd p;
+      p.events = POLLIN;
+      p.revents = 0;
+      if (listen_fd >= 0)
+	{
+	  p.fd = listen_fd;
+	  fds.push_back (p);
+	  what.push_back (std::make_pair (0, 0));
+	}
+      for (unsigned i = 0; i < connections.size (); i ++)
+	{
+	  if (connections[i].in >= 0 && !connections[i].eof)
+	    {
+	      p.fd = connections[i].in;
+	      fds.push_back (p);
+	      what.push_back (std::make_pair (1, i));
+	    }
+	}
+      double t = now (),
+	next_deadline = 0;
+      for (unsigned i = 0; i < running.size (); i ++)
+	{
+	  request *r = running[i];
+	  if (r->deadline && !r->killed)
+	    {
+	      if (r->deadline <= t)
+		{
+		  r->killed = "time budget exceeded";
+		  kill (r->pid, SIGKILL);
+		}
+	      else if (!next_deadline || r->deadline < next_deadline)
+		next_deadline = r->deadline;
+	    }
+	  if (r->out_fd >= 0)
+	    {
+	      p.fd = r->out_fd;
+	      fds.push_back (p);
+	      what.push_back (std::make_pair (2, i));
+	    }
+	  if (r->err_fd >= 0)
+	    {
+	      p.fd = r->err_fd;
+	      fds.push_back (p);
+	      what.push_back (std::make_pair (3, i));
+	    }
+	}
+  
+      int timeout = next_deadline ? (int)((next_deadline - t) * 1000) + 1 : -1;
+      if (poll (&fds[0], fds.size (), timeout) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  stderror ("poll");
+	  exit (EXIT_FAILURE);
+	}
+  
+      std::vector<unsigned> done;
+      for (unsigned k = 0; k < fds.size (); k ++)
+	{
+	  if (!fds[k].revents)
+	    continue;
+  
+	  unsigned i = what[k].second;
+	  if (what[k].first == 0)
+	    {
+	      int fd = accept (listen_fd, 0, 0);
+	      if (fd >= 0)
+		connections.push_back (connection (fd, fd));
+	      continue;
+	    }
+  
+	  char buf[4096];
+	  ssize_t n = read (fds[k].fd, buf, sizeof buf);
+	  if (n < 0 && errno == EINTR)
+	    continue;
+  
+	  if (what[k].first == 1)
+	    {
+	      connection &c = connections[i];
+	      if (n <= 0)
+		{
+		  c.eof = 1;
+		  continue;
+		}
+	      c.buf.append (buf, n);
+	      size_t nl;
+	      while ((nl = connections[i].buf.find ('\n')) != std::string::npos)
+		{
+		  std::string line = connections[i].buf.substr (0, nl);
+		  connections[i].buf.erase (0, nl + 1);
+		  handle_line (i, line, default_time, default_mem);
+		}
+	    }
+	  else
+	    {
+	      request *r = running[i];
+	      int &fd = what[k].first == 2 ? r->out_fd : r->err_fd;
+	      if (n <= 0)
+		{
+		  close (fd);
+		  fd = -1;
+		  if (r->out_fd < 0 && r->err_fd < 0)
+		    done.push_back (i);
+		}
+	      else
+		(what[k].first == 2 ? r->out : r->err).append (buf, n);
+	    }
+	}
+  
+      // highest first, so the indices stay valid
+      std::sort (done.begin (), done.end ());
+      for (unsigned k = done.size (); k -- > 0;)
+	reap (done[k]);
+    }
+}
@@ -542,6 +542,205 @@ knot_diagram::knot_diagram (mirror, const knot_diagram &kd)
   assert (nplus == kd.nminus);
 }
 
+/* One traversal for the canonical form: the crossings of the piece
+   of kd containing the ept start are labelled in the order a
+   breadth-first search from start reaches them, each entered at the
+   ept it was reached by (start for the first).  The code lists, for
+   each crossing in label order and each of its epts counterclockwise
+   from the entry, the label of the crossing at the other end of the
+   edge, the position there of the other ept from that crossing's
+   entry, whether the edge is marked, whether the ept is under and
+   whether it is the edge's to ept (from ept if reversed).  The code determines the piece up to
+   relabelling.  Returns 0, with the traversal unfinished, as soon as
+   the code is known to be greater than *best. */
+static bool
+canonical_traversal (const knot_diagram &kd, unsigned start, bool reversed,
+		     const std::vector<unsigned> *best,
+		     std::vector<unsigned> &code,
+		     std::vector<unsigned> &entry)
+{
+  std::vector<unsigned> label (kd.n_crossings + 1, 0);
+  code.clear ();
+  entry.clear ();
+  
+  label[kd.ept_crossing[start]] = 1;
+  entry.push_back (start);
+  
+  bool less = 0;
+  for (unsigned k = 0; k < entry.size (); k ++)
+    {
+      unsigned c = kd.ept_crossing[entry[k]],
+	i0 = kd.ept_index[entry[k]];
+      for (unsigned r = 0; r < 4; r ++)
+	{
+	  unsigned p = kd.crossings[c][add_base1_mod4 (i0, r)],
+	    q = kd.edge_other_ept (p),
+	    c2 = kd.ept_crossing[q];
+	  if (!label[c2])
+	    {
+	      entry.push_back (q);
+	      label[c2] = entry.size ();
+	    }
+	  
+	  unsigned pos = (kd.ept_index[q] + 4 - kd.ept_index[entry[label[c2] - 1]]) % 4;
+	  unsigned x = (label[c2] << 5)
+	    | (pos << 3)
+	    | ((unsigned)(kd.ept_edge (p) == kd.marked_edge) << 2)
+	    | ((unsigned)kd.is_under_ept (p) << 1)
+	    | ((unsigned)kd.is_to_ept (p) ^ (unsigned)reversed);
+	  
+	  if (best && !less)
+	    {
+	      unsigned y = (*best)[code.size ()];
+	      if (x > y)
+		return 0;
+	      if (x < y)
+		less = 1;
+	    }
+	  code.push_back (x);
+	}
+    }
+  return 1;
+}
+
+/* The best traversal of each piece of kd, in order of their codes. */
+class canonical_piece
+{
+ public:
+  std::vector<unsigned> code;
+  std::vector<unsigned> entry;
+  
+  bool operator < (const canonical_piece &p) const
+  {
+    return code.size () < p.code.size ()
+      || (code.size () == p.code.size () && code < p.code);
+  }
+};
+
+static std::vector<canonical_piece>
+canonical_pieces (const knot_diagram &kd, bool reversed)
+{
+  unionfind<1> u (kd.n_crossings);
+  for (unsigned c = 1; c <= kd.n_crossings; c ++)
+    for (unsigned j = 1; j <= 4; j ++)
+      u.join (c, kd.ept_crossing[kd.edge_other_ept (kd.crossings[c][j])]);
+  
+  std::map<unsigned, canonical_piece> piece;
+  std::vector<unsigned> code, entry;
+  for (unsigned p = 1; p <= kd.num_epts (); p ++)
+    {
+      canonical_piece &best = piece[u.find (kd.ept_crossing[p])];
+      if (canonical_traversal (kd, p, reversed,
+			       best.code.empty () ? 0 : &best.code,
+			       code, entry))
+	{
+	  best.code.swap (code);
+	  best.entry.swap (entry);
+	}
+    }
+  
+  std::vector<canonical_piece> pieces;
+  for (std::map<unsigned, canonical_piece>::const_iterator i = piece.begin (); i != piece.end (); i ++)
+    pieces.push_back (i->second);
+  std::sort (pieces.begin (), pieces.end ());
+  return pieces;
+}
+
+knot_diagram::knot_diagram (canonical, const knot_diagram &kd, bool reverse)
+  : name(kd.name),
+    n_crossings(kd.n_crossings),
+    marked_edge(0),
+    crossings(n_crossings),
+    ept_crossing(num_epts ()),
+    ept_index(num_epts ()),
+    nminus(0), nplus(0)
+{
+  bool reversed = 0;
+  std::vector<canonical_piece> pieces = canonical_pieces (kd, 0);
+  if (reverse)
+    {
+      std::vector<canonical_piece> rpieces = canonical_pieces (kd, 1);
+      if (rpieces < pieces)
+	{
+	  pieces.swap (rpieces);
+	  reversed = 1;
+	}
+    }
+  
+  /* Crossings are numbered by piece and label, edges in the order the
+     traversals meet them.  Each crossing starts from its first under
+     ept counterclockwise from the entry. */
+  basedvector<unsigned, 1> new_ept (num_epts ());
+  for (unsigned i = 1; i <= num_epts (); i ++)
+    new_ept[i] = 0;
+  unsigned n_edges = 0,
+    c = 0;
+  for (unsigned i = 0; i < pieces.size (); i ++)
+    for (unsigned k = 0; k < pieces[i].entry.size (); k ++)
+      {
+	unsigned p0 = pieces[i].entry[k],
+	  c0 = kd.ept_crossing[p0],
+	  i0 = kd.ept_index[p0];
+	if (!kd.is_under_ept (p0))
+	  i0 = add_base1_mod4 (i0, 1);
+	
+	c ++;
+	basedvector<unsigned, 1> v (4);
+	for (unsigned r = 0; r < 4; r ++)
+	  {
+	    unsigned p = kd.crossings[c0][add_base1_mod4 (i0, r)];
+	    if (!new_ept[p])
+	      {
+		n_edges ++;
+		unsigned e = kd.ept_edge (p);
+		new_ept[kd.edge_from_ept (e)] = reversed ? edge_to_ept (n_edges) : edge_from_ept (n_edges);
+		new_ept[kd.edge_to_ept (e)] = reversed ? edge_from_ept (n_edges) : edge_to_ept (n_edges);
+		if (kd.marked_edge == e)
+		  marked_edge = n_edges;
+	      }
+	    v[r + 1] = new_ept[p];
+	  }
+	crossings[c] = v;
+      }
+  assert (c == n_crossings && n_edges == num_edges ());
+  
+  /* The reduced cube takes the marked circle to be the one through
+     edge 1, so the marked edge swaps labels with edge 1. */
+  if (marked_edge > 1)
+    {
+      for (unsigned i = 1; i <= n_crossings; i ++)
+	for (unsigned j = 1; j <= 4; j ++)
+	  {
+	    unsigned p = crossings[i][j],
+	      e = ept_edge (p);
+	    if (e == 1 || e == marked_edge)
+	      {
+		unsigned e2 = e == 1 ? marked_edge : 1;
+		crossings[i][j] = is_from_ept (p) ? edge_from_ept (e2) : edge_to_ept (e2);
+	      }
+	  }
+      marked_edge = 1;
+    }
+  
+  for (unsigned i = 1; i <= n_crossings; i ++)
+    {
+      for (unsigned j = 1; j <= 4; j ++)
+	{
+	  unsigned p = crossings[i][j];
+	  ept_crossing[p] = i;
+	  ept_index[p] = j;
+	}
+    }
+  
+#ifndef NDEBUG
+  check_crossings ();
+#endif
+  
+  calculate_smoothing_orientation ();
+  calculate_nminus_nplus ();
+  assert (nminus == kd.nminus && nplus == kd.nplus);
+}
+
 void
 knot_diagram::check_crossings ()
 {
@@ -969,6 +1168,110 @@ knot_diagram::black_graph (basedvector<unsigned, 1> &bg_edge_height) const
   return bg;
 }
 
+bool
+knot_diagram::is_alternating () const
+{
+  for (unsigned e = 1; e <= num_edges (); e ++)
+    {
+      if (is_under_ept (edge_from_ept (e)) == is_under_ept (edge_to_ept (e)))
+	return 0;
+    }
+  return 1;
+}
+
+int
+knot_diagram::signature () const
+{
+  if (n_crossings == 0)
+    return 0;
+  
+  /* The Goeritz matrix of the surface F spanned by the regions not in
+     the black graph: its vertices are the regions F misses, with the
+     last one dropped.  Edge c of the black graph is crossing c, of
+     height 1 if those regions are at corners 1 and 3.  eta (c) = 1 if
+     the 0-resolution (see resolve_next_ept) joins the regions of F at
+     c, else -1. */
+  basedvector<unsigned, 1> height;
+  directed_multigraph bg = black_graph (height);
+  assert (bg.num_edges () == n_crossings);
+  
+  unsigned m = bg.n_vertices - 1;
+  std::vector<std::vector<mpq_class> > G (m, std::vector<mpq_class> (m));
+  int mu = 0;
+  for (unsigned c = 1; c <= n_crossings; c ++)
+    {
+      int eta = height[c] ? 1 : -1;
+      
+      // the oriented resolution (0 at positive crossings) joins the
+      // regions of F
+      bool positive = is_to_ept (crossings[c][1]) == is_to_ept (crossings[c][4]);
+      if (height[c] == (positive ? 1u : 0u))
+	mu += eta;
+      
+      unsigned u = bg.edge_from[c] - 1,
+	v = bg.edge_to[c] - 1;
+      if (u == v)
+	continue;
+      if (u < m)
+	G[u][u] += eta;
+      if (v < m)
+	G[v][v] += eta;
+      if (u < m && v < m)
+	{
+	  G[u][v] -= eta;
+	  G[v][u] -= eta;
+	}
+    }
+  
+  // diagonalize by congruence
+  int sign = 0;
+  for (unsigned k = 0; k < m; k ++)
+    {
+      if (sgn (G[k][k]) == 0)
+	{
+	  unsigned j = k + 1;
+	  while (j < m && sgn (G[j][j]) == 0)
+	    j ++;
+	  if (j < m)
+	    {
+	      G[j].swap (G[k]);
+	      for (unsigned i = 0; i < m; i ++)
+		std::swap (G[i][j], G[i][k]);
+	    }
+	  else
+	    {
+	      j = k + 1;
+	      while (j < m && sgn (G[k][j]) == 0)
+		j ++;
+	      if (j == m)
+		continue;
+  
+	      // row and column k += row and column j
+	      for (unsigned i = 0; i < m; i ++)
+		G[k][i] += G[j][i];
+	      for (unsigned i = 0; i < m; i ++)
+		G[i][k] += G[i][j];
+	    }
+	}
+  
+      mpq_class d = G[k][k];
+      sign += sgn (d) > 0 ? 1 : -1;
+      for (unsigned i = k + 1; i < m; i ++)
+	{
+	  if (sgn (G[i][k]) == 0)
+	    continue;
+  
+	  mpq_class f = G[i][k] / d;
+	  for (unsigned j = k; j < m; j ++)
+	    G[i][j] -= f * G[k][j];
+	}
+      for (unsigned i = k + 1; i < m; i ++)
+	G[k][i] = 0;
+    }
+  
+  return sign - mu;
+}
+
 basedvector<basedvector<int, 1>, 1> 
 knot_diagram::planar_diagram_crossings () const
 {
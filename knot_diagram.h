@@ -26,6 +26,7 @@ enum mirror { MIRROR };
 enum connect_sum { CONNECT_SUM };
 enum sublink { SUBLINK };
 enum disjoint_union { DISJOINT_UNION };
+enum canonical { CANONICAL };
 
 class knot_diagram
 {
@@ -141,6 +142,15 @@ class knot_diagram
 		const knot_diagram &kd1,
 		const knot_diagram &kd2);
   
+  /* kd renumbered canonically: two diagrams give the same crossings
+     exactly when they differ only in the numbering of crossings and
+     edges (and with reverse, the orientation of all components
+     together), e.g. the same diagram from PD, DT or a braid.  The
+     least code of a traversal of the planar structure from each ept;
+     marked_edge is carried along and becomes edge 1.  For mirrors,
+     canonicalize knot_diagram (MIRROR, kd). */
+  knot_diagram (canonical, const knot_diagram &kd, bool reverse = 0);
+  
   knot_diagram (const std::string &name_, unsigned n_crossings_, unsigned crossings_ar[][4]);
   knot_diagram (const std::string &name_, const basedvector<basedvector<unsigned, 1>, 1> &crossings_);
   knot_diagram (const knot_diagram &kd)
@@ -175,6 +185,15 @@ class knot_diagram
   
   int writhe () const { return (int)nplus - (int)nminus; }
   
+  // over and under alternate along every edge
+  bool is_alternating () const;
+  
+  /* Gordon-Litherland: the signature of the Goeritz matrix of the
+     checkerboard surface dual to black_graph, less a correction from
+     the crossings where the oriented resolution joins regions of the
+     surface.  Positive knots have negative signature. */
+  int signature () const;
+  
   unsigned total_linking_number () const;
   
   basedvector<basedvector<int, 1>, 1> planar_diagram_crossings () const;
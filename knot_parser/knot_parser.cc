@@ -449,10 +449,11 @@ namespace yy {
     { 
 	unsigned n = (yysemantic_stack_[(3) - (1)].integer),
 	  k = (yysemantic_stack_[(3) - (3)].integer);
+	knot_desc desc (knot_desc::ROLFSEN, n, k);
 	
 	if (n >= 1 && n <= 10
-	    && k >= 1 && k <= rolfsen_crossing_knots (n))
-	  (yyval.kd) = new knot_diagram (rolfsen_knot (n, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  (yyval.kd) = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such Rolfsen knot `%d_%d'\n",
@@ -464,15 +465,16 @@ namespace yy {
 
   case 14:
 /* Line 670 of lalr1.cc  */
-#line 107 "knot_parser/knot_parser.yy"
+#line 108 "knot_parser/knot_parser.yy"
     {
 	unsigned n = (yysemantic_stack_[(3) - (1)].integer),
 	  k = (yysemantic_stack_[(3) - (3)].integer);
 	bool alt = (yysemantic_stack_[(3) - (2)].alternating);
+	knot_desc desc (alt ? knot_desc::HTW_ALT : knot_desc::HTW_NONALT, n, k);
 	
 	if (n >= 1 && n <= 16
-	    && k >= 1 && k <= htw_knots (n, alt))
-	  (yyval.kd) = new knot_diagram (htw_knot (n, alt, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  (yyval.kd) = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such HTW knot `%d%c%d'\n",
@@ -484,15 +486,16 @@ namespace yy {
 
   case 15:
 /* Line 670 of lalr1.cc  */
-#line 126 "knot_parser/knot_parser.yy"
+#line 128 "knot_parser/knot_parser.yy"
     {
 	unsigned n = (yysemantic_stack_[(4) - (2)].integer),
 	  k = (yysemantic_stack_[(4) - (4)].integer);
 	bool alt = (yysemantic_stack_[(4) - (3)].alternating);
+	knot_desc desc (alt ? knot_desc::MT_ALT : knot_desc::MT_NONALT, n, k);
 	
 	if (n >= 1 && n <= 14
-	    && k >= 1 && k <= mt_links (n, alt))
-	  (yyval.kd) = new knot_diagram (mt_link (n, alt, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  (yyval.kd) = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such MT link `%d%c%d'\n", 
@@ -504,19 +507,19 @@ namespace yy {
 
   case 16:
 /* Line 670 of lalr1.cc  */
-#line 145 "knot_parser/knot_parser.yy"
+#line 148 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (planar_diagram ("<parsed>", *(yysemantic_stack_[(4) - (3)].int_vec2))); }
     break;
 
   case 17:
 /* Line 670 of lalr1.cc  */
-#line 147 "knot_parser/knot_parser.yy"
+#line 150 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (planar_diagram ("<parsed>", *(yysemantic_stack_[(4) - (3)].int_vec2))); }
     break;
 
   case 18:
 /* Line 670 of lalr1.cc  */
-#line 152 "knot_parser/knot_parser.yy"
+#line 155 "knot_parser/knot_parser.yy"
     {
 	basedvector<basedvector<int, 1>, 1> even_labels (1);
 	even_labels[1] = *(yysemantic_stack_[(4) - (3)].int_vec);
@@ -526,31 +529,31 @@ namespace yy {
 
   case 19:
 /* Line 670 of lalr1.cc  */
-#line 158 "knot_parser/knot_parser.yy"
+#line 161 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (dt_code ("<parsed>", *(yysemantic_stack_[(4) - (3)].int_vec2))); }
     break;
 
   case 20:
 /* Line 670 of lalr1.cc  */
-#line 160 "knot_parser/knot_parser.yy"
+#line 163 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (dt_code ("<parsed>", (yysemantic_stack_[(4) - (3)].string))); }
     break;
 
   case 21:
 /* Line 670 of lalr1.cc  */
-#line 165 "knot_parser/knot_parser.yy"
+#line 168 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (torus_knot ((yysemantic_stack_[(6) - (3)].integer), (yysemantic_stack_[(6) - (5)].integer))); }
     break;
 
   case 22:
 /* Line 670 of lalr1.cc  */
-#line 170 "knot_parser/knot_parser.yy"
+#line 173 "knot_parser/knot_parser.yy"
     { (yyval.kd) = new knot_diagram (braid ((yysemantic_stack_[(6) - (3)].integer), *(yysemantic_stack_[(6) - (5)].int_vec))); }
     break;
 
   case 23:
 /* Line 670 of lalr1.cc  */
-#line 175 "knot_parser/knot_parser.yy"
+#line 178 "knot_parser/knot_parser.yy"
     {
 	unsigned unknot_ar[1][4] = {
 	  { 2, 1, 3, 4, },
@@ -561,7 +564,7 @@ namespace yy {
 
   case 26:
 /* Line 670 of lalr1.cc  */
-#line 190 "knot_parser/knot_parser.yy"
+#line 193 "knot_parser/knot_parser.yy"
     {
 	basedvector<basedvector<int, 1>, 1> *v
 	  = new basedvector<basedvector<int, 1>, 1> ();
@@ -572,7 +575,7 @@ namespace yy {
 
   case 27:
 /* Line 670 of lalr1.cc  */
-#line 197 "knot_parser/knot_parser.yy"
+#line 200 "knot_parser/knot_parser.yy"
     { 
 	basedvector<basedvector<int, 1>, 1> *v = (yysemantic_stack_[(3) - (1)].int_vec2);
 	v->append (*(yysemantic_stack_[(3) - (3)].int_vec));
@@ -582,19 +585,19 @@ namespace yy {
 
   case 28:
 /* Line 670 of lalr1.cc  */
-#line 206 "knot_parser/knot_parser.yy"
+#line 209 "knot_parser/knot_parser.yy"
     { (yyval.int_vec) = (yysemantic_stack_[(3) - (2)].int_vec); }
     break;
 
   case 29:
 /* Line 670 of lalr1.cc  */
-#line 208 "knot_parser/knot_parser.yy"
+#line 211 "knot_parser/knot_parser.yy"
     { (yyval.int_vec) = (yysemantic_stack_[(3) - (2)].int_vec); }
     break;
 
   case 30:
 /* Line 670 of lalr1.cc  */
-#line 213 "knot_parser/knot_parser.yy"
+#line 216 "knot_parser/knot_parser.yy"
     {
 	basedvector<int, 1> *v =
 	  new basedvector<int, 1> ();
@@ -605,7 +608,7 @@ namespace yy {
 
   case 31:
 /* Line 670 of lalr1.cc  */
-#line 220 "knot_parser/knot_parser.yy"
+#line 223 "knot_parser/knot_parser.yy"
     {
 	basedvector<int, 1> *v = (yysemantic_stack_[(3) - (1)].int_vec);
 	v->append ((yysemantic_stack_[(3) - (3)].integer));
@@ -615,7 +618,7 @@ namespace yy {
 
   case 32:
 /* Line 670 of lalr1.cc  */
-#line 229 "knot_parser/knot_parser.yy"
+#line 232 "knot_parser/knot_parser.yy"
     {
 	basedvector<basedvector<int, 1>, 1> *v
 	  = new basedvector<basedvector<int, 1>, 1> ();
@@ -626,7 +629,7 @@ namespace yy {
 
   case 33:
 /* Line 670 of lalr1.cc  */
-#line 236 "knot_parser/knot_parser.yy"
+#line 239 "knot_parser/knot_parser.yy"
     { 
 	basedvector<basedvector<int, 1>, 1> *v = (yysemantic_stack_[(3) - (1)].int_vec2);
 	v->append (*(yysemantic_stack_[(3) - (3)].int_vec));
@@ -636,7 +639,7 @@ namespace yy {
 
   case 34:
 /* Line 670 of lalr1.cc  */
-#line 245 "knot_parser/knot_parser.yy"
+#line 248 "knot_parser/knot_parser.yy"
     {
 	basedvector<int, 1> *v
 	  = new basedvector<int, 1> ();
@@ -650,7 +653,7 @@ namespace yy {
 
 
 /* Line 670 of lalr1.cc  */
-#line 654 "knot_parser/knot_parser.cc"
+#line 657 "knot_parser/knot_parser.cc"
       default:
         break;
       }
@@ -1129,9 +1132,9 @@ namespace yy {
 
 } // yy
 /* Line 1141 of lalr1.cc  */
-#line 1133 "knot_parser/knot_parser.cc"
+#line 1136 "knot_parser/knot_parser.cc"
 /* Line 1142 of lalr1.cc  */
-#line 255 "knot_parser/knot_parser.yy"
+#line 258 "knot_parser/knot_parser.yy"
 
 
 void
@@ -89,10 +89,11 @@ rolfsen_knot:
       { 
 	unsigned n = $1,
 	  k = $3;
+	knot_desc desc (knot_desc::ROLFSEN, n, k);
 	
 	if (n >= 1 && n <= 10
-	    && k >= 1 && k <= rolfsen_crossing_knots (n))
-	  $$ = new knot_diagram (rolfsen_knot (n, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  $$ = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such Rolfsen knot `%d_%d'\n",
@@ -108,10 +109,11 @@ htw_knot:
 	unsigned n = $1,
 	  k = $3;
 	bool alt = $2;
+	knot_desc desc (alt ? knot_desc::HTW_ALT : knot_desc::HTW_NONALT, n, k);
 	
 	if (n >= 1 && n <= 16
-	    && k >= 1 && k <= htw_knots (n, alt))
-	  $$ = new knot_diagram (htw_knot (n, alt, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  $$ = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such HTW knot `%d%c%d'\n",
@@ -127,10 +129,11 @@ mt_link:
 	unsigned n = $2,
 	  k = $4;
 	bool alt = $3;
+	knot_desc desc (alt ? knot_desc::MT_ALT : knot_desc::MT_NONALT, n, k);
 	
 	if (n >= 1 && n <= 14
-	    && k >= 1 && k <= mt_links (n, alt))
-	  $$ = new knot_diagram (mt_link (n, alt, k));
+	    && k >= 1 && k <= desc.table_crossing_knots ())
+	  $$ = new knot_diagram (desc.diagram ());
 	else
 	  {
 	    fprintf (stderr, "knot_parser: no such MT link `%d%c%d'\n", 
@@ -1,6 +1,9 @@
 
 #include <knotkit.h>
 
+#include <mutex>
+#include <unistd.h>
+
 bool verbose = 0;
 
 static const struct {
@@ -385,57 +388,62 @@ htw_knots (unsigned n)
   return htw_alternating[n - 1] + htw_nonalternating[n - 1];
 }
 
-dt_code
-htw_knot (unsigned n, bool alternating, unsigned k)
+std::string
+knot_table_file (const std::string &name)
 {
-  assert (between (1, n, 16));
-  assert (between (1, k, htw_knots (n, alternating)));
+  const char *dir = getenv ("KNOTKIT_TABLES");
+  if (dir == 0 || *dir == 0)
+    dir = HOME;
+  return std::string (dir) + "/" + name;
+}
 
-  const char *file;
-  long off;
-  if (alternating)
-    {
-      unsigned before = 0;
-      for (unsigned i = 0; i < n - 1; i ++)
-	before += htw_alternating[i];
-      off = 8 * (before + k - 1);
-      
-      file = HOME "/alternating";
-    }
-  else
-    {
-      unsigned before = 0;
-      for (unsigned i = 0; i < n - 1; i ++)
-	before += htw_nonalternating[i];
-      off = 10 * (before + k - 1);
-      
-      file = HOME "/nonalternating";
-    }
-  FILE *fp = fopen (file, "r");
-  if (fp == 0)
-    {
-      stderror ("fopen: %s", file);
-      exit (EXIT_FAILURE);
-    }
+static std::mutex tables_mutex;
+
+/* An HTW table, mapped once.  Knots are fixed size records, packed
+   4 bits per even label, plus 16 bits of crossing signs for the
+   nonalternating ones, ordered by crossing number; first[n - 1] is
+   the index of the first knot with n crossings. */
+class htw_table
+{
+ public:
+  ptr<mapped_file> f;
+  unsigned record_size;
+  unsigned first[16];
+};
+
+static htw_table *htw_tables[2];
+
+static const htw_table &
+htw_knot_table (bool alternating)
+{
+  std::lock_guard<std::mutex> lock (tables_mutex);
+  
+  htw_table *&t = htw_tables[alternating];
+  if (t)
+    return *t;
   
-  if (fseek (fp, off, SEEK_SET) != 0)
+  const unsigned *counts = alternating ? htw_alternating : htw_nonalternating;
+  
+  t = new htw_table;
+  t->record_size = alternating ? 8 : 10;
+  unsigned total = 0;
+  for (unsigned i = 0; i < 16; i ++)
     {
-      stderror ("fseek");
-      exit (EXIT_FAILURE);
+      t->first[i] = total;
+      total += counts[i];
     }
   
-  unsigned char buf[10];
+  t->f = new mapped_file (knot_table_file (alternating ? "alternating" : "nonalternating"));
+  t->f->at<uint8> (0, (uint64)total * t->record_size);
+  return *t;
+}
+
+static dt_code
+htw_decode (unsigned n, bool alternating, unsigned k, const uint8 *buf)
+{
   size_t count = (n + 1) / 2;
   if (!alternating)
     count += 2;
-  if (fread (buf, 1, count, fp) != count)
-    {
-      stderror ("fread");
-      exit (EXIT_FAILURE);
-    }
-  
-  fclose (fp);
-  fp = 0;
   
   int even_labels_ar[16];
   for (unsigned i = 0; i < n; i ++)
@@ -466,6 +474,48 @@ htw_knot (unsigned n, bool alternating, unsigned k)
   return dt_code (std::string (buf2), n, even_labels_ar);
 }
 
+dt_code
+htw_knot (unsigned n, bool alternating, unsigned k)
+{
+  assert (between (1, n, 16));
+  assert (between (1, k, htw_knots (n, alternating)));
+  
+  const htw_table &t = htw_knot_table (alternating);
+  return htw_decode (n, alternating, k,
+		     t.f->data + (uint64)(t.first[n - 1] + k - 1) * t.record_size);
+}
+
+void
+htw_knots (unsigned n, bool alternating, unsigned first, unsigned last,
+	   std::vector<dt_code> &out)
+{
+  assert (between (1, n, 16));
+  assert (first >= 1 && last <= htw_knots (n, alternating));
+  
+  const htw_table &t = htw_knot_table (alternating);
+  const uint8 *p = t.f->data + (uint64)(t.first[n - 1] + first - 1) * t.record_size;
+  
+  out.clear ();
+  if (first > last)
+    return;
+  out.reserve (last - first + 1);
+  for (unsigned k = first; k <= last; k ++, p += t.record_size)
+    out.push_back (htw_decode (n, alternating, k, p));
+}
+
+void
+htw_knots (unsigned n, bool alternating, unsigned first, unsigned last,
+	   std::vector<knot_diagram> &out)
+{
+  std::vector<dt_code> dts;
+  htw_knots (n, alternating, first, last, dts);
+  
+  out.clear ();
+  out.reserve (dts.size ());
+  for (unsigned i = 0; i < dts.size (); i ++)
+    out.push_back (knot_diagram (dts[i]));
+}
+
 dt_code
 htw_knot (unsigned n, unsigned k)
 {
@@ -504,46 +554,71 @@ mt_links (unsigned n)
   return mt_alternating[n - 1] + mt_nonalternating[n - 1];
 }
 
-dt_code
-mt_link (unsigned n, bool alternating, unsigned k)
+/* An MT table, mapped once, and the offset of each line: line k
+   (from 1) is [line_start[k - 1], line_start[k]). */
+class mt_table
 {
-  assert (between (1, n, 14));
-  assert (between (1, k, mt_links (n, alternating)));
+ public:
+  ptr<mapped_file> f;
+  std::vector<uint64> line_start;
+};
+
+static mt_table *mt_tables[14][2];
+
+static const mt_table &
+mt_link_table (unsigned n, bool alternating)
+{
+  std::lock_guard<std::mutex> lock (tables_mutex);
   
-  char buf[1000];
+  mt_table *&t = mt_tables[n - 1][alternating];
+  if (t)
+    return *t;
   
-  sprintf (buf, HOME "/mtlinks/hyperbolic_data_%02d%c", n, alternating ? 'a' : 'n');
-  FILE *fp = fopen (buf, "r");
-  if (fp == 0)
-    {
-      stderror ("fopen: %s", buf);
-      exit (EXIT_FAILURE);
-    }
+  char buf[100];
+  sprintf (buf, "mtlinks/hyperbolic_data_%02d%c", n, alternating ? 'a' : 'n');
   
-  char *p;
+  t = new mt_table;
+  t->f = new mapped_file (knot_table_file (buf));
   
-  for (unsigned i = 1; i <= k; i ++)
+  const char *data = (const char *)t->f->data;
+  uint64 size = t->f->size;
+  t->line_start.push_back (0);
+  for (uint64 i = 0; i < size;)
     {
-      if (fgets (buf, 1000, fp) == 0)
-	{
-	  stderror ("fgets: %s", buf);
-	  exit (EXIT_FAILURE);
-	}
-      assert (alpha_to_int (buf[0]) == (int)n);
+      const char *e = (const char *)memchr (data + i, '\n', size - i);
+      i = e ? (uint64)(e - data) + 1 : size;
+      t->line_start.push_back (i);
+    }
+  if (t->line_start.size () != mt_links (n, alternating) + 1)
+    {
+      fprintf (stderr, "%s: corrupt or truncated file\n", t->f->file.c_str ());
+      exit (EXIT_FAILURE);
     }
+  return *t;
+}
+
+dt_code
+mt_link (unsigned n, bool alternating, unsigned k)
+{
+  assert (between (1, n, 14));
+  assert (between (1, k, mt_links (n, alternating)));
   
-  fclose (fp);
+  const mt_table &t = mt_link_table (n, alternating);
+  const char *data = (const char *)t.f->data;
+  std::string line (data + t.line_start[k - 1],
+		    data + t.line_start[k]);
+  assert (alpha_to_int (line[0]) == (int)n);
   
   char buf2[1000];
   sprintf (buf2, "L%d%c%d", n, alternating ? 'a' : 'n', k);
   
-  return dt_code (buf2, buf);
+  return dt_code (buf2, line.c_str ());
 }
 
 dt_code
 mt_link (unsigned n, unsigned k)
 {
-  assert (between (1, n, 16));
+  assert (between (1, n, 14));
   assert (k >= 1);
   
   unsigned na = mt_links (n, 1);
@@ -553,6 +628,17 @@ mt_link (unsigned n, unsigned k)
     return mt_link (n, 0, k - na);
 }
 
+mt_link_iter::mt_link_iter (unsigned n_, bool alternating_, unsigned first)
+  : n(n_), alternating(alternating_), k(first), last(mt_links (n_, alternating_))
+{
+}
+
+mt_link_iter::mt_link_iter (unsigned n_, bool alternating_, unsigned first, unsigned last_)
+  : n(n_), alternating(alternating_), k(first), last(last_)
+{
+  assert (last <= mt_links (n, alternating));
+}
+
 planar_diagram
 torus_knot (unsigned n_strands, unsigned n_shifts)
 {
@@ -739,12 +825,13 @@ mutant_knot_groups (unsigned n)
   assert (11 <= n && n <= 15);
   
   char buf[1000];
-  sprintf (buf, HOME "/mutant_knot_groups/dat%d", n);
+  sprintf (buf, "mutant_knot_groups/dat%d", n);
+  std::string file = knot_table_file (buf);
   
-  FILE *fp = fopen (buf, "r");
+  FILE *fp = fopen (file.c_str (), "r");
   if (fp == 0)
     {
-      stderror ("fopen: %s", buf);
+      stderror ("fopen: %s", file.c_str ());
       exit (EXIT_FAILURE);
     }
   
@@ -771,8 +858,43 @@ mutant_knot_groups (unsigned n)
   return r;
 }
 
+void
+open_knot_tables ()
+{
+  for (unsigned a = 0; a <= 1; a ++)
+    {
+      if (access (knot_table_file (a ? "alternating" : "nonalternating").c_str (), R_OK) == 0)
+	htw_knot_table (a);
+    }
+  
+  for (unsigned n = 1; n <= 14; n ++)
+    for (unsigned a = 0; a <= 1; a ++)
+      {
+	char buf[100];
+	sprintf (buf, "mtlinks/hyperbolic_data_%02d%c", n, a ? 'a' : 'n');
+	if (mt_links (n, a) > 0
+	    && access (knot_table_file (buf).c_str (), R_OK) == 0)
+	  mt_link_table (n, a);
+      }
+  
+  for (unsigned t = knot_desc::ROLFSEN; t < knot_desc::TORUS; t ++)
+    for (unsigned i = 1; i <= 16; i ++)
+      diagram_cache::find ((knot_desc::table)t, i);
+}
+
 knot_diagram
 knot_desc::diagram () const
+{
+  if (t != TORUS)
+    {
+      if (const diagram_cache *dc = diagram_cache::find (t, i))
+	return dc->diagram (j);
+    }
+  return compute_diagram ();
+}
+
+knot_diagram
+knot_desc::compute_diagram () const
 {
   switch (t)
     {
@@ -862,6 +984,41 @@ knot_desc::name () const
   return buf;
 }
 
+knot_desc
+knot_desc::from_name (const std::string &name)
+{
+  const char *s = name.c_str ();
+  unsigned n, k;
+  char c;
+  int end = -1;
+  
+  if (sscanf (s, "%u_%u%n", &n, &k, &end) == 2
+      && end == (int)name.size ())
+    {
+      if (n >= 1 && n <= 10
+	  && k >= 1 && k <= rolfsen_crossing_knots (n))
+	return knot_desc (ROLFSEN, n, k);
+    }
+  else if (sscanf (s, "L%u%c%u%n", &n, &c, &k, &end) == 3
+	   && end == (int)name.size ()
+	   && (c == 'a' || c == 'n'))
+    {
+      if (n >= 1 && n <= 14
+	  && k >= 1 && k <= mt_links (n, c == 'a'))
+	return knot_desc (c == 'a' ? MT_ALT : MT_NONALT, n, k);
+    }
+  else if (sscanf (s, "%u%c%u%n", &n, &c, &k, &end) == 3
+	   && end == (int)name.size ()
+	   && (c == 'a' || c == 'n'))
+    {
+      if (n >= 1 && n <= 16
+	  && k >= 1 && k <= htw_knots (n, c == 'a'))
+	return knot_desc (c == 'a' ? HTW_ALT : HTW_NONALT, n, k);
+    }
+  
+  return knot_desc ();
+}
+
 unsigned
 knot_desc::table_crossing_knots () const
 {
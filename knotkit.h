@@ -15,15 +15,21 @@ class knot_diagram;
 #include <planar_diagram.h>
 #include <dt_code.h>
 #include <knot_diagram.h>
+#include <jones.h>
+#include <alexander.h>
 
+#include <checkpoint.h>
 #include <simplify_chain_complex.h>
 #include <sseq.h>
 #include <smoothing.h>
 #include <cobordism.h>
 
+#include <twisted_evaluation.h>
 #include <cube.h>
+#include <s_invariant.h>
 #include <steenrod_square.h>
 #include <spanning_tree_complex.h>
+#include <integral_homology.h>
 
 class knot_desc
 {
@@ -83,11 +89,18 @@ class knot_desc
     return j < desc.j;
   }
   
+  // from the diagram cache of the table if there is one
   knot_diagram diagram () const;
+  // always from the table
+  knot_diagram compute_diagram () const;
   
   std::string name () const;
   unsigned table_crossing_knots () const;
   
+  // the table knot with the name name () gives it, e.g. 10_124, 11a12
+  // or L8n9 (HTW_ALT, MT_NONALT, ...), or t = NONE
+  static knot_desc from_name (const std::string &name);
+  
   hash_t hash_self () const
   {
     return hash_combine (hash ((int)t),
@@ -103,18 +116,56 @@ class knot_desc
 unsigned rolfsen_crossing_knots (unsigned n);
 planar_diagram rolfsen_knot (unsigned n, unsigned k);
 
+/* The knot tables are looked for in $KNOTKIT_TABLES, or in the
+   source directory if that is unset. */
+std::string knot_table_file (const std::string &name);
+
+/* Maps every table and diagram cache present now rather than on first
+   use, e.g. before forking workers that should share them. */
+void open_knot_tables ();
+
 unsigned htw_knots (unsigned n, bool alternating);
 unsigned htw_knots (unsigned n);
 
 dt_code htw_knot (unsigned n, bool alternating, unsigned k);
 dt_code htw_knot (unsigned n, unsigned k);
 
+/* The HTW knots with n crossings, alternating or not, k = first, ...,
+   last, decoded in one pass over the mapped table. */
+void htw_knots (unsigned n, bool alternating, unsigned first, unsigned last,
+		std::vector<dt_code> &out);
+void htw_knots (unsigned n, bool alternating, unsigned first, unsigned last,
+		std::vector<knot_diagram> &out);
+
 unsigned mt_links (unsigned n, bool alternating);
 unsigned mt_links (unsigned n);
 
 dt_code mt_link (unsigned n, bool alternating, unsigned k);
 dt_code mt_link (unsigned n, unsigned k);
 
+/* The MT links with n crossings, alternating or not, k = first, ...,
+   last: for (mt_link_iter i (n, 1); i; i ++) ... i.val () ...  The
+   tables are mapped once and indexed by line, so each link is read
+   in constant time. */
+class mt_link_iter
+{
+  unsigned n;
+  bool alternating;
+  unsigned k, last;
+  
+ public:
+  mt_link_iter (unsigned n_, bool alternating_, unsigned first = 1);
+  mt_link_iter (unsigned n_, bool alternating_, unsigned first, unsigned last_);
+  ~mt_link_iter () { }
+  
+  operator bool () const { return k <= last; }
+  void operator ++ () { k ++; }
+  void operator ++ (int) { k ++; }
+  
+  unsigned index () const { return k; }
+  dt_code val () const { return mt_link (n, alternating, k); }
+};
+
 planar_diagram torus_knot (unsigned n_strands, unsigned n_shifts);
 
 knot_diagram braid (unsigned n_strands, const basedvector<int, 1> &twists);
@@ -126,4 +177,8 @@ resolution_diagram parse_resolution_diagram (const char *s);
 // 11 <= n <= 15
 basedvector<basedvector<unsigned, 1>, 1> mutant_knot_groups (unsigned n);
 
+#include <diagram_cache.h>
+#include <invariant_store.h>
+#include <cost_model.h>
+
 #endif // _KNOTKIT_KNOTKIT_H
@@ -4,15 +4,42 @@
 
 writer::writer (bool raw_)
   : raw(raw_),
-    aw(new algebra_writer)
+    aw(new algebra_writer),
+    buf(new uint8[buf_size]),
+    buf_n(0)
 {
 }
 
 writer::~writer ()
 {
+  assert (buf_n == 0);  // subclass forgot to flush
+  delete [] buf;
   delete aw;
 }
 
+void
+writer::flush ()
+{
+  if (buf_n)
+    {
+      write_block (buf, buf_n);
+      buf_n = 0;
+    }
+}
+
+void
+writer::write_raw_slow (const void *p, size_t nbytes)
+{
+  flush ();
+  if (nbytes < buf_size)
+    {
+      memcpy (buf, p, nbytes);
+      buf_n = nbytes;
+    }
+  else
+    write_block (p, nbytes);
+}
+
 void
 writer::write_int (int x)
 {
@@ -108,6 +135,46 @@ writer::write_uint64 (uint64 x)
     }
 }
 
+void
+writer::write_increasing (const unsigned *p, unsigned n)
+{
+  if (raw)
+    {
+      unsigned prev = 0;
+      for (unsigned i = 0; i < n; i ++)
+	{
+	  assert (i == 0 || p[i] > prev);
+	  unsigned d = p[i] - prev;
+	  write_raw (&d, sizeof d, 1);
+	  prev = p[i];
+	}
+      return;
+    }
+  
+  unsigned prev = 0;
+  for (unsigned i = 0; i < n; i ++)
+    {
+      assert (i == 0 || p[i] > prev);
+      unsigned x = p[i] - prev;
+      prev = p[i];
+      
+      // encode in place, as write_unsigned
+      reserve (5);
+      for (;;)
+	{
+	  uint8 b = (uint8)(x & 0x7f);
+	  x >>= 7;
+	  if (x == 0
+	      && ! (b & 0x40))
+	    {
+	      buf[buf_n ++] = b;
+	      break;
+	    }
+	  buf[buf_n ++] = b | 0x80;
+	}
+    }
+}
+
 void
 writer::write_mpz (const mpz_t x)
 {
@@ -116,7 +183,8 @@ writer::write_mpz (const mpz_t x)
   size_t count;
   void *buf = mpz_export (nullptr, &count, -1, 1, -1, 0, x);
   
-  write_unsigned ((unsigned)count);
+  // mpz_export drops the sign
+  write_int (mpz_sgn (x) < 0 ? - (int)count : (int)count);
   write_raw (buf, 1, count);
   
   free (buf);
@@ -124,15 +192,71 @@ writer::write_mpz (const mpz_t x)
 
 reader::reader (bool raw_)
   : raw(raw_),
-    ar(new algebra_reader)
+    ar(new algebra_reader),
+    buf(new uint8[buf_size]),
+    buf_pos(0),
+    buf_n(0)
 {
 }
 
 reader::~reader ()
 {
+  delete [] buf;
   delete ar;
 }
 
+void
+reader::fill ()
+{
+  assert (buf_pos == buf_n);
+  buf_pos = 0;
+  buf_n = read_block (buf, buf_size);
+  if (buf_n == 0)
+    {
+      fprintf (stderr, "reader: unexpected end of file\n");
+      exit (EXIT_FAILURE);
+    }
+}
+
+void
+reader::read_raw_slow (void *p, size_t nbytes)
+{
+  uint8 *q = (uint8 *)p;
+  
+  unsigned avail = buf_n - buf_pos;
+  memcpy (q, buf + buf_pos, avail);
+  q += avail;
+  nbytes -= avail;
+  buf_pos = buf_n;
+  
+  if (nbytes >= buf_size)
+    {
+      while (nbytes > 0)
+	{
+	  size_t r = read_block (q, nbytes);
+	  if (r == 0)
+	    {
+	      fprintf (stderr, "reader: unexpected end of file\n");
+	      exit (EXIT_FAILURE);
+	    }
+	  q += r;
+	  nbytes -= r;
+	}
+    }
+  else
+    {
+      while (nbytes > 0)
+	{
+	  fill ();
+	  unsigned k = std::min ((size_t)buf_n, nbytes);
+	  memcpy (q, buf, k);
+	  buf_pos = k;
+	  q += k;
+	  nbytes -= k;
+	}
+    }
+}
+
 int
 reader::read_int ()
 {
@@ -207,13 +331,25 @@ reader::read_uint64 ()
   return x;
 }
 
+void
+reader::read_increasing (unsigned *p, unsigned n)
+{
+  unsigned prev = 0;
+  for (unsigned i = 0; i < n; i ++)
+    {
+      prev += read_unsigned ();
+      p[i] = prev;
+    }
+}
+
 void
 reader::read_mpz (mpz_t x)
 {
   assert (!raw);
   
-  unsigned count = read_unsigned ();
-  void *p = malloc (count);
+  int scount = read_int ();
+  unsigned count = scount < 0 ? - scount : scount;
+  void *p = malloc (count + 1);
   if (!p)
     {
       stderror ("malloc");
@@ -223,6 +359,8 @@ reader::read_mpz (mpz_t x)
   read_raw (p, 1, count);
   
   mpz_import (x, count, -1, 1, -1, 0, p);
+  if (scount < 0)
+    mpz_neg (x, x);
   
   free (p);
 }
@@ -266,57 +404,47 @@ extern void close_gzfile (gzFile gzfp)
 }
 
 void
-file_writer::write_raw (const void *p, size_t itemsize, size_t nitems)
+file_writer::write_block (const void *p, size_t nbytes)
 {
-  if (fwrite (p, itemsize, nitems, fp) != nitems)
+  if (fwrite (p, 1, nbytes, fp) != nbytes)
     {
       stderror ("fwrite");
       exit (EXIT_FAILURE);
     }
 }
 
-void
-file_writer::write_mpz (const mpz_t x)
-{
-  mpz_out_raw (fp, x);
-}
-
-void
-file_reader::read_raw (void *p, size_t itemsize, size_t nitems)
+size_t
+file_reader::read_block (void *p, size_t nbytes)
 {
-  if (fread (p, itemsize, nitems, fp) != nitems)
+  size_t r = fread (p, 1, nbytes, fp);
+  if (r < nbytes && ferror (fp))
     {
       stderror ("fread");
       exit (EXIT_FAILURE);
     }
+  return r;
 }
 
 void
-file_reader::read_mpz (mpz_t x)
+gzfile_writer::write_block (const void *p, size_t nbytes)
 {
-  mpz_inp_raw (x, fp);
-}
-
-void
-gzfile_writer::write_raw (const void *p, size_t itemsize, size_t nitems)
-{
-  unsigned nbytes = itemsize*nitems;
-  if (gzwrite (gzfp, p, nbytes) != nbytes)
+  if (gzwrite (gzfp, p, nbytes) != (int)nbytes)
     {
       stderror ("gzwrite");
       exit (EXIT_FAILURE);
     }
 }
 
-void
-gzfile_reader::read_raw (void *p, size_t itemsize, size_t nitems)
+size_t
+gzfile_reader::read_block (void *p, size_t nbytes)
 {
-  unsigned nbytes = itemsize*nitems;
-  if (gzread (gzfp, p, nbytes) != nitems)
+  int r = gzread (gzfp, p, nbytes);
+  if (r < 0)
     {
-      stderror ("fread");
+      stderror ("gzread");
       exit (EXIT_FAILURE);
     }
+  return r;
 }
 
 void
@@ -4,12 +4,32 @@ template<class R> class module;
 class algebra_writer;
 class algebra_reader;
 
+/* Small writes (single LEB128 values, bools, chars) are collected in
+   an internal buffer and handed to the subclass's write_block in
+   large pieces; similarly reader refills its buffer from read_block.
+   Subclasses must call flush () in their destructor before closing
+   the underlying stream. */
+
 class writer
 {
  public:
   bool raw;
   algebra_writer *aw;
   
+ private:
+  static const unsigned buf_size = 1 << 16;
+  
+  uint8 *buf;
+  unsigned buf_n;
+  
+  void write_raw_slow (const void *p, size_t nbytes);
+  
+  /* room for at least n more bytes in buf */
+  void reserve (unsigned n) { if (buf_n + n > buf_size) flush (); }
+  
+ protected:
+  virtual void write_block (const void *p, size_t nbytes) = 0;
+  
  public:
   writer (const writer &) = delete;
   writer (bool raw_);
@@ -17,7 +37,19 @@ class writer
   
   writer &operator = (const writer &) = delete;
   
-  virtual void write_raw (const void *p, size_t itemsize, size_t nitems) = 0;
+  void write_raw (const void *p, size_t itemsize, size_t nitems)
+  {
+    size_t nbytes = itemsize * nitems;
+    if (buf_n + nbytes <= buf_size)
+      {
+	memcpy (buf + buf_n, p, nbytes);
+	buf_n += nbytes;
+      }
+    else
+      write_raw_slow (p, nbytes);
+  }
+  
+  void flush ();
   
   void write_bool (bool x) { write_raw (&x, sizeof x, 1); }
   void write_char (char x) { write_raw (&x, sizeof x, 1); }
@@ -26,7 +58,12 @@ class writer
   void write_unsigned (unsigned x);
   void write_uint64 (uint64 x);
   
-  virtual void write_mpz (const mpz_t x);
+  /* bulk encoding of n strictly increasing values (e.g. the support
+     of a column), each stored as the difference to its
+     predecessor. */
+  void write_increasing (const unsigned *p, unsigned n);
+  
+  void write_mpz (const mpz_t x);
   
   template<class R> void write_mod (ptr<const module<R> > m);
 };
@@ -36,6 +73,19 @@ class reader
   bool raw;
   algebra_reader *ar;
   
+  static const unsigned buf_size = 1 << 16;
+  
+  uint8 *buf;
+  unsigned buf_pos, buf_n;
+  
+  void read_raw_slow (void *p, size_t nbytes);
+  void fill ();
+  
+ protected:
+  /* reads at most nbytes, returns the number of bytes read; 0 at end
+     of file. */
+  virtual size_t read_block (void *p, size_t nbytes) = 0;
+  
  public:
   reader (const reader &) = delete;
   reader (bool raw_);
@@ -43,7 +93,17 @@ class reader
   
   reader &operator = (const reader &) = delete;
   
-  virtual void read_raw (void *p, size_t itemsize, size_t nitems) = 0;
+  void read_raw (void *p, size_t itemsize, size_t nitems)
+  {
+    size_t nbytes = itemsize * nitems;
+    if (buf_pos + nbytes <= buf_n)
+      {
+	memcpy (p, buf + buf_pos, nbytes);
+	buf_pos += nbytes;
+      }
+    else
+      read_raw_slow (p, nbytes);
+  }
   
   bool read_bool ()
   {
@@ -61,18 +121,21 @@ class reader
   
   uint8 read_uint8 ()
   {
-    uint8 x;
-    read_raw (&x, sizeof x, 1);
-    return x;
+    if (buf_pos == buf_n)
+      fill ();
+    return buf[buf_pos ++];
   }
   
   int read_int ();
   unsigned read_unsigned ();
   uint64 read_uint64 ();
   
-  virtual void read_mpz (mpz_t x);
+  void read_increasing (unsigned *p, unsigned n);
+  
+  void read_mpz (mpz_t x);
   
   template<class R> ptr<const module<R> > read_mod ();
+  template<class R> ptr<const module<R> > read_mod (int io_id);
 };
 
 extern FILE *open_file (const std::string &file, const char *mode);
@@ -93,12 +156,12 @@ class file_writer : public writer
   {
   }
   file_writer (const file_writer &) = delete;
-  ~file_writer () { close_file (fp); }
+  ~file_writer () { flush (); close_file (fp); }
   
   file_writer &operator = (const file_writer &) = delete;
   
-  void write_raw (const void *p, size_t itemsize, size_t nitems);
-  void write_mpz (const mpz_t x);
+ protected:
+  void write_block (const void *p, size_t nbytes);
 };
 
 class file_reader : public reader
@@ -117,8 +180,8 @@ class file_reader : public reader
   
   file_reader &operator = (const file_reader &) = delete;
   
-  void read_raw (void *p, size_t itemsize, size_t nitems);
-  void read_mpz (mpz_t x);
+ protected:
+  size_t read_block (void *p, size_t nbytes);
 };
 
 class gzfile_writer : public writer
@@ -133,11 +196,12 @@ class gzfile_writer : public writer
   {
   }
   gzfile_writer (const gzfile_writer &) = delete;
-  ~gzfile_writer () { close_gzfile (gzfp); }
+  ~gzfile_writer () { flush (); close_gzfile (gzfp); }
   
   gzfile_writer &operator = (const gzfile_writer &) = delete;
   
-  void write_raw (const void *p, size_t itemsize, size_t nitems);
+ protected:
+  void write_block (const void *p, size_t nbytes);
 };
 
 class gzfile_reader : public reader
@@ -156,7 +220,8 @@ class gzfile_reader : public reader
   
   gzfile_reader &operator = (const gzfile_reader &) = delete;
   
-  void read_raw (void *p, size_t itemsize, size_t nitems);
+ protected:
+  size_t read_block (void *p, size_t nbytes);
 };
 
 inline void read (reader &r, bool &x) { x = r.read_bool (); }
@@ -175,6 +175,8 @@ using std::initializer_list;
 #include <lib/refcount.h>
 
 #include <lib/io.h>
+#include <lib/mapped_file.h>
+#include <lib/spill.h>
 
 #include <lib/pair.h>
 
@@ -236,6 +238,16 @@ class algebra_reader
 public:
   map<unsigned, unsigned> io_id_id;
   
+  /* modules read are registered in module<R>::reader_id_module;
+     these drop them again when the reader goes away. */
+  basedvector<pair<void (*) (unsigned), unsigned>, 1> release_ids;
+  
+  algebra_reader () { }
+  ~algebra_reader ()
+  {
+    for (unsigned i = 1; i <= release_ids.size (); i ++)
+      release_ids[i].first (release_ids[i].second);
+  }
 };
 
 #endif // _KNOTKIT_LIB_LIB_H
@@ -0,0 +1,46 @@
+
+#include <lib/lib.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+mapped_file::mapped_file (const std::string &file_)
+  : file(file_),
+    data(0),
+    size(0)
+{
+  int fd = open (file.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      stderror ("open: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  
+  struct stat st;
+  if (fstat (fd, &st) < 0)
+    {
+      stderror ("fstat: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  size = st.st_size;
+  
+  if (size > 0)
+    {
+      void *p = mmap (0, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED)
+	{
+	  stderror ("mmap: %s", file.c_str ());
+	  exit (EXIT_FAILURE);
+	}
+      data = (const uint8 *)p;
+    }
+  
+  close (fd);
+}
+
+mapped_file::~mapped_file ()
+{
+  if (data)
+    munmap ((void *)data, size);
+}
@@ -0,0 +1,34 @@
+#ifndef _KNOTKIT_LIB_MAPPED_FILE_H
+#define _KNOTKIT_LIB_MAPPED_FILE_H
+
+/* read-only mmap of a whole file.  Pages are shared between all
+   processes mapping the same file. */
+
+class mapped_file : public refcounted
+{
+ public:
+  std::string file;
+  const uint8 *data;
+  size_t size;
+  
+ public:
+  mapped_file (const mapped_file &) = delete;
+  mapped_file (const std::string &file_);
+  ~mapped_file ();
+  
+  mapped_file &operator = (const mapped_file &) = delete;
+  
+  template<class T> const T *at (uint64 offset, uint64 n = 1) const
+  {
+    if (offset % alignof (T) != 0
+	|| offset > size
+	|| n > (size - offset) / sizeof (T))
+      {
+	fprintf (stderr, "%s: corrupt or truncated file\n", file.c_str ());
+	exit (EXIT_FAILURE);
+      }
+    return (const T *)(data + offset);
+  }
+};
+
+#endif // _KNOTKIT_LIB_MAPPED_FILE_H
@@ -0,0 +1,152 @@
+
+#include <lib/lib.h>
+
+#include <unistd.h>
+
+uint64 spill_budget = 0;
+std::string spill_dir;
+
+spill_file::spill_file ()
+  : size(0)
+{
+  std::string dir = spill_dir;
+  if (dir.empty ())
+    {
+      const char *tmpdir = getenv ("TMPDIR");
+      dir = tmpdir ? tmpdir : "/tmp";
+    }
+  
+  std::string file = dir + "/kk-spill-XXXXXX";
+  fd = mkstemp (&file[0]);
+  if (fd < 0)
+    {
+      stderror ("mkstemp: %s", file.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  
+  // nothing refers to the file by name: it goes away with fd
+  unlink (file.c_str ());
+}
+
+spill_file::~spill_file ()
+{
+  close (fd);
+}
+
+void
+spill_file::append (const void *p, size_t nbytes)
+{
+  const char *q = (const char *)p;
+  while (nbytes > 0)
+    {
+      ssize_t r = pwrite (fd, q, nbytes, size);
+      if (r < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  stderror ("pwrite");
+	  exit (EXIT_FAILURE);
+	}
+      q += r;
+      nbytes -= r;
+      size += r;
+    }
+}
+
+void
+spill_file::read (uint64 offset, void *p, size_t nbytes) const
+{
+  assert (offset + nbytes <= size);
+  
+  char *q = (char *)p;
+  while (nbytes > 0)
+    {
+      ssize_t r = pread (fd, q, nbytes, offset);
+      if (r <= 0)
+	{
+	  if (r < 0 && errno == EINTR)
+	    continue;
+	  stderror ("pread");
+	  exit (EXIT_FAILURE);
+	}
+      q += r;
+      nbytes -= r;
+      offset += r;
+    }
+}
+
+size_t
+spill_reader::read_block (void *p, size_t nbytes)
+{
+  if (nbytes > end - pos)
+    nbytes = end - pos;
+  f->read (pos, p, nbytes);
+  pos += nbytes;
+  return nbytes;
+}
+
+/* the cache: blocks by time of last use, and the time of last use
+   and size of each block */
+static uint64 cache_clock = 0;
+static uint64 cache_bytes = 0;
+static std::map<uint64, std::pair<spill_cached *, unsigned> > cache_lru;
+static std::map<std::pair<spill_cached *, unsigned>,
+		std::pair<uint64, uint64> > cache_blocks;
+
+void
+spill_cached::touch_block (unsigned b, uint64 nbytes)
+{
+  std::pair<spill_cached *, unsigned> k (this, b);
+  
+  auto i = cache_blocks.find (k);
+  if (i != cache_blocks.end ())
+    {
+      cache_lru.erase (i->second.first);
+      i->second.first = ++ cache_clock;
+    }
+  else
+    {
+      cache_blocks[k] = std::pair<uint64, uint64> (++ cache_clock, nbytes);
+      cache_bytes += nbytes;
+    }
+  cache_lru[cache_clock] = k;
+  
+  // never evict the block just touched
+  while (cache_bytes > spill_budget
+	 && cache_lru.size () > 1)
+    {
+      auto j = cache_lru.begin ();
+      std::pair<spill_cached *, unsigned> old = j->second;
+      cache_lru.erase (j);
+  
+      auto l = cache_blocks.find (old);
+      cache_bytes -= l->second.second;
+      cache_blocks.erase (l);
+  
+      old.first->evict (old.second);
+    }
+}
+
+void
+spill_cached::forget_block (unsigned b)
+{
+  auto i = cache_blocks.find (std::pair<spill_cached *, unsigned> (this, b));
+  if (i == cache_blocks.end ())
+    return;
+  
+  cache_lru.erase (i->second.first);
+  cache_bytes -= i->second.second;
+  cache_blocks.erase (i);
+}
+
+spill_cached::~spill_cached ()
+{
+  auto i = cache_blocks.lower_bound (std::pair<spill_cached *, unsigned> (this, 0));
+  while (i != cache_blocks.end ()
+	 && i->first.first == this)
+    {
+      cache_lru.erase (i->second.first);
+      cache_bytes -= i->second.second;
+      i = cache_blocks.erase (i);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef _KNOTKIT_LIB_SPILL_H
+#define _KNOTKIT_LIB_SPILL_H
+
+/* Out-of-core support.  With spill_budget set, large maps keep most
+   of their columns in blocks of an anonymous temporary file in
+   spill_dir and hold roughly spill_budget bytes of columns in memory
+   at a time. */
+
+// bytes; 0 keeps everything in core
+extern uint64 spill_budget;
+// "" means $TMPDIR, or /tmp
+extern std::string spill_dir;
+
+class spill_file : public refcounted
+{
+  int fd;
+  
+ public:
+  uint64 size;
+  
+ public:
+  spill_file ();
+  spill_file (const spill_file &) = delete;
+  ~spill_file ();
+  
+  spill_file &operator = (const spill_file &) = delete;
+  
+  void append (const void *p, size_t nbytes);
+  void read (uint64 offset, void *p, size_t nbytes) const;
+};
+
+/* Appends a block to f.  The block starts at offset; its size is
+   f->size - offset after flush (). */
+class spill_writer : public writer
+{
+  ptr<spill_file> f;
+  
+ public:
+  uint64 offset;
+  
+ public:
+  spill_writer (ptr<spill_file> f_)
+    : writer(false),
+      f(f_),
+      offset(f_->size)
+  { }
+  spill_writer (const spill_writer &) = delete;
+  ~spill_writer () { flush (); }
+  
+  spill_writer &operator = (const spill_writer &) = delete;
+  
+ protected:
+  void write_block (const void *p, size_t nbytes) { f->append (p, nbytes); }
+};
+
+class spill_reader : public reader
+{
+  ptr<spill_file> f;
+  uint64 pos, end;
+  
+ public:
+  spill_reader (ptr<spill_file> f_, uint64 offset, uint64 size)
+    : reader(false),
+      f(f_),
+      pos(offset),
+      end(offset + size)
+  { }
+  spill_reader (const spill_reader &) = delete;
+  ~spill_reader () { }
+  
+  spill_reader &operator = (const spill_reader &) = delete;
+  
+ protected:
+  size_t read_block (void *p, size_t nbytes);
+};
+
+/* Blocks loaded back from disk are shared by all spilling objects in
+   one least-recently-used cache of about spill_budget bytes.  When
+   the cache is full, evict (b) asks the owner of the oldest block to
+   drop its copy of block b. */
+class spill_cached
+{
+ public:
+  spill_cached () { }
+  spill_cached (const spill_cached &) = delete;
+  virtual ~spill_cached ();
+  
+  spill_cached &operator = (const spill_cached &) = delete;
+  
+  // block b (of about nbytes in memory) is loaded and was just used
+  void touch_block (unsigned b, uint64 nbytes);
+  // block b was dropped by the owner
+  void forget_block (unsigned b);
+  
+  virtual void evict (unsigned b) = 0;
+};
+
+#endif // _KNOTKIT_LIB_SPILL_H
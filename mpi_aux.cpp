@@ -54,6 +54,15 @@ send_string (const std::string &s, int dest)
   send_string (s.c_str (), dest);
 }
 
+bool
+message_waiting ()
+{
+  int flag;
+  MPI_Status status;
+  MPI_Iprobe (MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+  return flag;
+}
+
 int
 recv_int (int *src)
 {
@@ -9,6 +9,9 @@ void send_int (int v, int dest);
 void send_string (const char *s, int dest);
 void send_string (const std::string &s, int dest);
 
+// whether a message is waiting to be received
+bool message_waiting ();
+
 int recv_int (int *src);
 std::string recv_string (int *src);
 
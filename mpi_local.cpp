@@ -0,0 +1,357 @@
+
+#include <lib/lib.h>
+#include <mpi_aux.h>
+
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* mpi_aux.h on one machine, without MPI: comm_init forks the other
+   tasks, and each pair of tasks has a pipe in each direction.  A
+   message is its length as an int followed by its bytes; an int is
+   sent as 4 bytes.  comm_finalize sends a length of -1, so a pipe
+   closed without one means the task died, and that takes the others
+   with it, as under MPI.  The number of tasks is given by -np <n> at
+   the front of the arguments, as to mpiexec, and is one more than the
+   number of cores by default. */
+
+static int rank = 0;
+static int ntasks = 1;
+
+// in_fds[r], out_fds[r]: from and to rank r, -1 for self
+static std::vector<int> in_fds, out_fds;
+static std::vector<pid_t> children;
+static bool finalized = 0;
+
+// lengths[r]: of the message from rank r whose length has been read, or
+// -1
+static std::vector<int> lengths;
+
+// rank to start the search for a waiting message from, so no sender
+// is starved
+static int next_src = 0;
+
+// rank 0 leaving early takes the other tasks with it
+static void
+kill_tasks ()
+{
+  if (finalized)
+    return;
+  
+  for (unsigned i = 0; i < children.size (); i ++)
+    kill (children[i], SIGKILL);
+}
+
+void
+comm_init (int *argc, char ***argv)
+{
+  ntasks = std::thread::hardware_concurrency () + 1;
+  if (*argc >= 3 && !strcmp ((*argv)[1], "-np"))
+    {
+      ntasks = atoi ((*argv)[2]);
+      if (ntasks < 1)
+	{
+	  fprintf (stderr, "error: bad number of tasks `%s'\n", (*argv)[2]);
+	  exit (EXIT_FAILURE);
+	}
+      (*argv)[2] = (*argv)[0];
+      *argc -= 2;
+      *argv += 2;
+    }
+  
+  // pipes[i][j]: from rank i to rank j
+  std::vector<std::vector<int> > read_ends (ntasks, std::vector<int> (ntasks, -1)),
+    write_ends (ntasks, std::vector<int> (ntasks, -1));
+  for (int i = 0; i < ntasks; i ++)
+    for (int j = 0; j < ntasks; j ++)
+      {
+	if (i == j)
+	  continue;
+  
+	int fds[2];
+	if (pipe (fds) != 0)
+	  {
+	    stderror ("pipe");
+	    exit (EXIT_FAILURE);
+	  }
+	read_ends[i][j] = fds[0];
+	write_ends[i][j] = fds[1];
+      }
+  
+  // a write to a task that has gone is an error, not a signal
+  signal (SIGPIPE, SIG_IGN);
+  
+  fflush (stdout);
+  fflush (stderr);
+  for (int r = 1; r < ntasks; r ++)
+    {
+      pid_t pid = fork ();
+      if (pid < 0)
+	{
+	  stderror ("fork");
+	  exit (EXIT_FAILURE);
+	}
+      if (pid == 0)
+	{
+	  rank = r;
+	  children.clear ();
+	  break;
+	}
+      children.push_back (pid);
+    }
+  if (rank == 0)
+    atexit (kill_tasks);
+  
+  in_fds.assign (ntasks, -1);
+  out_fds.assign (ntasks, -1);
+  lengths.assign (ntasks, -1);
+  for (int i = 0; i < ntasks; i ++)
+    for (int j = 0; j < ntasks; j ++)
+      {
+	if (i == j)
+	  continue;
+  
+	if (j == rank)
+	  in_fds[i] = read_ends[i][j];
+	else
+	  close (read_ends[i][j]);
+  
+	if (i == rank)
+	  out_fds[j] = write_ends[i][j];
+	else
+	  close (write_ends[i][j]);
+      }
+}
+
+void
+comm_finalize ()
+{
+  finalized = 1;
+  
+  // a length of -1 tells the others this task is done; any of them
+  // may have finished already
+  for (int r = 0; r < ntasks; r ++)
+    {
+      if (out_fds[r] < 0)
+	continue;
+  
+      int n = -1;
+      if (write (out_fds[r], &n, sizeof n) != sizeof n
+	  && errno != EPIPE)
+	{
+	  stderror ("write");
+	  exit (EXIT_FAILURE);
+	}
+      close (out_fds[r]);
+    }
+  
+  bool failed = 0;
+  for (unsigned i = 0; i < children.size (); i ++)
+    {
+      int status;
+      while (waitpid (children[i], &status, 0) < 0)
+	{
+	  if (errno != EINTR)
+	    {
+	      stderror ("waitpid");
+	      exit (EXIT_FAILURE);
+	    }
+	}
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	failed = 1;
+    }
+  if (failed)
+    {
+      fprintf (stderr, "error: a task failed\n");
+      exit (EXIT_FAILURE);
+    }
+}
+
+int
+self_rank ()
+{
+  return rank;
+}
+
+int
+num_tasks  ()
+{
+  return ntasks;
+}
+
+static void
+send_bytes (const void *p, int n, int dest)
+{
+  assert (dest >= 0 && dest < ntasks && dest != rank);
+  
+  const char *s = (const char *)p;
+  while (n > 0)
+    {
+      ssize_t k = write (out_fds[dest], s, n);
+      if (k < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  fprintf (stderr, "error: [% 2d] lost task %d\n", rank, dest);
+	  exit (EXIT_FAILURE);
+	}
+      s += k;
+      n -= k;
+    }
+}
+
+static void
+recv_bytes (void *p, int n, int src)
+{
+  char *s = (char *)p;
+  while (n > 0)
+    {
+      ssize_t k = read (in_fds[src], s, n);
+      if (k < 0 && errno == EINTR)
+	continue;
+      if (k <= 0)
+	{
+	  fprintf (stderr, "error: [% 2d] lost task %d\n", rank, src);
+	  exit (EXIT_FAILURE);
+	}
+      s += k;
+      n -= k;
+    }
+}
+
+static void
+send_message (const void *p, int n, int dest)
+{
+  send_bytes (&n, sizeof n, dest);
+  send_bytes (p, n, dest);
+}
+
+// waits up to timeout ms for a message and reads its length; the rank
+// it is from, or -1
+static int
+wait_message (int timeout)
+{
+  for (;;)
+    {
+      for (int i = 0; i < ntasks; i ++)
+	{
+	  int r = (next_src + i) % ntasks;
+	  if (lengths[r] >= 0)
+	    {
+	      next_src = (r + 1) % ntasks;
+	      return r;
+	    }
+	}
+  
+      std::vector<pollfd> fds;
+      std::vector<int> srcs;
+      for (int r = 0; r < ntasks; r ++)
+	{
+	  if (in_fds[r] < 0)
+	    continue;
+  
+	  pollfd pfd;
+	  pfd.fd = in_fds[r];
+	  pfd.events = POLLIN;
+	  pfd.revents = 0;
+	  fds.push_back (pfd);
+	  srcs.push_back (r);
+	}
+      if (fds.empty ())
+	{
+	  if (timeout == 0)
+	    return -1;
+	  fprintf (stderr, "error: [% 2d] no tasks left to receive from\n", rank);
+	  exit (EXIT_FAILURE);
+	}
+  
+      int k = poll (fds.data (), fds.size (), timeout);
+      if (k < 0 && errno == EINTR)
+	continue;
+      if (k < 0)
+	{
+	  stderror ("poll");
+	  exit (EXIT_FAILURE);
+	}
+      if (k == 0)
+	return -1;
+  
+      // a closed pipe reads as ready, and recv_bytes reports the lost task
+      for (unsigned i = 0; i < fds.size (); i ++)
+	{
+	  if (!fds[i].revents)
+	    continue;
+  
+	  int r = srcs[i];
+	  int n;
+	  recv_bytes (&n, sizeof n, r);
+	  if (n < 0)
+	    {
+	      // r has finished
+	      close (in_fds[r]);
+	      in_fds[r] = -1;
+	    }
+	  else
+	    lengths[r] = n;
+	}
+    }
+}
+
+static std::string
+recv_message (int *src)
+{
+  int r = wait_message (-1);
+  assert (r >= 0);
+  if (src)
+    *src = r;
+  
+  std::string s (lengths[r], '\0');
+  lengths[r] = -1;
+  recv_bytes (&s[0], s.size (), r);
+  return s;
+}
+
+void
+send_int (int v, int dest)
+{
+  send_message (&v, sizeof v, dest);
+}
+
+void
+send_string (const char *s, int dest)
+{
+  send_message (s, strlen (s), dest);
+}
+
+void
+send_string (const std::string &s, int dest)
+{
+  send_message (s.data (), s.size (), dest);
+}
+
+bool
+message_waiting ()
+{
+  return wait_message (0) >= 0;
+}
+
+int
+recv_int (int *src)
+{
+  std::string s = recv_message (src);
+  assert (s.size () == sizeof (int));
+  
+  int v;
+  memcpy (&v, s.data (), sizeof v);
+  return v;
+}
+
+std::string
+recv_string (int *src)
+{
+  return recv_message (src);
+}
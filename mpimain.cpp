@@ -1,136 +1,56 @@
-
 #include <knotkit.h>
 
-#include <mpi.h>
 #include <mpi_aux.h>
 
-#define CMD_DO 1
-#define CMD_DIE 2
+#include <algorithm>
+#include <deque>
 
-static const int block_size = 100;
+/* Computes bounds on the splitting number of the multi-component MT
+   links.  Rank 0 schedules the links and writes the results; the other
+   ranks compute them.
 
-void
-master ()
-{
-  basedvector<knot_desc, 1> work;
-  
-  for (unsigned i = 1; i <= 10; i ++)
-    for (unsigned j = 1; j <= mt_links (i); j ++)
-      {
-	knot_diagram kd (mt_links (i, j));
-	unsigned n = kd.num_components ();
-	if (n < 2)
-	  continue;
-	
-	work.append (knot_desc (knot_desc::MT, i, j));
-      }
-  
-#if 0  
-  basedvector<basedvector<unsigned, 1>, 1> groups = mutant_knot_groups (15);
+   Links go out longest expected job first, by the estimates of
+   cost_model.h, in batches sized to a share of the estimated work
+   left, so the big links go one at a time and the batches of small
+   ones shrink towards the end of the sweep.  Each worker is kept one
+   batch ahead, so the next batch has arrived by the time the current
+   one is done.  Once the queue is empty, an idle worker gets the
+   unstarted half of the queue of the worker with the most left.  All
+   messages are strings, one item per line:
 
-  for (unsigned i = 1; i <= groups.size (); i ++)
-    for (unsigned j = 1; j <= groups[i].size (); j ++)
-      work.append (knot_desc (knot_desc::HTW, 15, groups[i][j]));
-#endif
-  
-#if 0
-  for (unsigned i = 14; i >= 1; i --)
-    {
-      if (i <= 10)
-	{
-	  for (unsigned j = 1; j <= rolfsen_crossing_knots (i); j += block_size)
-	    {
-	      work.append (knot_desc (ROLFSEN, i, j));
-	    }
-	}
-      
-      for (unsigned j = 1; j <= htw_knots (i); j += block_size)
-	{
-	  work.append (knot_desc (HTW, i, j));
-	}
-      
-      if (i <= 13)
-	{
-	  for (unsigned j = 1; j <= mt_links (i); j += block_size)
-	    {
-	      work.append (knot_desc (MT, i, j));
-	    }
-	}
-    }
-#endif
-  
-  int ntasks = num_tasks ();
-  
-  set<unsigned> active;
-  
-  for (int rank = 1; rank < ntasks && work.size () > 0; rank ++)
-    {
-      send_int (CMD_DO, rank);
-      
-      knot_desc desc = work.pop ();
-      send_int ((int)desc.t, rank);
-      send_int ((int)desc.i, rank);
-      send_int ((int)desc.j, rank);
-      
-      active.push (rank);
-    }
-  while (work.size () > 0)
-    {
-      int rank;
-      int dummy = recv_int (&rank);
-      
-      send_int (CMD_DO, rank);
-      
-      knot_desc desc = work.pop ();
-      send_int ((int)desc.t, rank);
-      send_int ((int)desc.i, rank);
-      send_int ((int)desc.j, rank);
-    }
-  
-  while (active.card () > 0)
-    {
-      int rank;
-      int dummy = recv_int (&rank);
-      active -= rank;
-    }
-  
-  for (int rank = 1; rank < ntasks; rank ++)
-    {
-      send_int (CMD_DIE, rank);
-    }
-}
+     to a worker:   batch, then <t> <i> <j> per link
+                    steal
+                    exit
+     to rank 0:     result, <t> <i> <j>, the result
+                    stolen, then <t> <i> <j> per link given up
+
+   Each result is written as it arrives as a line <link> TAB <result>.
+   With -store, workers look results up in the invariant store and
+   record them there, so an interrupted sweep picks up where it
+   stopped. */
 
-bool
-file_exists (const char *file)
+const char *out_file = 0;
+unsigned max_n = 10;
+
+void
+usage ()
 {
-  struct stat stat_buf;
-  if (stat (file, &stat_buf) != 0)
-    {
-      if (errno == ENOENT)
-	return 0;
-      
-      stderror ("stat: %s", file);
-      exit (EXIT_FAILURE);
-    }
-  
-  return 1;
+  printf ("usage: mpimain [options...] [<n>]\n"
+	  "  computes splitting number bounds of the MT links with at most\n"
+	  "  <n> crossings and two or more components (10 is the default)\n"
+	  "options:\n"
+	  "  -h         : print this message\n"
+	  "  -o <file>  : write results to <file> (stdout is the default)\n"
+	  "  -store <dir>: reuse the results recorded in the store <dir>\n"
+	  "                and record new ones there\n");
 }
 
-#if 0
-void
-compute_forgetful (int rank, knot_desc desc, const char *buf)
+template<class R> mod_map<R>
+compute_link_splitting_d (knot_diagram &kd,
+			  cube<R> &c,
+			  basedvector<R, 1> comp_weight)
 {
-  knot_diagram kd = desc.diagram ();
-  
-  typedef Zp<97> R;
-  
   unsigned n = kd.num_components ();
-  assert (n >= 2);
-  assert (n < 97);
-  
-  printf ("[% 2d] ", rank);
-  show (kd);
-  newline ();
   
   unionfind<1> u (kd.num_edges ());
   for (unsigned i = 1; i <= kd.n_crossings; i ++)
@@ -140,7 +60,7 @@ compute_forgetful (int rank, knot_desc desc, const char *buf)
       u.join (kd.ept_edge (kd.crossings[i][2]),
 	      kd.ept_edge (kd.crossings[i][4]));
     }
-	
+  
   map<unsigned, unsigned> root_comp;
   unsigned t = 0;
   for (unsigned i = 1; i <= kd.num_edges (); i ++)
@@ -152,17 +72,15 @@ compute_forgetful (int rank, knot_desc desc, const char *buf)
 	}
     }
   assert (t == n);
-	
-  basedvector<R, 1> comp_weight (n);
-  for (unsigned i = 1; i <= n; i ++)
-    comp_weight[i] = R ((int)i);
-	
+  
+  assert (comp_weight.size () == n);
+  
   map<unsigned, R> crossing_over_sign;
-	
+  
   // crossings
   set<unsigned> pending;
   set<unsigned> finished;
-	
+  
   crossing_over_sign.push (1, R (1));
   pending.push (1);
   
@@ -170,129 +88,139 @@ compute_forgetful (int rank, knot_desc desc, const char *buf)
     {
       unsigned x = pending.pop ();
       finished.push (x);
-      
+  
       R s = crossing_over_sign(x);
-      
+  
       for (unsigned j = 1; j <= 4; j ++)
 	{
 	  unsigned p = kd.crossings[x][j];
 	  R t = kd.is_over_ept (p) ? s : -s;  // sign of (x, p)
-	  
+  
 	  unsigned q = kd.edge_other_ept (p);
 	  unsigned x2 = kd.ept_crossing[q];
-	  
+  
 	  R u = kd.is_over_ept (q) ? -t : t;
-	  
+  
 	  if (crossing_over_sign % x2)
 	    assert (crossing_over_sign(x2) == u);
 	  else
 	    crossing_over_sign.push (x2, u);
-	  
+  
 	  if (! (finished % x2))
 	    pending += x2;
 	}
     }
   assert (finished.card () == kd.n_crossings);
-	
-#if 0
-  printf ("crossing_over_sign:\n");
-  for (unsigned i = 1; i <= kd.n_crossings; i ++)
-    {
-      printf ("  % 2d: ", i);
-      display (crossing_over_sign(i));
-    }
-#endif
-	
-  cube<R> c (kd);
-#if 0
-  for (unsigned i = 0; i < c.n_resolutions; i ++)
-    {
-      smallbitset state (kd.n_crossings, i);
-      smoothing s (kd, state);
-      s.show_self (kd, state);
-      newline ();
-    }
-#endif
   
   mod_map<R> untwisted_d = c.compute_d (1, 0, 0, 0, 0);
   assert (untwisted_d.compose (untwisted_d) == 0);
-	
+  
   mod_map<R> d = untwisted_d;
   for (unsigned x = 1; x <= kd.n_crossings; x ++)
     {
       unsigned p1 = kd.crossings[x][1],
 	p2 = kd.crossings[x][2];
       assert (kd.is_over_ept (p2));
-	    
+  
       unsigned r1 = u.find (kd.ept_edge (p1)),
 	r2 = u.find (kd.ept_edge (p2));
-	    
+  
       unsigned c1 = root_comp(r1),
 	c2 = root_comp(r2);
-	    
+  
       if (c1 != c2)
 	{
 	  R s = crossing_over_sign(x);
-		
+  
 	  R w_under = comp_weight[c1];
 	  R w_over = comp_weight[c2];
-		
-	  d = d + c.compute_dinv (x)*(s*(w_over - w_under))
-	    ;
+  
+	  d = d + c.compute_dinv (x)*(s*(w_over - w_under));
 	}
     }
   
-  // display ("d:\n", d);
-  
-  // mod_map<Z> h = d.compose (d);
-  // display ("h:\n", h);
-  
   assert (d.compose (d) == 0);
+  return d;
+}
+
+// the last page of the link splitting spectral sequence with a
+// nonzero differential, or 0 if it collapses at E_1
+template<class R> unsigned
+splitting_bound (knot_diagram &kd,
+		 basedvector<R, 1> comp_weight)
+{
+  cube<R> c (kd);
+  ptr<const module<R> > C = c.khC;
+  mod_map<R> d = compute_link_splitting_d (kd, c, comp_weight);
   
-  ptr<const module<R> > Ek = c.khC;
-  mod_map<R> dk = d;
-  
-  basedvector<multivariate_laurentpoly<Z>, 1> pages;
-  
-  unsigned kinf;
-  for (int dq = 0;; dq -= 2)
+  for (int k = 0;; k ++)
     {
-      chain_complex_simplifier<R> s (Ek, dk, dq);
-      Ek = s.new_C;
-      dk = s.new_d;
-      
-      pages.append (Ek->free_poincare_polynomial ());
-      
-      printf ("[% 2d] ", rank);
-      printf ("|E%d| = %d\n", ((- dq) / 2) + 1, Ek->dim ());
-      if (dk == 0)
-	{
-	  kinf = ((- dq) / 2);
-	  break;
-	}
+      chain_complex_simplifier<R> s (C, d,
+				     maybe<int> (1 - 2*k), maybe<int> (-2*k));
+      C = s.new_C;
+      d = s.new_d;
+      if (d == 0)
+	return k;
     }
+}
+
+basedvector<basedvector<unsigned, 1>, 1>
+permutations (basedvector<unsigned, 1> v)
+{
+  unsigned n = v.size ();
+  basedvector<basedvector<unsigned, 1>, 1> ps;
   
-  unsigned total_lk = kd.total_linking_number ();
+  if (n == 1)
+    {
+      ps.append (v);
+      return ps;
+    }
   
-  unsigned trivial_bound = total_lk == 0 ? 2 : total_lk;
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      unsigned x = v[i];
   
-  printf ("[% 2d] ", rank);
-  printf ("kinf = %d, trivial bound = %d (total_lk = %d)\n",
-	  kinf, trivial_bound, total_lk);
+      basedvector<unsigned, 1> v2 (n - 1);
+      for (unsigned j = 1; j < i; j ++)
+	v2[j] = v[j];
+      for (unsigned j = i + 1; j <= n; j ++)
+	v2[j - 1] = v[j];
   
-  if (trivial_bound < kinf)
-    {
-      printf ("[% 2d] ", rank);
-      printf (" > BETTER\n");
+      basedvector<basedvector<unsigned, 1>, 1> ps2 = permutations (v2);
+      for (unsigned j = 1; j <= ps2.size (); j ++)
+	{
+	  basedvector<unsigned, 1> p2 = ps2[j];
+	  assert (p2.size () == n - 1);
+  
+	  basedvector<unsigned, 1> v3 (n);
+	  v3[1] = x;
+	  for (unsigned k = 1; k <= n - 1; k ++)
+	    v3[k + 1] = p2[k];
+	  ps.append (v3);
+	}
     }
-  fflush (stdout);
   
-  assert (desc.t == knot_desc::MT);  
-  gzfile_writer w (buf);
-  write (w, desc);
-  write (w, pages);
+  return ps;
+}
+
+basedvector<basedvector<unsigned, 1>, 1>
+permutations (unsigned n)
+{
+  basedvector<unsigned, 1> v (n);
+  for (unsigned i = 1; i <= n; i ++)
+    v[i] = i;
+  return permutations (v);
+}
+
+template<class R> multivariate_laurentpoly<Z>
+Kh_poincare_polynomial (knot_diagram &kd)
+{
+  cube<R> c (kd);
+  mod_map<R> d = c.compute_d (1, 0, 0, 0, 0);
+  chain_complex_simplifier<R> s (c.khC, d, maybe<int> (1), maybe<int> (0));
+  assert (s.new_d == 0);
+  return s.new_C->free_poincare_polynomial ();
 }
-#endif
 
 unsigned
 compute_b_lk_weak (knot_diagram &kd)
@@ -317,14 +245,17 @@ compute_b_lk_weak (knot_diagram &kd)
     }
   assert (m == u.num_sets ());
   
+  // components numbered as SUBLINK numbers them, in the order of
+  // their first edges
   map<unsigned, unsigned> root_comp;
   unsigned t = 0;
   for (unsigned i = 1; i <= kd.num_edges (); i ++)
     {
-      if (u.find (i) == i)
+      unsigned r = u.find (i);
+      if (! (root_comp % r))
 	{
 	  ++ t;
-	  root_comp.push (i, t);
+	  root_comp.push (r, t);
 	}
     }
   assert (t == m);
@@ -335,7 +266,7 @@ compute_b_lk_weak (knot_diagram &kd)
     for (unsigned j = i + 1; j <= m; j ++)
       {
 	assert (i < j);
-	
+  
 	int lk = 0;
 	for (unsigned x = 1; x <= kd.n_crossings; x ++)
 	  {
@@ -352,54 +283,58 @@ compute_b_lk_weak (knot_diagram &kd)
 	  }
 	assert (is_even (lk));
 	lk /= 2;
-	
+  
 	if (lk == 0)
 	  {
 	    smallbitset ci (m);
 	    ci.push (i);
-	    
+  
 	    smallbitset cj (m);
 	    cj.push (j);
-	    
+  
 	    smallbitset c (m);
 	    c.push (i);
 	    c.push (j);
 	    knot_diagram Lij (SUBLINK, c, kd);
-	    
+  
 	    multivariate_laurentpoly<Z> P_Lij = Kh_poincare_polynomial<Z2> (Lij);
-	    
+  
 	    knot_diagram Li_join_Lj (DISJOINT_UNION,
 				     knot_diagram (SUBLINK, ci, kd),
 				     knot_diagram (SUBLINK, cj, kd));
-	    
+  
 	    multivariate_laurentpoly<Z> P_Li_join_Lj = Kh_poincare_polynomial<Z2> (Li_join_Lj);
-	    
+  
 	    if (P_Lij != P_Li_join_Lj)
 	      lk = 2;  // non-split
 	  }
-	
+  
 	b_lk_weak += abs (lk);
       }
   
   return b_lk_weak == 0 ? 2 : b_lk_weak;
 }
 
-void
+// the result line for desc: the lower bounds b (from the splitting
+// spectral sequences over Q and Z2(x)) and b_lk_weak, the upper bound
+// from crossing changes, and the bounds on the splitting number sp
+std::string
 compute_splitting_bounds (const knot_desc &desc)
 {
   typedef fraction_field<polynomial<Z2> > Z2x;
   
-  int rank = self_rank ();
-  
-  knot_diagram kd = desc.diagram ();
+  // bQ and bZ2x weight the components in the order of their edges:
+  // compute on the canonical numbering, under which the value is
+  // stored, so that it depends on the link alone
+  knot_diagram kd (CANONICAL, desc.diagram ());
   unsigned m = kd.num_components ();
   assert (m > 1);
   
-  printf ("[% 2d] ", rank); show (kd); newline ();
-  printf ("[% 2d]  m = %d\n", rank, m);
+  std::string value;
+  if (invariant_store::find (kd, "splitting bounds", value))
+    return value;
   
   unsigned total_lk = kd.total_linking_number ();
-  printf ("[% 2d] total_lk = %d\n", rank, total_lk);
   
   unionfind<1> u (kd.num_edges ());
   
@@ -441,45 +376,34 @@ compute_splitting_bounds (const knot_desc &desc)
   if ((total_lk & 1) != (b & 1))
     b ++;
   
-  printf ("[% 2d] bQ = %d\n", rank, bQ);
-  printf ("[% 2d] bZ2x = %d\n", rank, bZ2x);
-  printf ("[% 2d] b = %d\n", rank, b);
-  
   unsigned b_lk_weaker = total_lk == 0 ? 2 : total_lk; // kd is non-split
   
   unsigned b_lk_weak = compute_b_lk_weak (kd);
   assert (b_lk_weaker <= b_lk_weak);
   
-  printf ("[% 2d] b_lk_weaker = %d\n", rank, b_lk_weaker);
-  printf ("[% 2d] b_lk_weak = %d\n", rank, b_lk_weak);
-  
-  if (b_lk_weaker < b_lk_weak)
-    printf ("[% 2d] > STRICTLY WEAKER\n", rank);
-  
   basedvector<basedvector<unsigned, 1>, 1> ps = permutations (m);
   unsigned upper = kd.n_crossings;
   for (unsigned i = 1; i <= ps.size (); i ++)
     {
       basedvector<unsigned, 1> p = ps[i];
-	    
+  
       unsigned ri = 0;
       for (unsigned j = 1; j <= kd.n_crossings; j ++)
 	{
 	  unsigned upper_e = kd.ept_edge (kd.crossings[j][2]),
 	    lower_e = kd.ept_edge (kd.crossings[j][1]);
-		
+  
 	  unsigned upper_c = root_comp(u.find (upper_e)),
 	    lower_c = root_comp(u.find (lower_e));
-		
+  
 	  if (upper_c != lower_c
 	      && p[upper_c] < p[lower_c])
 	    ri ++;
 	}
-	    
+  
       if (ri < upper)
 	upper = ri;
     }
-  printf ("[% 2d] upper = %d\n", rank, upper);
   
   assert (b_lk_weak <= upper);
   assert (b <= upper);
@@ -487,68 +411,360 @@ compute_splitting_bounds (const knot_desc &desc)
   // non-trivial link, sp at least 1.
   unsigned best = std::max (b, b_lk_weak);
   
+  char buf[1000];
+  sprintf (buf, "m=%d\ttotal_lk=%d\tbQ=%d\tbZ2x=%d\tb=%d\tb_lk_weaker=%d\tb_lk_weak=%d\tupper=%d\t",
+	   m, total_lk, bQ, bZ2x, b, b_lk_weaker, b_lk_weak, upper);
+  value = buf;
   if (best == upper)
-    printf ("[% 2d] > sp = %d", rank, upper);
+    sprintf (buf, "sp=%d", upper);
   else
-    printf ("[% 2d] > %d <= sp <= %d", rank, best, upper);
-  
-  printf (" ");
+    sprintf (buf, "sp=%d..%d", best, upper);
+  value += buf;
   
   if (b == best
       && b_lk_weak == best)
-    printf ("(b + b_lk_weak)");
+    value += " (b + b_lk_weak)";
   else if (b == best)
-    printf ("(b)");
+    value += " (b)";
   else
     {
       assert (b_lk_weak == best);
-      printf ("(b_lk_weak)");
+      value += " (b_lk_weak)";
     }
-  fflush (stdout);
   
-  char buf[1000];
-  assert (desc.t == knot_desc::MT);
-  sprintf (buf, "splitting/L%d_%d.dat.gz\n", desc.i, desc.j);
-  
-  {
-    gzfile_reader r (buf);
-    write (r, desc);
-    write (r, bQ);
-    write (r, bZ2x);
-    write (r, b);
-    write (r, b_lk_weak);
-    write (r, upper);
-  }
+  invariant_store::save (kd, "splitting bounds", value);
+  return value;
+}
+
+static std::string
+desc_line (const knot_desc &desc)
+{
+  char buf[100];
+  sprintf (buf, "%d %d %d\n", (int)desc.t, desc.i, desc.j);
+  return buf;
 }
 
+// the lines of a message, the first naming it
+static std::vector<std::string>
+message_lines (const std::string &m)
+{
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start < m.size ())
+    {
+      size_t end = m.find ('\n', start);
+      if (end == std::string::npos)
+	end = m.size ();
+      lines.push_back (m.substr (start, end - start));
+      start = end + 1;
+    }
+  return lines;
+}
+
+static knot_desc
+parse_desc (const std::string &line)
+{
+  int t;
+  unsigned i, j;
+  if (sscanf (line.c_str (), "%d %u %u", &t, &i, &j) != 3)
+    {
+      fprintf (stderr, "error: [% 2d] bad message line `%s'\n",
+	       self_rank (), line.c_str ());
+      exit (EXIT_FAILURE);
+    }
+  return knot_desc ((knot_desc::table)t, i, j);
+}
+
+class job
+{
+ public:
+  knot_desc desc;
+  double cost;
+  
+ public:
+  job () : cost(0) { }
+  job (const knot_desc &desc_, double cost_) : desc(desc_), cost(cost_) { }
+  
+  bool operator < (const job &j) const { return cost > j.cost; }
+};
+
+// estimated seconds to compute desc, from the shape of its cube
+static double
+expected_cost (const knot_desc &desc)
+{
+  return cost_model::standard ().estimate (desc.diagram (), "splitting bounds", "Q", 0).seconds;
+}
+
+class worker_state
+{
+ public:
+  // sizes of the batches sent and not yet finished, oldest first
+  std::deque<unsigned> batches;
+  unsigned pending;
+  
+ public:
+  worker_state () : pending(0) { }
+  
+  // k links returned, from the front or, stolen, the back
+  void finished (unsigned k, bool back);
+};
+
 void
-slave ()
+worker_state::finished (unsigned k, bool back)
+{
+  assert (k <= pending);
+  pending -= k;
+  while (k > 0)
+    {
+      unsigned &n = back ? batches.back () : batches.front ();
+      unsigned k2 = std::min (k, n);
+      n -= k2;
+      k -= k2;
+      if (n == 0)
+	{
+	  if (back)
+	    batches.pop_back ();
+	  else
+	    batches.pop_front ();
+	}
+    }
+}
+
+class scheduler
 {
-  int rank = self_rank ();
+  std::deque<job> queue;
+  double queue_cost;
+  
+  int ntasks;
+  std::vector<worker_state> workers;
+  int steal_victim;
+  
+  FILE *fp;
+  
+  void send_batch (int rank);
+  void fill ();
+  void steal ();
+  
+ public:
+  scheduler (const std::vector<job> &work, FILE *fp_);
+  scheduler (const scheduler &) = delete;
+  ~scheduler () { }
+  
+  scheduler &operator = (const scheduler &) = delete;
+  
+  void run ();
+};
+
+scheduler::scheduler (const std::vector<job> &work, FILE *fp_)
+  : queue(work.begin (), work.end ()),
+    queue_cost(0),
+    ntasks(num_tasks ()),
+    workers(ntasks),
+    steal_victim(0),
+    fp(fp_)
+{
+  std::stable_sort (queue.begin (), queue.end ());
+  for (unsigned i = 0; i < queue.size (); i ++)
+    queue_cost += queue[i].cost;
+}
+
+void
+scheduler::send_batch (int rank)
+{
+  if (queue.empty ())
+    return;
+  
+  // a quarter of each worker's share of the work left
+  double target = queue_cost / (4 * (ntasks - 1));
+  
+  std::string m = "batch\n";
+  unsigned n = 0;
+  double cost = 0;
+  while (!queue.empty ()
+	 && (n == 0 || cost + queue.front ().cost <= target))
+    {
+      const job &j = queue.front ();
+      m += desc_line (j.desc);
+      n ++;
+      cost += j.cost;
+      queue_cost -= j.cost;
+      queue.pop_front ();
+    }
+  if (queue.empty ())
+    queue_cost = 0;
+  
+  send_string (m, rank);
+  workers[rank].batches.push_back (n);
+  workers[rank].pending += n;
+}
+
+void
+scheduler::fill ()
+{
+  // two rounds, so the biggest links go to different workers
+  for (unsigned k = 1; k <= 2; k ++)
+    for (int rank = 1; rank < ntasks; rank ++)
+      {
+	if (workers[rank].batches.size () < k)
+	  send_batch (rank);
+      }
+}
+
+void
+scheduler::steal ()
+{
+  if (!queue.empty () || steal_victim)
+    return;
+  
+  int idle = 0;
+  for (int rank = 1; rank < ntasks && !idle; rank ++)
+    {
+      if (workers[rank].pending == 0)
+	idle = rank;
+    }
+  if (!idle)
+    return;
+  
+  // one link in progress and at least two waiting
+  int victim = 0;
+  for (int rank = 1; rank < ntasks; rank ++)
+    {
+      if (workers[rank].pending >= 3
+	  && (!victim || workers[rank].pending > workers[victim].pending))
+	victim = rank;
+    }
+  if (!victim)
+    return;
+  
+  send_string ("steal\n", victim);
+  steal_victim = victim;
+}
+
+void
+scheduler::run ()
+{
+  fill ();
   
   for (;;)
     {
-      int cmd = recv_int ();
-      switch (cmd)
+      steal ();
+  
+      bool done = queue.empty () && !steal_victim;
+      for (int rank = 1; rank < ntasks && done; rank ++)
 	{
-	case CMD_DO:
-	  {
-	    knot_desc desc;
-	    desc.t = (knot_desc::table)recv_int ();
-	    desc.i = (unsigned)recv_int ();
-	    desc.j = (unsigned)recv_int ();
-	    
-	    printf ("[% 2d] CMD_DO %s\n", rank, desc.name ().c_str ());
-	    
-	    compute_splitting_bounds (desc);
-	    
-	    send_int (0, 0);
-	  }
-	  break;
-	  
-	case CMD_DIE:
-	  return;
+	  if (workers[rank].pending > 0)
+	    done = 0;
+	}
+      if (done)
+	break;
+  
+      int rank;
+      std::vector<std::string> lines = message_lines (recv_string (&rank));
+      assert (between (1, rank, ntasks - 1));
+      if (lines.size () == 3 && lines[0] == "result")
+	{
+	  knot_desc desc = parse_desc (lines[1]);
+	  fprintf (fp, "%s\t%s\n", desc.name ().c_str (), lines[2].c_str ());
+	  fflush (fp);
+  
+	  workers[rank].finished (1, 0);
+	  if (workers[rank].batches.size () < 2)
+	    send_batch (rank);
+	}
+      else if (lines.size () >= 1 && lines[0] == "stolen")
+	{
+	  assert (rank == steal_victim);
+	  steal_victim = 0;
+  
+	  workers[rank].finished (lines.size () - 1, 1);
+	  for (unsigned i = 1; i < lines.size (); i ++)
+	    {
+	      knot_desc desc = parse_desc (lines[i]);
+	      double cost = expected_cost (desc);
+	      queue.push_back (job (desc, cost));
+	      queue_cost += cost;
+	    }
+	  fill ();
+	}
+      else
+	{
+	  fprintf (stderr, "error: bad message from rank %d\n", rank);
+	  exit (EXIT_FAILURE);
+	}
+    }
+  
+  for (int rank = 1; rank < ntasks; rank ++)
+    send_string ("exit\n", rank);
+}
+
+void
+master ()
+{
+  std::vector<job> work;
+  for (unsigned i = 1; i <= max_n; i ++)
+    for (unsigned j = 1; j <= mt_links (i); j ++)
+      {
+	knot_desc desc (knot_desc::MT, i, j);
+	if (desc.diagram ().num_components () < 2)
+	  continue;
+  
+	work.push_back (job (desc, expected_cost (desc)));
+      }
+  
+  FILE *fp = stdout;
+  if (out_file)
+    fp = open_file (out_file, "w");
+  
+  fprintf (stderr, "ntasks = %d, %d links\n", num_tasks (), (int)work.size ());
+  
+  scheduler s (work, fp);
+  s.run ();
+  
+  if (out_file)
+    close_file (fp);
+}
+
+void
+worker ()
+{
+  std::deque<knot_desc> queue;
+  
+  for (;;)
+    {
+      // take new batches and steal requests between links
+      while (queue.empty () || message_waiting ())
+	{
+	  std::vector<std::string> lines = message_lines (recv_string ());
+	  if (lines.size () >= 1 && lines[0] == "batch")
+	    {
+	      for (unsigned i = 1; i < lines.size (); i ++)
+		queue.push_back (parse_desc (lines[i]));
+	    }
+	  else if (lines.size () == 1 && lines[0] == "steal")
+	    {
+	      std::string m = "stolen\n";
+	      unsigned k = queue.size () / 2;
+	      for (unsigned i = queue.size () - k; i < queue.size (); i ++)
+		m += desc_line (queue[i]);
+	      queue.resize (queue.size () - k);
+	      send_string (m, 0);
+	    }
+	  else if (lines.size () == 1 && lines[0] == "exit")
+	    return;
+	  else
+	    {
+	      fprintf (stderr, "error: [% 2d] bad message from rank 0\n", self_rank ());
+	      exit (EXIT_FAILURE);
+	    }
 	}
+  
+      knot_desc desc = queue.front ();
+      queue.pop_front ();
+  
+      send_string ("result\n"
+		   + desc_line (desc)
+		   + compute_splitting_bounds (desc) + "\n",
+		   0);
     }
 }
 
@@ -557,21 +773,57 @@ main (int argc, char **argv)
 {
   comm_init (&argc, &argv);
   
-  int rank = self_rank (),
-    ntasks = num_tasks ();
-  
-  printf ("[% 2d] alive\n", rank);
-  fflush (stdout);
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i ++)
+    {
+      if (!strcmp (argv[i], "-h"))
+	{
+	  if (self_rank () == 0)
+	    usage ();
+	  comm_finalize ();
+	  exit (EXIT_SUCCESS);
+	}
+      else if (!strcmp (argv[i], "-o")
+	       || !strcmp (argv[i], "-store"))
+	{
+	  if (i + 1 == argc)
+	    {
+	      fprintf (stderr, "error: missing argument to option `%s'\n", argv[i]);
+	      exit (EXIT_FAILURE);
+	    }
+	  if (!strcmp (argv[i], "-o"))
+	    out_file = argv[i + 1];
+	  else
+	    store_dir = argv[i + 1];
+	  i ++;
+	}
+      else
+	{
+	  fprintf (stderr, "error: unknown argument `%s'\n", argv[i]);
+	  fprintf (stderr, "  use -h for usage\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
+  if (i < argc)
+    {
+      max_n = atoi (argv[i]);
+      if (max_n < 1 || max_n > 14 || i + 1 < argc)
+	{
+	  fprintf (stderr, "error: expected <n> between 1 and 14\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
   
-  if (rank == 0)
+  if (num_tasks () < 2)
     {
-      printf ("ntasks = %d\n", ntasks);
-      fflush (stdout);
-      
-      master ();
+      fprintf (stderr, "error: mpimain needs at least two tasks\n");
+      exit (EXIT_FAILURE);
     }
+  
+  if (self_rank () == 0)
+    master ();
   else
-    slave ();
+    worker ();
   
   comm_finalize ();
   return 0;
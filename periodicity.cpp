@@ -3,13 +3,17 @@
 #include <algorithm>
 #include <utility>
 #include <fstream>
+#include <thread>
+#include <atomic>
 
 std::string periodicity_test = "Przytycki"; 
 int period = 5;
+// threads for Kh_periodicity_grid, 0 for one per core
+unsigned periodicity_threads = 0;
 
-extern multivariate_laurentpoly<Z> compute_jones(const knot_diagram& k, bool reduced = false);
+periodicity_stats periodicity_counts;
 
-using polynomial_tuple = std::vector<std::tuple<multivariate_laurentpoly<Z>, multivariate_laurentpoly<Z>, multivariate_laurentpoly<Z>>>;
+using polynomial_tuple = std::vector<std::tuple<bivariate_laurentpoly, bivariate_laurentpoly, bivariate_laurentpoly>>;
 
 using bounds_vector = std::map<multivariate_laurentpoly<Z>, std::pair<Z, Z>>;
 
@@ -50,46 +54,251 @@ std::string Przytycki_periodicity_checker::operator () (int period) const {
   return res.str();
 }
 
-bool Kh_bounds_iterator::advance() {
-  if(level == bv.end())
-    return false;
-  for(auto bv_it = bv.begin(); bv_it != level; ++bv_it) {
-    if(current_state[bv_it->first] < (bv_it->second).second) {
-      current_state[bv_it->first] += period;
-      for(auto bv_it_2 = bv.begin(); bv_it_2 != bv_it; ++bv_it_2) {
-	current_state[bv_it_2->first] = bv_it_2->second.first;
+std::ostream& operator << (std::ostream& os, const periodicity_stats& st) {
+  return os << st.candidates << " candidates: "
+	    << st.murasugi_rejected << " rejected by Murasugi's criterion, "
+	    << st.przytycki_rejected << " by Przytycki's criterion, "
+	    << st.kh_rejected << " by the Kh criterion; "
+	    << st.survivors << " left";
+}
+
+Murasugi_periodicity_checker::Murasugi_periodicity_checker(const polynomial& a, std::string knot_n) :
+  knot_name(knot_n) {
+  int low = 0, high = 0;
+  bool first = true;
+  for(map<multivariate_laurent_monomial, Z>::const_iter i = a.coeffs; i; i++) {
+    int e = i.key().m(1, 0);
+    if(first || e < low)
+      low = e;
+    if(first || e > high)
+      high = e;
+    first = false;
+  }
+  alex.assign(first ? 0 : high - low + 1, Z(0));
+  for(map<multivariate_laurent_monomial, Z>::const_iter i = a.coeffs; i; i++)
+    alex[i.key().m(1, 0) - low] = i.val();
+}
+
+bool Murasugi_periodicity_checker::check(int period) const {
+  int64 p = period;
+  std::vector<int64> a;
+  for(auto& c : alex)
+    a.push_back((c % (unsigned)period).get_si());
+  // the criterion holds up to units +-t^k, so drop the zeros mod p
+  // at both ends
+  while(!a.empty() && a.back() == 0)
+    a.pop_back();
+  // Delta(1) = 1, so this only happens for a zero polynomial
+  if(a.empty())
+    return true;
+  unsigned lead = 0;
+  while(a[lead] == 0)
+    lead++;
+  a.erase(a.begin(), a.begin() + lead);
+  unsigned n = a.size() - 1;
+  
+  for(unsigned l = 1; (p - 1) * (l - 1) <= n; l++) {
+    if(l % p == 0)
+      continue;
+  
+    // f = (1 + t + ... + t^(l-1))^(p-1) mod p, monic
+    std::vector<int64> f(1, 1);
+    for(int k = 0; k < p - 1; k++) {
+      std::vector<int64> g(f.size() + l - 1, 0);
+      for(unsigned i = 0; i < f.size(); i++)
+	for(unsigned j = 0; j < l; j++)
+	  g[i + j] = (g[i + j] + f[i]) % p;
+      f.swap(g);
+    }
+  
+    // a = f * q mod p, with every exponent of q divisible by p
+    std::vector<int64> r = a;
+    unsigned m = f.size() - 1;
+    bool ok = true;
+    for(unsigned i = n + 1; i-- > m;) {
+      int64 c = r[i];
+      if(c == 0)
+	continue;
+      if((i - m) % p != 0) {
+	ok = false;
+	break;
       }
+      for(unsigned j = 0; j <= m; j++)
+	r[i - m + j] = ((r[i - m + j] - c * f[j]) % p + p) % p;
+    }
+    for(unsigned i = 0; ok && i < m; i++)
+      if(r[i] != 0)
+	ok = false;
+    if(ok)
       return true;
+  }
+  return false;
+}
+
+std::string Murasugi_periodicity_checker::operator () (int period) const {
+  std::ostringstream res;
+  res << knot_name << ": period = " << period << ": "
+      << (check(period) ? "Maybe" : "No");
+  return res.str();
+}
+
+static int64 div_floor(int64 a, int64 b) {
+  int64 q = a / b;
+  if((a % b != 0) && ((a < 0) != (b < 0)))
+    q--;
+  return q;
+}
+
+static int64 div_ceil(int64 a, int64 b) {
+  return -div_floor(-a, b);
+}
+
+Kh_bounds_solver::Kh_bounds_solver(const bounds_vector& bv, int p) :
+  period(p), n_states(0) {
+  std::vector<polynomial> polys;
+  std::vector<std::vector<std::pair<unsigned, int64>>> cs;
+  std::vector<int64> l, h;
+  for(auto& b : bv) {
+    if(b.first == 0)
+      continue;
+    polys.push_back(b.first);
+    l.push_back(b.second.first.get_si() / period);
+    h.push_back(b.second.second.get_si() / period);
+    std::vector<std::pair<unsigned, int64>> c;
+    for(map<monomial, Z>::const_iter i = b.first.coeffs; i; i++) {
+      auto j = basis.find(i.key());
+      if(j == basis.end())
+	j = basis.emplace(i.key(), (unsigned)basis.size()).first;
+      c.push_back(std::make_pair(j->second, (int64)i.val().get_si()));
     }
+    cs.push_back(c);
   }
-  if(current_state[level->first] < bv[level->first].second) {
-    current_state[level->first] += period;
-    for(auto bv_it = bv.begin(); bv_it != level; ++bv_it) {
-      current_state[bv_it->first] = bv_it->second.first;
+  
+  // greedy order: open few new coordinates, close many
+  unsigned m = polys.size(), dim = basis.size();
+  std::vector<unsigned> uses(dim, 0);
+  for(auto& c : cs)
+    for(auto& cv : c)
+      uses[cv.first]++;
+  std::vector<bool> opened(dim, false), taken(m, false);
+  std::vector<unsigned> first(dim, 0), last(dim, 0);
+  for(unsigned k = 0; k < m; k++) {
+    unsigned best = m;
+    int best_score = 0;
+    for(unsigned j = 0; j < m; j++) {
+      if(taken[j])
+	continue;
+      int score = 0;
+      for(auto& cv : cs[j])
+	score += (opened[cv.first] ? 0 : 1) - (uses[cv.first] == 1 ? 1 : 0);
+      if(best == m || score < best_score) {
+	best = j;
+	best_score = score;
+      }
     }
-    return true;
+    taken[best] = true;
+    for(auto& cv : cs[best]) {
+      if(!opened[cv.first])
+	first[cv.first] = k;
+      opened[cv.first] = true;
+      uses[cv.first]--;
+      last[cv.first] = k;
+    }
+    gens.push_back(polys[best]);
+    coords.push_back(cs[best]);
+    lo.push_back(l[best]);
+    hi.push_back(h[best]);
   }
-  ++level;
-  if(level == bv.end())
+  
+  open.resize(m + 1);
+  for(unsigned k = 0; k <= m; k++)
+    for(unsigned c = 0; c < dim; c++)
+      if(first[c] < k && last[c] >= k)
+	open[k].push_back(c);
+  
+  suffix_min.assign(m + 1, std::vector<int64>(dim, 0));
+  suffix_max.assign(m + 1, std::vector<int64>(dim, 0));
+  for(unsigned k = m; k-- > 0;) {
+    suffix_min[k] = suffix_min[k + 1];
+    suffix_max[k] = suffix_max[k + 1];
+    for(auto& cv : coords[k]) {
+      int64 a = lo[k] * cv.second, b = hi[k] * cv.second;
+      suffix_min[k][cv.first] += std::min(a, b);
+      suffix_max[k][cv.first] += std::max(a, b);
+    }
+  }
+}
+
+bool Kh_bounds_solver::search(unsigned k) {
+  if(k == gens.size())
+    return true;
+  n_states++;
+  
+  state key;
+  for(auto c : open[k])
+    key.push_back(partial[c]);
+  if(dead[k].count(key))
     return false;
-  current_state[level->first] += period;
-  for(auto bv_it = bv.begin(); bv_it != level; ++bv_it) {
-    current_state[bv_it->first] = bv_it->second.first;
+  
+  // c_k / period such that every coordinate of P_k can still be
+  // completed by the polynomials after it
+  int64 ylo = lo[k], yhi = hi[k];
+  for(auto& cv : coords[k]) {
+    unsigned c = cv.first;
+    int64 v = cv.second;
+    int64 a = target[c] - partial[c] - suffix_max[k + 1][c],
+      b = target[c] - partial[c] - suffix_min[k + 1][c];
+    if(v > 0) {
+      ylo = std::max(ylo, div_ceil(a, v));
+      yhi = std::min(yhi, div_floor(b, v));
+    }
+    else {
+      ylo = std::max(ylo, div_ceil(b, v));
+      yhi = std::min(yhi, div_floor(a, v));
+    }
   }
   
-  return true;
+  for(int64 y = ylo; y <= yhi; y++) {
+    for(auto& cv : coords[k])
+      partial[cv.first] += y * cv.second;
+    choice[k] = y;
+    bool found = search(k + 1);
+    for(auto& cv : coords[k])
+      partial[cv.first] -= y * cv.second;
+    if(found)
+      return true;
+  }
+  
+  dead[k].insert(key);
+  return false;
 }
 
-multivariate_laurentpoly<Z> Kh_bounds_iterator::get_polynomial() const {
-  polynomial p;
-  for(auto& cs : current_state) {
-    p += cs.second * cs.first;
+bool Kh_bounds_solver::solve(const polynomial& s) {
+  target.assign(basis.size(), 0);
+  for(map<monomial, Z>::const_iter i = s.coeffs; i; i++) {
+    int64 c = i.val().get_si();
+    auto j = basis.find(i.key());
+    if(c % period != 0 || j == basis.end())
+      return false;
+    target[j->second] = c / period;
   }
-  return p;
+  
+  partial.assign(basis.size(), 0);
+  choice.assign(gens.size(), 0);
+  dead.assign(gens.size() + 1, std::unordered_set<state, state_hash>());
+  n_states = 0;
+  return search(0);
+}
+
+std::map<multivariate_laurentpoly<Z>, Z> Kh_bounds_solver::witness() const {
+  std::map<polynomial, Z> w;
+  for(unsigned k = 0; k < gens.size(); k++)
+    w.emplace(gens[k], Z(mpz_class((long)(choice[k] * period))));
+  return w;
 }
 
 template<>
-std::vector<multivariate_laurentpoly<Z>>
+std::vector<bivariate_laurentpoly>
 Kh_periodicity_checker::compute_knot_polynomials<Z2>(knot_diagram& kd) {
   unsigned m = kd.num_components ();
   if (m != 1) {
@@ -114,9 +323,9 @@ Kh_periodicity_checker::compute_knot_polynomials<Z2>(knot_diagram& kd) {
     chain_complex_simplifier<Z2> s(C, d, maybe<int>(1), maybe<int>(2*k));
     C = s.new_C;
     d = s.new_d;
-    lee_ss_polynomials.push_back(C->free_poincare_polynomial());
+    lee_ss_polynomials.push_back(C->free_poincare_bivariate());
     if(k != 0)
-      mul.push_back(polynomial(Z(1)) + polynomial(Z(1), VARIABLE, 1, 1) * polynomial(Z(1), VARIABLE, 2, 2 * k));
+      mul.push_back(polynomial(1) + polynomial(1, 1, 2 * k));
     if(d == 0)
       break;
     k++;
@@ -133,7 +342,7 @@ Kh_periodicity_checker::compute_knot_polynomials<Z2>(knot_diagram& kd) {
 }
 
 template<typename R>
-std::vector<multivariate_laurentpoly<Z>>
+std::vector<bivariate_laurentpoly>
 Kh_periodicity_checker::compute_knot_polynomials(knot_diagram& kd) {
   unsigned m = kd.num_components ();
   if (m != 1) {
@@ -159,9 +368,9 @@ Kh_periodicity_checker::compute_knot_polynomials(knot_diagram& kd) {
     C = s.new_C;
     d = s.new_d;
     if(k % 2 == 0) {
-      lee_ss_polynomials.push_back(C->free_poincare_polynomial());
+      lee_ss_polynomials.push_back(C->free_poincare_bivariate());
       if(k != 0)
-	mul.push_back(polynomial(Z(1)) + polynomial(Z(1), VARIABLE, 1, 1) * polynomial(Z(1), VARIABLE, 2, 2 * k));
+	mul.push_back(polynomial(1) + polynomial(1, 1, 2 * k));
     }
     if(d == 0)
       break;
@@ -183,16 +392,12 @@ Kh_periodicity_checker::Kh_periodicity_checker(knot_diagram& kd,
 					       std::string knot_n,
 					       std::string f = "Z2") :
   knot_name(knot_n), field(f) {
-  ev_index = 1;
-  index = 2;
-  quot = std::vector<polynomial>();
-  mul = std::vector<polynomial>();
   if(field == "Z2")
     compute_quot(compute_knot_polynomials<Z2>(kd));
   else if(field == "Z3")
     compute_quot(compute_knot_polynomials<Zp<3>>(kd));
   else if(field == "Z5")
-    compute_quot(compute_knot_polynomials<Zp<3>>(kd));
+    compute_quot(compute_knot_polynomials<Zp<5>>(kd));
   else if(field == "Z7")
     compute_quot(compute_knot_polynomials<Zp<7>>(kd));
   else if(field == "Z11")
@@ -205,31 +410,28 @@ Kh_periodicity_checker::Kh_periodicity_checker(knot_diagram& kd,
   }
 }
 
+// the differences of consecutive pages, divided by the 1 + t q^2k of
+// the differential cancelling them
 void Kh_periodicity_checker::compute_quot(const std::vector<polynomial>& lee_ss_polynomials) {
   for(unsigned i = 1; i < lee_ss_polynomials.size(); ++i) {
     polynomial diff = lee_ss_polynomials[i-1] - lee_ss_polynomials[i];
-    polynomial q = 0;
-    while(diff != 0) {
-      pair<monomial, Z> m = diff.head();
-      if(m.first.m[1] == 1) {
-    	pair<monomial, Z> m1 = diff.tail();
-    	while(m1.first.m.card() == 1 && m1.first.m[2]) {
-    	  q += polynomial(m1.second, m1.first);
-    	  polynomial p = polynomial(m1.second, m1.first) * mul[i-1];
-    	  diff -= p;
-    	  if(diff != 0)
-    	    m1 = diff.tail();
-    	  else break;
-    	}
-    	if(diff != 0)
-    	  m = diff.head();
-    	else
-    	  break;
-      }
-      q += polynomial(m.second, m.first);
-      polynomial p = polynomial(m.second, m.first) * mul[i-1];
-      diff -= p;
+    diff.trim();
+    // the q exponent of t in mul[i-1]
+    int shift = mul[i-1].qlow + mul[i-1].qwidth - 1;
+    polynomial q;
+    if(diff.twidth > 1) {
+      // row k of q is row k of diff less row k - 1 of q shifted by t q^shift
+      q.extend(diff.tlow, diff.tlow + diff.twidth - 2,
+	       diff.qlow, diff.qlow + diff.qwidth - 1);
+      for(unsigned k = 0; k + 1 < diff.twidth; k++)
+	for(unsigned j = 0; j < diff.qwidth; j++) {
+	  int64 x = diff.c[k * diff.qwidth + j];
+	  if(k > 0)
+	    x -= q.coeff(q.tlow + k - 1, diff.qlow + (int)j - shift);
+	  q.c[k * q.qwidth + j] = x;
+	}
     }
+    assert(q * mul[i-1] == diff);
     quot.push_back(q);
   }
 }
@@ -238,13 +440,12 @@ polynomial_tuple
 Kh_periodicity_checker::compute_quotient_and_remainder(const std::vector<polynomial>& quot, int period) const {
   polynomial_tuple decomposed_khp;
   for(unsigned i = 0; i < quot.size(); ++i) {
-    polynomial quotient, remainder;
-    for(map<monomial, Z>::const_iter j = quot[i].coeffs; j; j++) {
-      std::tuple<Z,Z> div = j.val().divide_with_remainder(period - 1);
-      quotient += polynomial(std::get<0>(div), j.key());
-      remainder += polynomial(std::get<1>(div), j.key());
+    polynomial quotient = quot[i], remainder = quot[i];
+    for(unsigned j = 0; j < quot[i].c.size(); j++) {
+      quotient.c[j] = quot[i].c[j] / (period - 1);
+      remainder.c[j] = quot[i].c[j] % (period - 1);
     }
-    decomposed_khp.push_back(std::make_tuple(quotient, remainder, std::move(mul[i])));
+    decomposed_khp.push_back(std::make_tuple(quotient, remainder, mul[i]));
   }
   if(verbose) {
     std::cerr << "Decomposition of Khp = " << std::endl
@@ -266,51 +467,33 @@ Kh_periodicity_checker::compute_quotient_and_remainder(const std::vector<polynom
 
 bounds_vector
 Kh_periodicity_checker::compute_bounds(const polynomial_tuple& p_tuple, int period) const {
-  periodic_congruence_checker<Z> pcc(period);
   bounds_vector bounds_v;
   for(auto& p: p_tuple) {
     polynomial quotient, remainder, mul;
     tie(quotient, remainder, mul) = p;
-    for(map<monomial, Z>::const_iter i = quotient.coeffs; i; ++i) {
-      monomial mon;
-      int exp = 0;
-      if(i.key().m % ev_index) {
-	exp = i.key().m[ev_index];
-	for(map<unsigned, int>::const_iter j = i.key().m; j; ++j) {
-	  if(j.key() != ev_index) {
-	    int v = j.val() % (2 * period);
-	    if(v < 0) v += (2 * period);
-	    mon *= monomial(VARIABLE, j.key(), v);
-	  }
+    for(unsigned i = 0; i < quotient.twidth; i++)
+      for(unsigned j = 0; j < quotient.qwidth; j++) {
+	int64 x = quotient.c[i * quotient.qwidth + j];
+	if(x == 0)
+	  continue;
+	int exp = quotient.tlow + (int)i;
+	int v = (quotient.qlow + (int)j) % (2 * period);
+	if(v < 0) v += (2 * period);
+	Z v_temp = Z(mpz_class((long)(exp % 2 ? -x : x)));
+	polynomial p_q = (polynomial(1, 0, v) * mul).evaluate_t(-1);
+	multivariate_laurentpoly<Z> p_temp =
+	  (p_q - p_q.invert_q()).fold_q(2 * period).multivariate();
+	if(bounds_v.count(p_temp)) {
+	  if(v_temp >= 0)
+	    bounds_v[p_temp].second += (v_temp * period);
+	  else
+	    bounds_v[p_temp].first += (v_temp * period);
 	}
-      }
-      else {
-	for(map<unsigned, int>::const_iter j = i.key().m; j; ++j) {
-	  int v = j.val() % (2 * period);
-	  if(v < 0) v += (2 * period);
-	  mon *= monomial(VARIABLE, j.key(), v);
+	else {
+	  bounds_v.emplace(p_temp,
+			   std::make_pair<Z,Z>((v_temp < 0 ? (v_temp * period) : Z(0)), (v_temp >= 0 ? (v_temp * period) : Z(0))));
 	}
       }
-      Z v_temp = i.val() * pow(-1, exp);
-      polynomial p_temp = (polynomial(1, mon) * mul).evaluate(-1, ev_index);
-      p_temp = pcc.reduce(p_temp - invert_variable(p_temp, index));
-      if(bounds_v.count(p_temp)) {
-	if(v_temp >= 0)
-	  bounds_v[p_temp].second += (v_temp * period);
-	else
-	  bounds_v[p_temp].first += (v_temp * period);
-      }
-      else if(bounds_v.count(p_temp)) {
-	if(v_temp >= 0)
-	  bounds_v[p_temp].first -= (v_temp * period);
-	else
-	  bounds_v[p_temp].second -= (v_temp * period);
-      }
-      else {
-	bounds_v.emplace(p_temp,
-			 std::make_pair<Z,Z>((v_temp < 0 ? (v_temp * period) : Z(0)), (v_temp >= 0 ? (v_temp * period) : Z(0))));
-      }
-    }
   }
   
   if(verbose) {
@@ -327,17 +510,16 @@ Kh_periodicity_checker::compute_bounds(const polynomial_tuple& p_tuple, int peri
 Kh_periodicity_checker::Test_Result
 Kh_periodicity_checker::check(const polynomial_tuple& polynomials,
 				   int period) const {
-  periodic_congruence_checker<Z> pcc(period);
-  polynomial t = polynomial(COPY, leep);
+  polynomial t = leep;
   for(auto& p : polynomials) {
     polynomial quotient, remainder, mul;
     tie(quotient, remainder, mul) = p;
     t += mul * (remainder - quotient);
     //std::cerr << "t = " << t << "\n";
   }
-  polynomial s = t.evaluate(-1, ev_index);
-  s = pcc.reduce(s - invert_variable(s, index));
-  if(pcc(s)) {
+  polynomial s = t.evaluate_t(-1);
+  s = (s - s.invert_q()).fold_q(2 * period);
+  if((s - s.invert_q()).fold_q(2 * period).is_zero()) {
     return Test_Result::MAYBE;
   }
   else if(all_of(polynomials.begin(), polynomials.end(),
@@ -348,61 +530,174 @@ Kh_periodicity_checker::check(const polynomial_tuple& polynomials,
 
   if(verbose)
     std::cerr << "s = " << s << "\n";
-  Kh_bounds_iterator Kh_b_it(bounds, period);
+  Kh_bounds_solver solver(bounds, period);
+  bool found = solver.solve(s.multivariate());
   if(verbose)
-    std::cerr << "current_state = " << Kh_b_it.get_polynomial() << "\n";
-  if(Kh_b_it.get_polynomial() == s)
+    std::cerr << solver.states() << " states searched\n";
+  if(found) {
+    if(verbose) {
+      std::cerr << "witness: s =";
+      for(auto& w : solver.witness())
+	if(w.second != 0)
+	  std::cerr << " + (" << w.second << ")*(" << w.first << ")";
+      std::cerr << "\n";
+    }
     return Test_Result::MAYBE;
-  while(Kh_b_it.advance()) {
-    if(verbose)
-      std::cerr << "current_state = " << Kh_b_it.get_polynomial() << "\n";
-    if(s == Kh_b_it.get_polynomial())
-      return Test_Result::MAYBE;
   }
   
   return Test_Result::NO_NONTRIVIAL_DECOMP;
 }
 
-std::string Kh_periodicity_checker::operator () (int period) const {
-  std::ostringstream out;
-  if(field == "Z5" && Zp<5>(period) == Zp<5>(0))
+// empty if period is prime to the characteristic of field
+static std::string characteristic_verdict(const std::string& field, int period) {
+  if((field == "Z3" && period % 3 == 0)
+     || (field == "Z5" && period % 5 == 0)
+     || (field == "Z7" && period % 7 == 0)
+     || (field == "Z11" && period % 11 == 0))
     return "Period (" + std::to_string(period)
-		      + ") has to be relatively prime to "
-      + "the characteristic of the field ("
-      + field + ")...";
-  else if(field == "Z7" && Zp<7>(period) == Zp<7>(0))
-        return "Period (" + std::to_string(period)
-		      + ") has to be relatively prime to "
-      + "the characteristic of the field ("
-      + field + ")...";
-  else if(field == "Z11" && Zp<11>(period) == Zp<11>(0))
-        return "Period (" + std::to_string(period)
-		      + ") has to be relatively prime to "
+      + ") has to be relatively prime to "
       + "the characteristic of the field ("
       + field + ")...";
+  return std::string();
+}
+
+std::string Kh_periodicity_checker::verdict(int period) const {
+  std::string v = characteristic_verdict(field, period);
+  if(!v.empty())
+    return v;
   // first check Przytycki's criterion
-  Przytycki_periodicity_checker P_pc(evaluate_with_copy<Z>(khp, -1, ev_index), knot_name);
-  if(!P_pc.check(period)) {
-    out << knot_name << ": period =  " << period << ": No (Przytycki's criterion).";
+  Przytycki_periodicity_checker P_pc(khp.evaluate_t(-1).multivariate(), knot_name);
+  if(!P_pc.check(period))
+    return "No (Przytycki's criterion)";
+  auto q_r = compute_quotient_and_remainder(quot, period);
+  Test_Result res = check(q_r, period);
+  return (res == Test_Result::MAYBE ? "Maybe" :
+	  (res == Test_Result::NO ? "No" : "No (Nontrivial decomposition) ("
+	   + field + ")"));
+}
+
+Kh_periodicity_grid::Kh_periodicity_grid(knot_diagram& kd, std::string knot_n,
+					 const std::vector<std::string>& fields_,
+					 const std::vector<int>& periods_,
+					 bool prefilters) :
+  knot_name(knot_n), fields(fields_), periods(periods_),
+  prefilter(periods_.size()) {
+  periodicity_counts.candidates += periods.size();
+  
+  // cheapest first: Murasugi's criterion, for knots
+  if(prefilters && kd.num_components() == 1) {
+    Murasugi_periodicity_checker M_pc(alexander_polynomial(kd), knot_name);
+    for(unsigned p = 0; p < periods.size(); p++)
+      if(!M_pc.check(periods[p])) {
+	prefilter[p] = "No (Murasugi's criterion)";
+	periodicity_counts.murasugi_rejected++;
+      }
   }
-  else {
-    auto q_r = compute_quotient_and_remainder(quot, period);
-    Test_Result res = check(q_r, period);
-    out << knot_name << ": period = " << period << ": "
-  	<< (res == Test_Result::MAYBE ? "Maybe" :
-	    (res == Test_Result::NO ? "No" : "No (Nontrivial decomposition) ("
-	     + field + ")"));
+  
+  // then Przytycki's criterion, from the Jones polynomial alone
+  bool need_kh = !prefilters && !periods.empty();
+  if(prefilters
+     && std::find(prefilter.begin(), prefilter.end(), std::string()) != prefilter.end()) {
+    Przytycki_periodicity_checker P_pc(jones_polynomial(kd), knot_name);
+    for(unsigned p = 0; p < periods.size(); p++) {
+      if(!prefilter[p].empty())
+	continue;
+      if(!P_pc.check(periods[p])) {
+	prefilter[p] = "No (Przytycki's criterion)";
+	periodicity_counts.przytycki_rejected++;
+      }
+      else
+	need_kh = true;
+    }
+  }
+  if(need_kh) {
+    for(auto& f : fields)
+      checkers.push_back(Kh_periodicity_checker(kd, knot_name, f));
+  }
+}
+
+void Kh_periodicity_grid::run(unsigned n_threads) {
+  unsigned n_periods = periods.size();
+  verdicts.assign(fields.size(), std::vector<std::string>(n_periods));
+
+  std::vector<std::pair<unsigned, unsigned>> tasks;
+  for(unsigned f = 0; f < fields.size(); f++)
+    for(unsigned p = 0; p < n_periods; p++) {
+      std::string v = characteristic_verdict(fields[f], periods[p]);
+      if(!v.empty())
+	verdicts[f][p] = v;
+      else if(!prefilter[p].empty())
+	verdicts[f][p] = prefilter[p];
+      else
+	tasks.push_back(std::make_pair(f, p));
+    }
+  unsigned n_tasks = tasks.size();
+  std::vector<std::string> task_verdicts(n_tasks);
+
+  if(n_threads == 0)
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  // keep the verbose traces apart
+  if(verbose)
+    n_threads = 1;
+  n_threads = std::min(n_threads, n_tasks);
+
+  std::atomic<unsigned> next(0);
+  auto worker = [&]() {
+    for(unsigned t; (t = next++) < n_tasks;)
+      task_verdicts[t] = checkers[tasks[t].first].verdict(periods[tasks[t].second]);
+  };
+  std::vector<std::thread> pool;
+  for(unsigned i = 1; i < n_threads; i++)
+    pool.push_back(std::thread(worker));
+  if(n_tasks > 0)
+    worker();
+  for(auto& th : pool)
+    th.join();
+
+  for(unsigned t = 0; t < n_tasks; t++)
+    verdicts[tasks[t].first][tasks[t].second] = task_verdicts[t];
+  
+  // a period survives if some field allows it
+  for(unsigned p = 0; p < n_periods; p++) {
+    if(!prefilter[p].empty())
+      continue;
+    bool maybe = false;
+    for(unsigned f = 0; f < fields.size(); f++)
+      maybe |= (verdicts[f][p] == "Maybe");
+    if(maybe)
+      periodicity_counts.survivors++;
+    else
+      periodicity_counts.kh_rejected++;
+  }
+}
+
+std::string Kh_periodicity_grid::record() const {
+  std::ostringstream out;
+  out << knot_name << ":";
+  for(unsigned f = 0; f < fields.size(); f++) {
+    out << (f ? "; " : " ") << fields[f] << " [";
+    for(unsigned p = 0; p < periods.size(); p++)
+      out << (p ? ", " : "") << periods[p] << ": " << verdicts[f][p];
+    out << "]";
   }
   return out.str();
 }
 
 void check_periodicity(knot_diagram& kd, const std::string knot_name, int period, std::string field) {
+  // field may be a comma-separated list
+  std::vector<std::string> fields;
+  std::istringstream fs(field);
+  for(std::string f; std::getline(fs, f, ',');)
+    if(!f.empty())
+      fields.push_back(f);
+
   if(periodicity_test == "all") {
-    Kh_periodicity_checker Kh_pc(kd, knot_name, field);
-    for(auto& p : primes_list) {
-      std::cout << "Kh criterion: "
-    		<< Kh_pc(p) << std::endl;
-    }
+    std::vector<int> periods(primes_list.begin(), primes_list.end());
+    Kh_periodicity_grid grid(kd, knot_name, fields, periods);
+    grid.run(periodicity_threads);
+    std::cout << grid.record() << std::endl;
+    if(verbose)
+      std::cerr << periodicity_counts << "\n";
   }
   else {
     if(period == 2 || period == 3) {
@@ -415,13 +710,25 @@ void check_periodicity(knot_diagram& kd, const std::string knot_name, int period
       std::cout << "For now you can only check periodicity for primes up to 19..." << "\n";
       exit(EXIT_FAILURE);
     }
-    if(periodicity_test == "Przytycki") {
-      Przytycki_periodicity_checker P_pc(compute_jones(kd), knot_name);
+    if(periodicity_test == "Murasugi") {
+      if(kd.num_components() != 1) {
+	std::cout << "Murasugi's criterion only applies to knots..." << "\n";
+	exit(EXIT_FAILURE);
+      }
+      Murasugi_periodicity_checker M_pc(alexander_polynomial(kd), knot_name);
+      std::cout << M_pc(period) << std::endl;
+    }
+    else if(periodicity_test == "Przytycki") {
+      Przytycki_periodicity_checker P_pc(jones_polynomial(kd), knot_name);
       std::cout << P_pc(period) << std::endl;
     }
     else if(periodicity_test == "Kh") {
-      Kh_periodicity_checker Kh_pc(kd, std::string(knot_name), field);
-      std::cout << Kh_pc(period) << std::endl;
+      Kh_periodicity_grid grid(kd, knot_name, fields, std::vector<int>(1, period),
+			       false);
+      grid.run(periodicity_threads);
+      std::cout << grid.record() << std::endl;
+      if(verbose)
+	std::cerr << periodicity_counts << "\n";
     }
     else {
       std::cout << "Sorry, I don't recognize this option..." << "\n";
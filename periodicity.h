@@ -7,6 +7,8 @@
 #include <vector>
 #include <utility>
 #include <tuple>
+#include <array>
+#include <unordered_set>
 
 extern bool verbose;
 
@@ -77,44 +79,110 @@ class Przytycki_periodicity_checker {
   std::string operator() (int period) const;
 };
 
-class Kh_bounds_iterator {
+/* Murasugi's criterion: if a knot has period p (prime), then
+   Delta(t) = Delta'(t)^p (1 + t + ... + t^(l-1))^(p-1) mod p up to
+   units, for Delta' the Alexander polynomial of the quotient knot and
+   some l prime to p.  Since Delta'(t)^p = Delta'(t^p) mod p, it is
+   enough that Delta, divided by the second factor, only has exponents
+   in one class mod p. */
+class Murasugi_periodicity_checker {
+  using polynomial = multivariate_laurentpoly<Z>;
+  
+  // Alexander polynomial, shifted to start at t^0
+  std::vector<Z> alex;
+  std::string knot_name;
+  
+ public:
+  Murasugi_periodicity_checker(const polynomial& a, std::string knot_n);
+  ~Murasugi_periodicity_checker() {}
+  
+  bool check(int period) const;
+  
+  std::string operator() (int period) const;
+};
+
+/* Candidates (knot, period) screened by the periodicity tests, and
+   how many each stage rejected.  Murasugi's criterion runs first,
+   then Przytycki's, then the Kh criterion on what is left. */
+struct periodicity_stats {
+  unsigned long candidates;
+  unsigned long murasugi_rejected;
+  unsigned long przytycki_rejected;
+  unsigned long kh_rejected;
+  unsigned long survivors;
+  
+  periodicity_stats() :
+    candidates(0), murasugi_rejected(0), przytycki_rejected(0),
+    kh_rejected(0), survivors(0) {}
+};
+
+extern periodicity_stats periodicity_counts;
+
+std::ostream& operator << (std::ostream& os, const periodicity_stats& st);
+
+/* Decides whether s = sum_k c_k P_k with each c_k a multiple of
+   period in the bounds of P_k.  The P_k are written in the basis of
+   reduced monomials and taken one at a time; a coordinate is closed
+   (must agree with s) once the last P_k involving it is taken, and
+   the range of each c_k is cut down to the values for which every
+   coordinate can still reach s.  Partial sums which can't be
+   completed are remembered by their open coordinates. */
+class Kh_bounds_solver {
   using polynomial = multivariate_laurentpoly<Z>;
   using monomial = multivariate_laurent_monomial;
-  using polynomial_tuple = std::vector<std::tuple<polynomial, polynomial, polynomial>>;
   using bounds_vector = std::map<multivariate_laurentpoly<Z>, std::pair<Z, Z>>;
-  
-  bounds_vector bv;
-  int period;
-  std::map<polynomial, Z> current_state;
-  std::map<polynomial, std::pair<Z,Z>>::iterator level;
+  using state = std::vector<int64>;
 
-public:
-  Kh_bounds_iterator(bounds_vector v, int p) :
-    bv(v), period(p) {
-    for(auto& v: bv) {
-      current_state[v.first] = v.second.first;
+  struct state_hash {
+    size_t operator() (const state& st) const {
+      size_t h = st.size();
+      for(auto x : st)
+	h = h * 1000003 ^ std::hash<int64>()(x);
+      return h;
     }
-    level = bv.begin();
-  }
-  ~Kh_bounds_iterator() {}
+  };
 
-  bool advance();
-  polynomial get_polynomial() const;
+  int period;
+  std::map<monomial, unsigned> basis;
+
+  // in search order: the polynomials, their (sparse) coordinates and
+  // the range of c_k / period
+  std::vector<polynomial> gens;
+  std::vector<std::vector<std::pair<unsigned, int64>>> coords;
+  std::vector<int64> lo, hi;
+
+  // coordinates involving polynomials both before and from k on
+  std::vector<std::vector<unsigned>> open;
+  // range of coordinate c reachable by the polynomials from k on
+  std::vector<std::vector<int64>> suffix_min, suffix_max;
+
+  std::vector<int64> target, partial, choice;
+  std::vector<std::unordered_set<state, state_hash>> dead;
+  unsigned long n_states;
+
+  bool search(unsigned k);
+
+ public:
+  Kh_bounds_solver(const bounds_vector& bv, int p);
+  ~Kh_bounds_solver() {}
+
+  bool solve(const polynomial& s);
+  // c_k for each P_k, after solve returned true
+  std::map<polynomial, Z> witness() const;
+  unsigned long states() const { return n_states; }
 };
 
+/* Kh and the Lee spectral sequence are kept as (dense) Poincare
+   polynomials in t and q. */
 class Kh_periodicity_checker {
-  using polynomial = multivariate_laurentpoly<Z>;
-  using monomial = multivariate_laurent_monomial;
+  using polynomial = bivariate_laurentpoly;
   using polynomial_tuple = std::vector<std::tuple<polynomial, polynomial, polynomial>>;
   using bounds_vector = std::map<multivariate_laurentpoly<Z>, std::pair<Z, Z>>;
 
-  unsigned ev_index;
-  unsigned index;
-
   enum class Test_Result { MAYBE, NO, NO_NONTRIVIAL_DECOMP };
 
   polynomial khp, leep;
-  std::vector<polynomial> quot, mul, quotients, remainders;
+  std::vector<polynomial> quot, mul;
 
   std::string knot_name;
   std::string field;
@@ -133,15 +201,56 @@ class Kh_periodicity_checker {
 
   ~Kh_periodicity_checker() {}
 
-  std::string operator () (int period) const;
+  // "Maybe", "No", "No (Przytycki's criterion)", ...
+  std::string verdict(int period) const;
 
-  polynomial get_KhP() const {
-    return khp;
+  std::string get_field() const {
+    return field;
   }
 
-  polynomial get_LeeP() const {
-    return leep;
+  multivariate_laurentpoly<Z> get_KhP() const {
+    return khp.multivariate();
+  }
+
+  multivariate_laurentpoly<Z> get_LeeP() const {
+    return leep.multivariate();
+  }
+};
+
+/* The Kh criterion for every (period, field) pair.  With
+   prefilters, periods ruled out by Murasugi's criterion on the
+   Alexander polynomial (knots only) or by Przytycki's criterion on
+   the Jones polynomial need no Khovanov homology; if that is all of
+   them, Kh is never computed.  Otherwise Kh and the Lee spectral
+   sequence are computed once per field, in turn (the algebra code is
+   not thread-safe).  The remaining pairs are then checked on a pool
+   of threads sharing the checkers, which hold plain data. */
+class Kh_periodicity_grid {
+  std::string knot_name;
+  std::vector<std::string> fields;
+  std::vector<int> periods;
+  // earlier stages by period: "" if passed, else the verdict
+  std::vector<std::string> prefilter;
+  // by field; empty if no period passed the earlier stages
+  std::vector<Kh_periodicity_checker> checkers;
+  // verdicts, by field then period
+  std::vector<std::vector<std::string>> verdicts;
+
+ public:
+  Kh_periodicity_grid(knot_diagram& kd, std::string knot_n,
+		      const std::vector<std::string>& fields_,
+		      const std::vector<int>& periods_,
+		      bool prefilters = true);
+  ~Kh_periodicity_grid() {}
+
+  // 0 threads: one per core
+  void run(unsigned n_threads = 0);
+
+  const std::string& verdict(unsigned f, unsigned p) const {
+    return verdicts[f][p];
   }
+  // all verdicts on one line
+  std::string record() const;
 };
 
 void check_periodicity(knot_diagram& kd, const std::string knot_name,
@@ -0,0 +1,49 @@
+
+/* Rasmussen's s-invariant of the knot kd over the field R, from the
+   spectral sequence of Lee's deformation d + H_1 + ... + H_n (Bar-Natan's
+   over Z2).  The pages at h = 0 depend only on the complex in
+   h = -1, 0, 1, so only those three levels of the cube are built.
+   The pages are computed as in kk's leess, cancelling arrows of
+   q-degree 0, 2, 4, ..., but stop as soon as h = 0 is down to the two
+   generators that survive to E_infinity: their q-gradings are
+   s - 1 and s + 1. */
+template<class R> int
+s_invariant (knot_diagram &kd)
+{
+  assert (kd.num_components () == 1);
+  
+  // h = number of 1-smoothings - nminus
+  unsigned l0 = kd.nminus;
+  cube<R> c (kd, 0, l0 ? l0 - 1 : 0, l0 + 1);
+  ptr<const module<R> > C = c.khC;
+  
+  mod_map<R> d = c.compute_d (1, 0, 0, 0, 0);
+  for (unsigned i = 1; i <= kd.n_crossings; i ++)
+    d = d + c.H_i (i);
+  
+  for (int k = 0;; k ++)
+    {
+      chain_complex_simplifier<R> s (C, d,
+				     maybe<int> (1),
+				     maybe<int> (2 * k));
+      C = s.new_C;
+      d = s.new_d;
+  
+      std::vector<int> q0;
+      for (unsigned i = 1; i <= C->dim (); i ++)
+	{
+	  grading gr = C->generator_grading (i);
+	  if (gr.h == 0)
+	    q0.push_back (gr.q);
+	}
+      assert (q0.size () >= 2);
+      if (q0.size () == 2)
+	{
+	  int qmin = std::min (q0[0], q0[1]),
+	    qmax = std::max (q0[0], q0[1]);
+	  assert (qmax == qmin + 2);
+	  return qmin + 1;
+	}
+      assert (d != 0);
+    }
+}
@@ -62,6 +62,8 @@ class chain_complex_simplifier
   
   void cancel (unsigned i, R b, unsigned j);
   
+  bool simplify_out_of_core (int dh, maybe<int> dq);
+  
  public:
   chain_complex_simplifier (ptr<const module<R> > C_,
 			    const mod_map<R> &d_,
@@ -143,29 +145,389 @@ chain_complex_simplifier<R>::cancel (unsigned i, R b, unsigned j)
   preim[j].clear ();
 }
 
+/* Out of core version, for d homogeneous of degree dh != 0 in h.
+   Cancelling i against j, h(j) = h(i) + dh, only changes columns of
+   degree h(i) (degree h(i) - dh columns lose i, which is done when
+   they are loaded) and drops j from degree h(i) + dh.  So degrees
+   are eliminated one at a time, h + dh before h, with only the
+   columns of those two degrees in memory.  Finished columns of new_d
+   and iota, and the cancellation history, are spilled as they are
+   produced.  Does nothing and returns false if d is not
+   homogeneous. */
+template<class R> bool
+chain_complex_simplifier<R>::simplify_out_of_core (int dh, maybe<int> dq)
+{
+  map<int, basedvector<unsigned, 1> > degree_gens;
+  for (unsigned i = 1; i <= n; i ++)
+    degree_gens[C->generator_grading (i).h].append (i);
+  
+  // degrees in the order they are eliminated
+  basedvector<int, 1> order;
+  for (typename map<int, basedvector<unsigned, 1> >::const_iter i = degree_gens; i; i ++)
+    order.append (i.key ());
+  if (dh > 0)
+    {
+      for (unsigned k = 1, l = order.size (); k < l; k ++, l --)
+	std::swap (order[k], order[l]);
+    }
+  
+  for (unsigned k = 1; k <= order.size (); k ++)
+    {
+      int h = order[k];
+      const basedvector<unsigned, 1> &gens = degree_gens[h];
+      for (unsigned ii = 1; ii <= gens.size (); ii ++)
+	{
+	  linear_combination<R> c = d.column (gens[ii]);
+	  for (linear_combination_const_iter<R> j = c; j; j ++)
+	    {
+	      if (C->generator_grading (j.key ()).h != h + dh)
+		return 0;
+	    }
+	}
+    }
+  
+  bitset eliminated (n);
+  
+  // per degree, columns which may still lose generators
+  map<int, map<unsigned, linear_combination<R> > > pending_d, pending_iota;
+  
+  ptr<column_store<R> > new_d_store = new column_store<R> (C, C),
+    iota_store = new column_store<R> (C, C);
+  
+  // cancellation history: (j, 1/b, d(i)) per cancellation, a block per degree
+  ptr<spill_file> hist = new spill_file;
+  basedvector<uint64, 1> hist_offset;
+  basedvector<unsigned, 1> hist_count;
+  
+  for (unsigned k = 1; k <= order.size (); k ++)
+    {
+      int h = order[k];
+      const basedvector<unsigned, 1> &gens = degree_gens[h];
+      
+      if (verbose)
+	fprintf (stderr, "simplifying degree %d (%d generators)...\n", h, gens.size ());
+      
+      map<unsigned, linear_combination<R> > &cur_d = pending_d[h],
+	&cur_iota = pending_iota[h];
+      map<unsigned, linear_combination<R> > *target_d = pending_d ^ (h + dh),
+	*target_iota = pending_iota ^ (h + dh);
+      
+      // generators of degree h + dh -> columns hitting them
+      map<unsigned, set<unsigned> > preim;
+      for (unsigned ii = 1; ii <= gens.size (); ii ++)
+	{
+	  unsigned i = gens[ii];
+	  
+	  linear_combination<R> c = d.column_copy (i);
+	  basedvector<unsigned, 1> gone;
+	  for (linear_combination_const_iter<R> j = c; j; j ++)
+	    {
+	      if (eliminated % j.key ())
+		gone.append (j.key ());
+	    }
+	  for (unsigned l = 1; l <= gone.size (); l ++)
+	    c.yank (gone[l]);
+	  
+	  for (linear_combination_const_iter<R> j = c; j; j ++)
+	    preim[j.key ()].push (i);
+	  cur_d.push (i, c);
+	  
+	  linear_combination<R> x (C);
+	  x.muladd (1, i);
+	  cur_iota.push (i, x);
+	}
+      
+      unsigned n_cancels = 0;
+      {
+	spill_writer w (hist);
+	hist_offset.append (w.offset);
+	
+	for (unsigned ii = gens.size (); ii >= 1; ii --)
+	  {
+	    unsigned i = gens[ii];
+	    grading igr = C->generator_grading (i);
+	    
+	    linear_combination<R> &di = cur_d[i];
+	    
+	    unsigned j = 0;
+	    R b;
+	    for (linear_combination_const_iter<R> jj = di; jj; jj ++)
+	      {
+		if (jj.val ().is_unit ()
+		    && (dq.is_none ()
+			|| (C->generator_grading (jj.key ()).q - igr.q == dq.some ())))
+		  {
+		    j = jj.key ();
+		    b = jj.val ();
+		    break;
+		  }
+	      }
+	    if (!j)
+	      continue;
+	    
+	    R binv = b.recip ();
+	    
+	    eliminated.push (i);
+	    eliminated.push (j);
+	    
+	    di.yank (j);
+	    set<unsigned> &pj = preim[j];
+	    pj.yank (i);
+	    for (linear_combination_const_iter<R> l = di; l; l ++)
+	      preim[l.key ()].yank (i);
+	    
+	    const linear_combination<R> &iota_i = cur_iota[i];
+	    for (set_const_iter<unsigned> kk = pj; kk; kk ++)
+	      {
+		unsigned k = kk.val ();
+		linear_combination<R> &dk = cur_d[k];
+		R abinv = dk(j) * binv;
+		
+		cur_iota[k].mulsub (abinv, iota_i);
+		for (linear_combination_const_iter<R> ll = di; ll; ll ++)
+		  {
+		    unsigned ell = ll.key ();
+		    dk.mulsub (abinv * ll.val (), ell);
+		    if (dk % ell)
+		      preim[ell] += k;
+		    else
+		      preim[ell] -= k;
+		  }
+		dk.yank (j);
+	      }
+	    
+	    w.write_unsigned (j);
+	    binv.write_self (w);
+	    di.write_column (w);
+	    n_cancels ++;
+	    
+	    preim -= j;
+	    cur_d -= i;
+	    cur_iota -= i;
+	    assert (target_d);
+	    *target_d -= j;
+	    *target_iota -= j;
+	  }
+      }
+      hist_count.append (n_cancels);
+      
+      // degree h + dh is final
+      if (target_d)
+	{
+	  for (typename map<unsigned, linear_combination<R> >::const_iter i = *target_d; i; i ++)
+	    {
+	      (*new_d_store)[i.key ()] = i.val ();
+	      (*iota_store)[i.key ()] = (*target_iota)[i.key ()];
+	    }
+	  pending_d -= h + dh;
+	  pending_iota -= h + dh;
+	  
+	  new_d_store->spill_if_needed ();
+	  iota_store->spill_if_needed ();
+	}
+    }
+  
+  for (typename map<int, map<unsigned, linear_combination<R> > >::const_iter i = pending_d; i; i ++)
+    {
+      const map<unsigned, linear_combination<R> > &pd = i.val (),
+	&piota = pending_iota[i.key ()];
+      for (typename map<unsigned, linear_combination<R> >::const_iter j = pd; j; j ++)
+	{
+	  (*new_d_store)[j.key ()] = j.val ();
+	  (*iota_store)[j.key ()] = piota(j.key ());
+	}
+    }
+  pending_d.clear ();
+  pending_iota.clear ();
+  
+  unsigned new_n = n - eliminated.card ();
+  basedvector<unsigned, 1> new_C_to_C_generator (new_n),
+    C_to_new_C_generator (n);
+  for (unsigned i = 1, j = 1; i <= n; i ++)
+    {
+      if (eliminated % i)
+	{
+	  C_to_new_C_generator[i] = 0;
+	  continue;
+	}
+      
+      C_to_new_C_generator[i] = j;
+      new_C_to_C_generator[j] = i;
+      j ++;
+    }
+  
+  new_C = (new base_module<R, simplified_complex_generators<R> >
+	   (simplified_complex_generators<R> (new_n, C, new_C_to_C_generator)));
+  
+  map_builder<R> db (new_C),
+    iotab (new_C, C);
+  for (unsigned k = 1; k <= order.size (); k ++)
+    {
+      const basedvector<unsigned, 1> &gens = degree_gens[order[k]];
+      for (unsigned ii = 1; ii <= gens.size (); ii ++)
+	{
+	  unsigned i0 = gens[ii];
+	  unsigned i = C_to_new_C_generator[i0];
+	  if (!i)
+	    continue;
+	  
+	  linear_combination<R> c = new_d_store->column (i0);
+	  for (linear_combination_const_iter<R> j0 = c; j0; j0 ++)
+	    {
+	      unsigned j = C_to_new_C_generator[j0.key ()];
+	      assert (j != 0);
+	      
+	      db[i].muladd (j0.val (), j);
+	    }
+	  
+	  iotab[i] = iota_store->column (i0);
+	}
+      
+      db.spill_if_needed ();
+      iotab.spill_if_needed ();
+    }
+  new_d = mod_map<R> (db);
+  iota = mod_map<R> (iotab);
+  
+  // done with the C-indexed columns
+  new_d_store = ptr<column_store<R> > ();
+  iota_store = ptr<column_store<R> > ();
+  
+  map_builder<R> pib (C, new_C);
+  for (unsigned i = 1; i <= new_n; i ++)
+    pib[new_C_to_C_generator[i]].muladd (1, i);
+  pib.spill_if_needed ();
+  
+  for (unsigned k = hist_offset.size (); k >= 1; k --)
+    {
+      uint64 end = (k < hist_offset.size ()
+		    ? hist_offset[k + 1]
+		    : hist->size);
+      spill_reader r (hist, hist_offset[k], end - hist_offset[k]);
+      
+      unsigned m = hist_count[k];
+      basedvector<unsigned, 1> js (m);
+      basedvector<R, 1> binvs (m);
+      basedvector<linear_combination<R>, 1> dis (m);
+      for (unsigned l = 1; l <= m; l ++)
+	{
+	  js[l] = r.read_unsigned ();
+	  binvs[l] = R (r);
+	  dis[l] = linear_combination<R> (C, r);
+	}
+      
+      for (unsigned l = m; l >= 1; l --)
+	{
+	  for (linear_combination_const_iter<R> ll = dis[l]; ll; ll ++)
+	    pib[js[l]].mulsub (binvs[l] * ll.val (), pib[ll.key ()]);
+	}
+      
+      pib.spill_if_needed ();
+    }
+  pi = mod_map<R> (pib);
+  
+  return 1;
+}
+
 template<class R>
 chain_complex_simplifier<R>::chain_complex_simplifier (ptr<const module<R> > C_,
 						       const mod_map<R> &d_,
 						       maybe<int> dh, maybe<int> dq)
-  : C(C_), n(C_->dim ()), d(d_),
-    new_d_columns(n),
-    preim(n),
-    iota_columns(n)
+  : C(C_), n(C_->dim ()), d(d_)
 {
+  if (spill_budget
+      && dh.is_some ()
+      && dh.some () != 0
+      && simplify_out_of_core (dh.some (), dq))
+    return;
+  
+  new_d_columns.resize (n);
+  preim.resize (n);
+  iota_columns.resize (n);
+  
+  // the checkpoint key covers the whole of C and d: the gradings and
+  // the entries
+  bool keyed = !checkpoint_dir.empty ();
+  hash_writer kw;
+  kw.write_unsigned (n);
+  kw.write_int (dh.is_none () ? 0 : 1 + 2 * dh.some ());
+  kw.write_int (dq.is_none () ? 0 : 1 + 2 * dq.some ());
   for (unsigned i = 1; i <= n; i ++)
     {
       new_d_columns[i] = d.column_copy (i);
       
+      if (keyed)
+	{
+	  grading hq = C->generator_grading (i);
+	  kw.write_int (hq.h);
+	  kw.write_int (hq.q);
+	  kw.write_unsigned (new_d_columns[i].card ());
+	}
       for (linear_combination_const_iter<R> j = new_d_columns[i]; j; j ++)
-	preim[j.key ()].push (i);
+	{
+	  if (keyed)
+	    {
+	      kw.write_unsigned (j.key ());
+	      write (kw, j.val ());
+	    }
+	  preim[j.key ()].push (i);
+	}
       
       linear_combination<R> x (C);
       x.muladd (1, i);
       iota_columns[i] = x;
     }
   
-  for (unsigned i = n; i >= 1; i --)
+  /* The checkpoint holds the cancellation history and the sparse
+     state (new_d_columns, iota_columns); preim is rebuilt from
+     new_d_columns. */
+  hash_t key = hash_combine (hash (std::string (typeid (R).name ())), kw.hash_value ());
+  checkpoint ckpt ("simplify", key);
+  
+  unsigned start = n;
+  if (file_reader *r = ckpt.open ())
     {
+      start = r->read_unsigned ();
+      canceled = set<unsigned> (*r);
+      cancel_binv = basedvector<R, 1> (*r);
+      cancel_j = basedvector<unsigned, 1> (*r);
+      cancel_di.resize (cancel_binv.size ());
+      for (unsigned k = 1; k <= cancel_di.size (); k ++)
+	cancel_di[k] = linear_combination<R> (C, *r);
+      
+      for (unsigned k = 1; k <= n; k ++)
+	{
+	  preim[k].clear ();
+	  new_d_columns[k] = linear_combination<R> (C, *r);
+	  iota_columns[k] = linear_combination<R> (C, *r);
+	}
+      for (unsigned k = 1; k <= n; k ++)
+	{
+	  for (linear_combination_const_iter<R> j = new_d_columns[k]; j; j ++)
+	    preim[j.key ()].push (k);
+	}
+      delete r;
+    }
+  
+  for (unsigned i = start; i >= 1; i --)
+    {
+      if (ckpt.due ())
+	{
+	  ckpt.save ([&] (writer &w) {
+	      w.write_unsigned (i);
+	      write (w, canceled);
+	      write (w, cancel_binv);
+	      write (w, cancel_j);
+	      for (unsigned k = 1; k <= cancel_di.size (); k ++)
+		cancel_di[k].write_column (w);
+	      for (unsigned k = 1; k <= n; k ++)
+		{
+		  new_d_columns[k].write_column (w);
+		  iota_columns[k].write_column (w);
+		}
+	    });
+	}
+      
       if (canceled % i)
 	continue;
       
@@ -185,6 +547,8 @@ chain_complex_simplifier<R>::chain_complex_simplifier (ptr<const module<R> > C_,
 	}
     }
   
+  ckpt.remove ();
+  
   // ??? might not be completely simplified
   
   unsigned new_n = n - canceled.card ();
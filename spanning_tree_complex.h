@@ -23,8 +23,19 @@ class spanning_tree_complex
   grading tree_grading (unsigned i) const;
   void show_tree (unsigned i) const;
 
+  /* As for twisted_cube, the build_ templates fill b with the maps
+     below for t^w = tw (w) in K. */
+  template<class K, class T, class M> void build_totally_twisted_kh_d (T tw, M &b) const;
+  template<class K, class T, class M> void build_twisted_d2 (T tw, M &b) const;
+  
   mod_map<R> totally_twisted_kh_d () const;
   mod_map<R> twisted_d2 () const;
+  
+  /* Graded dimensions over F(t) of the homology of the maps above,
+     from their values at points of an extension of F
+     (twisted_evaluation.h).  F must be finite. */
+  bivariate_laurentpoly totally_twisted_kh_homology (unsigned n_threads = 0) const;
+  bivariate_laurentpoly twisted_d2_homology (unsigned n_threads = 0) const;
   mod_map<R> twisted_d2Un (unsigned n) const;
   
   mod_map<R> twisted_d2U1_test () const;
@@ -93,9 +104,15 @@ extern map<unsigned, int> find_cycle (const directed_multigraph &bg,
 template<class F> mod_map<fraction_field<polynomial<F> > >
 spanning_tree_complex<F>::twisted_d2 () const
 {
-  assert (kd.marked_edge);
-
   map_builder<R> b (C);
+  build_twisted_d2<R> ([] (int w) { return R (polynomial<F> (1, w)); }, b);
+  return mod_map<R> (b);
+}
+
+template<class F> template<class K, class T, class M> void
+spanning_tree_complex<F>::build_twisted_d2 (T tw, M &b) const
+{
+  assert (kd.marked_edge);
   
   basedvector<int, 1> edge_weight (kd.num_edges ());
   for (unsigned i = 1; i <= kd.num_edges (); i ++)
@@ -195,22 +212,18 @@ spanning_tree_complex<F>::twisted_d2 () const
 		    B += edge_weight[k];
 		}
 	      
-	      R x;
+	      K x;
 	      
 	      if (neg)
-		x += R (1);
+		x += K (1);
 	      
-	      x += R (polynomial<F> (1),
-		      polynomial<F> (1) + polynomial<F> (1, A));
-	      x += R (polynomial<F> (1),
-		      polynomial<F> (1) + polynomial<F> (1, B));
+	      x += K (1) / (K (1) + tw (A));
+	      x += K (1) / (K (1) + tw (B));
 	      
 	      b[i].muladd (x, j);
 	    }
 	}
     }
-  
-  return mod_map<R> (b);
 }
 
 template<class F> mod_map<fraction_field<polynomial<F> > >
@@ -501,9 +514,15 @@ spanning_tree_complex<F>::twisted_d2U1_test () const
 template<class F> mod_map<fraction_field<polynomial<F> > >
 spanning_tree_complex<F>::totally_twisted_kh_d () const
 {
-  assert (kd.marked_edge);
-  
   map_builder<R> b (C);
+  build_totally_twisted_kh_d<R> ([] (int w) { return R (polynomial<F> (1, w)); }, b);
+  return mod_map<R> (b);
+}
+
+template<class F> template<class K, class T, class M> void
+spanning_tree_complex<F>::build_totally_twisted_kh_d (T tw, M &b) const
+{
+  assert (kd.marked_edge);
   
   basedvector<int, 1> edge_weight (kd.num_edges ());
   for (unsigned i = 1; i <= kd.num_edges (); i ++)
@@ -558,12 +577,12 @@ spanning_tree_complex<F>::totally_twisted_kh_d () const
 	      set<unsigned> both (COPY, t);
 	      both.push (f);
 	      
-	      R A = 0;
+	      K A = 0;
 	      for (unsigned k = 1; k <= kd.num_edges (); k ++)
 		{
 		  if (neither_s.edge_circle[k]
 		      != neither_s.edge_circle[kd.marked_edge])
-		    A += polynomial<F> (1, edge_weight[k]);
+		    A += tw (edge_weight[k]);
 		}
 	      
 	      smallbitset both_r (kd.n_crossings);
@@ -574,23 +593,56 @@ spanning_tree_complex<F>::totally_twisted_kh_d () const
 		}
 	      smoothing both_s (kd, both_r);
 	      
-	      R B = 0;
+	      K B = 0;
 	      for (unsigned k = 1; k <= kd.num_edges (); k ++)
 		{
 		  if (both_s.edge_circle[k]
 		      != both_s.edge_circle[kd.marked_edge])
-		    B += polynomial<F> (1, edge_weight[k]);
+		    B += tw (edge_weight[k]);
 		}
 	      
-	      R x;
+	      K x;
 	      
-	      x += R (polynomial<F> (1)) / A;
-	      x += R (polynomial<F> (1)) / B;
+	      x += K (1) / A;
+	      x += K (1) / B;
 	      
 	      b[i].muladd (x, j);
 	    }
 	}
     }
+}
+
+template<class F> bivariate_laurentpoly
+spanning_tree_complex<F>::totally_twisted_kh_homology (unsigned n_threads) const
+{
+  typedef extension_field<F> K;
   
-  return mod_map<R> (b);
+  // the denominators have degree at most num_edges ()
+  twisted_evaluator<F> ev (kd.num_edges () + 1, n_threads);
+  
+  basedvector<grading, 1> gr (trees.size ());
+  for (unsigned i = 1; i <= trees.size (); i ++)
+    gr[i] = tree_grading (i);
+  
+  return ev.homology (gr, [this] (const multipoint<K> &a,
+				  sparse_field_matrix<multipoint<K> > &m) {
+      build_totally_twisted_kh_d<multipoint<K> > ([&a] (int w) { return pow (a, w); }, m);
+    });
+}
+
+template<class F> bivariate_laurentpoly
+spanning_tree_complex<F>::twisted_d2_homology (unsigned n_threads) const
+{
+  typedef extension_field<F> K;
+  
+  twisted_evaluator<F> ev (kd.num_edges () + 1, n_threads);
+  
+  basedvector<grading, 1> gr (trees.size ());
+  for (unsigned i = 1; i <= trees.size (); i ++)
+    gr[i] = tree_grading (i);
+  
+  return ev.homology (gr, [this] (const multipoint<K> &a,
+				  sparse_field_matrix<multipoint<K> > &m) {
+      build_twisted_d2<multipoint<K> > ([&a] (int w) { return pow (a, w); }, m);
+    });
 }
@@ -1,5 +1,6 @@
 
 #include <knotkit.h>
+#include <periodicity.h>
 
 void
 test_vector ()
@@ -282,15 +283,11 @@ test_map ()
 void
 test_polynomial ()
 {
-  vector<int> coeffs (3);
-  coeffs[0] = 7;
-  coeffs[1] = 0;
-  coeffs[2] = 2;
-  polynomial<int> p (coeffs);
+  polynomial<Q> p = polynomial<Q> (Q (7)) + polynomial<Q> (Q (2), 2);
   p.show_self ();
   printf ("\n");
   
-  polynomial<int> q (coeffs);
+  polynomial<Q> q (COPY, p);
   q += p;
   show (q);
   printf ("\n");
@@ -300,14 +297,75 @@ test_polynomial ()
   printf ("\n");
 }
 
+// coefficients from a fixed linear congruential sequence
+template<class R> polynomial<R>
+dense_polynomial (unsigned n, unsigned &seed)
+{
+  polynomial<R> p;
+  for (unsigned i = 0; i <= n; i ++)
+    {
+      seed = seed * 1103515245 + 12345;
+      p += polynomial<R> (R ((int) ((seed >> 16) & 0x7fff)), i);
+    }
+  p += polynomial<R> (R (1), n + 1);
+  return p;
+}
+
+/* n well above fast_threshold, so the multiply, divide and gcd take
+   the Karatsuba, Newton and half-gcd paths. */
+template<class R> void
+test_dense_polynomial1 (unsigned n)
+{
+  unsigned seed = 1;
+  polynomial<R> a = dense_polynomial<R> (n, seed),
+    b = dense_polynomial<R> (n / 2, seed),
+    c = dense_polynomial<R> (n / 3, seed);
+  
+  polynomial<R> ab = a * b;
+  assert (ab.degree () == a.degree () + b.degree ());
+  for (unsigned k = 0; k <= ab.degree (); k += 37)
+    {
+      R x = 0;
+      for (unsigned i = 0; i <= k && i <= a.degree (); i ++)
+	{
+	  if (k - i <= b.degree ())
+	    x += a.coeff (i) * b.coeff (k - i);
+	}
+      assert (ab.coeff (k) == x);
+    }
+  assert (ab == b * a);
+  assert (a * (b + c) == ab + a * c);
+  
+  assert ((ab + c).mod (a) == c);
+  assert ((ab + c - c).divide_exact (a) == b);
+  assert (ab.divide_exact (b) == a);
+  assert (ab.mod (a) == 0);
+  
+  polynomial<R> one (1);
+  assert (a.gcd (one) == 1);
+  assert (a.gcd (0) == a.monic ());
+  polynomial<R> g = (a * c).gcd (b * c);
+  assert (g == c.monic () * a.gcd (b));
+  assert ((a * c).mod (g) == 0);
+  assert ((b * c).mod (g) == 0);
+}
+
+void
+test_dense_polynomial ()
+{
+  test_dense_polynomial1<Z2> (10);
+  test_dense_polynomial1<Z2> (2000);
+  test_dense_polynomial1<Zp<3> > (10);
+  test_dense_polynomial1<Zp<7> > (500);
+  test_dense_polynomial1<Zp<65521> > (500);
+}
+
 void
 test_laurentpoly ()
 {
-  vector<int> c (3);
-  c[0] = 1;
-  c[1] = 0;
-  c[2] = 1;
-  laurentpoly<int> p (-1, c);
+  multivariate_laurentpoly<Z> p
+    = (multivariate_laurentpoly<Z> (Z (1), VARIABLE, 1, -1)
+       + multivariate_laurentpoly<Z> (Z (1), VARIABLE, 1, 1));
   
   show (p);
   printf ("\n");
@@ -397,11 +455,347 @@ test_vs ()
 }
 #endif
 
+void
+test_bivariate_laurentpoly ()
+{
+  typedef multivariate_laurentpoly<Z> polynomial;
+  
+  // 1 + t q^2 - t^-1 q^-3
+  bivariate_laurentpoly p (1);
+  p.add_term (1, 1, 2);
+  p.add_term (-1, -1, -3);
+  assert (p.coeff (0, 0) == 1);
+  assert (p.coeff (1, 2) == 1);
+  assert (p.coeff (-1, -3) == -1);
+  assert (p.coeff (5, 5) == 0);
+  
+  polynomial m = (polynomial (1)
+		  + polynomial (Z (1), VARIABLE, 1) * polynomial (Z (1), VARIABLE, 2, 2)
+		  - (polynomial (Z (1), VARIABLE, 1, -1)
+		     * polynomial (Z (1), VARIABLE, 2, -3)));
+  assert (p.multivariate () == m);
+  assert (bivariate_laurentpoly (m) == p);
+  
+  bivariate_laurentpoly zero = p - p;
+  assert (zero.is_zero ());
+  assert (zero == 0);
+  zero.trim ();
+  assert (zero.twidth == 0);
+  
+  assert ((p * p).multivariate () == m * m);
+  assert ((p + p) == p * bivariate_laurentpoly (2));
+  bivariate_laurentpoly r (p);
+  r *= 3;
+  assert (r.multivariate () == m * Z (3));
+  
+  // t = -1: 1 - q^2 + q^-3
+  bivariate_laurentpoly e = p.evaluate_t (-1);
+  assert (e.coeff (0, 0) == 1);
+  assert (e.coeff (0, 2) == -1);
+  assert (e.coeff (0, -3) == 1);
+  
+  bivariate_laurentpoly inv = p.invert_q ();
+  assert (inv.coeff (1, -2) == 1);
+  assert (inv.coeff (-1, 3) == -1);
+  assert (inv.invert_q () == p);
+  
+  // q^-3 = q^1 mod 4
+  bivariate_laurentpoly f = p.fold_q (4);
+  assert (f.coeff (0, 0) == 1);
+  assert (f.coeff (1, 2) == 1);
+  assert (f.coeff (-1, 1) == -1);
+  assert (f.coeff (-1, -3) == 0);
+}
+
+void
+test_Kh_bounds_solver ()
+{
+  typedef multivariate_laurentpoly<Z> polynomial;
+  
+  polynomial x1 (Z (1), VARIABLE, 1),
+    x2 (Z (1), VARIABLE, 2),
+    x3 (Z (1), VARIABLE, 3);
+  polynomial p1 = x1,
+    p2 = x1 + x2;
+  
+  std::map<polynomial, std::pair<Z, Z> > bv;
+  bv.emplace (p1, std::make_pair (Z (0), Z (10)));
+  bv.emplace (p2, std::make_pair (Z (-5), Z (5)));
+  
+  Kh_bounds_solver solver (bv, 5);
+  assert (solver.solve (polynomial (Z (15), VARIABLE, 1)
+			+ polynomial (Z (5), VARIABLE, 2)));
+  std::map<polynomial, Z> w = solver.witness ();
+  assert (w[p1] == 10);
+  assert (w[p2] == 5);
+  
+  assert (solver.solve (polynomial (Z (-5), VARIABLE, 2)
+			- polynomial (Z (5), VARIABLE, 1)));
+  assert (solver.solve (polynomial ()));
+  
+  // c_2 = 10 is out of bounds
+  assert (!solver.solve (polynomial (Z (20), VARIABLE, 1)
+			 + polynomial (Z (10), VARIABLE, 2)));
+  // not a multiple of the period
+  assert (!solver.solve (polynomial (Z (5), VARIABLE, 1)
+			 + polynomial (Z (3), VARIABLE, 2)));
+  // not in the span
+  assert (!solver.solve (polynomial (Z (5), VARIABLE, 3)));
+  assert (!solver.solve (x3 * Z (5) + x1 * Z (5)));
+}
+
+void
+test_jones ()
+{
+  typedef multivariate_laurentpoly<Z> polynomial;
+  
+  polynomial q (Z (1), VARIABLE, 2),
+    qinv (Z (1), VARIABLE, 2, -1);
+  
+  knot_diagram unknot = parse_knot ("U");
+  assert (jones_polynomial (unknot) == q + qinv);
+  assert (jones_polynomial (unknot, 1) == 1);
+  
+  // q + q^3 + q^5 - q^9
+  knot_diagram trefoil = parse_knot ("3_1");
+  polynomial j = (q + polynomial (Z (1), VARIABLE, 2, 3)
+		  + polynomial (Z (1), VARIABLE, 2, 5)
+		  - polynomial (Z (1), VARIABLE, 2, 9));
+  assert (jones_polynomial (trefoil) == j);
+  assert (jones_polynomial (trefoil, 1) * (q + qinv) == j);
+  
+  // q^-5 + q^5
+  knot_diagram fig8 = parse_knot ("4_1");
+  assert (jones_polynomial (fig8)
+	  == (polynomial (Z (1), VARIABLE, 2, -5)
+	      + polynomial (Z (1), VARIABLE, 2, 5)));
+  
+  // a split unknot multiplies by q + q^-1
+  knot_diagram split = parse_knot ("3_1 U");
+  assert (jones_polynomial (split) == j * (q + qinv));
+  
+  for (unsigned i = 1; i <= 3; i ++)
+    {
+      knot_diagram kd = parse_knot (("8_" + std::to_string (i)).c_str ());
+      assert (jones_polynomial (kd, 1) * (q + qinv) == jones_polynomial (kd));
+    }
+}
+
+void
+test_alexander ()
+{
+  typedef multivariate_laurentpoly<Z> polynomial;
+  
+  polynomial t (Z (1), VARIABLE, 1),
+    tinv (Z (1), VARIABLE, 1, -1);
+  
+  assert (alexander_polynomial (parse_knot ("U")) == 1);
+  assert (alexander_polynomial (parse_knot ("3_1")) == tinv - polynomial (1) + t);
+  assert (alexander_polynomial (parse_knot ("4_1")) == polynomial (3) - tinv - t);
+}
+
+void
+test_murasugi ()
+{
+  typedef multivariate_laurentpoly<Z> polynomial;
+  
+  polynomial t (Z (1), VARIABLE, 1),
+    tinv (Z (1), VARIABLE, 1, -1);
+  
+  // Delta = 1 mod p, with zeros mod p at both ends
+  Murasugi_periodicity_checker M5 (t * Z (5) - polynomial (9) + tinv * Z (5), "");
+  assert (M5.check (5));
+  Murasugi_periodicity_checker M7 (t * Z (7) - polynomial (13) + tinv * Z (7), "");
+  assert (M7.check (7));
+  
+  // T(2,5) has period 5: Delta = (1 + t)^4 mod 5
+  Murasugi_periodicity_checker T25 (alexander_polynomial (parse_knot ("5_1")), "5_1");
+  assert (T25.check (5));
+  
+  Murasugi_periodicity_checker trefoil (alexander_polynomial (parse_knot ("3_1")), "3_1");
+  assert (!trefoil.check (5));
+  assert (!trefoil.check (7));
+  
+  Murasugi_periodicity_checker fig8 (alexander_polynomial (parse_knot ("4_1")), "4_1");
+  assert (!fig8.check (5));
+}
+
+static multivariate_laurentpoly<Z>
+khp (knot_diagram &kd, bool reduced)
+{
+  cube<Q> c (kd, reduced);
+  mod_map<Q> d = c.compute_d (1, 0, 0, 0, 0);
+  chain_complex_simplifier<Q> s (c.khC, d,
+				 maybe<int> (1), maybe<int> (0));
+  return s.new_C->free_poincare_polynomial ();
+}
+
+void
+test_canonical ()
+{
+  /* Reduced Kh of a split link depends on the marked component: Kh
+     of K marked on the unknot, reduced Kh of K times q + q^-1
+     marked on K.  The canonical numbering must keep it, as edge 1
+     where the cube looks for it. */
+  knot_diagram trefoil = parse_knot ("3_1");
+  multivariate_laurentpoly<Z> on_unknot = khp (trefoil, 0);
+  
+  knot_diagram kd = parse_knot ("T(2,3) U");
+  kd.marked_edge = 1;
+  multivariate_laurentpoly<Z> P1 = khp (kd, 1);
+  
+  std::set<multivariate_laurentpoly<Z> > seen;
+  for (unsigned e = 1; e <= kd.num_edges (); e ++)
+    {
+      kd.marked_edge = e;
+      knot_diagram cd (CANONICAL, kd);
+      assert (cd.marked_edge == 1);
+      multivariate_laurentpoly<Z> P = khp (cd, 1);
+      seen.insert (P);
+      if (e == 1)
+	assert (P == P1);
+      
+      knot_diagram rd (CANONICAL, kd, 1);
+      assert (rd.marked_edge == 1);
+      assert (khp (rd, 1) == P);
+    }
+  assert (seen.size () == 2);
+  assert (seen.count (on_unknot));
+}
+
+// the coefficients model saves for key, as t[0..2], m[0..2]
+static std::vector<double>
+saved_coefficients (const cost_model &model, const std::string &key)
+{
+  char *out = 0;
+  size_t out_size = 0;
+  FILE *fp = open_memstream (&out, &out_size);
+  model.save (fp);
+  fclose (fp);
+  
+  std::vector<double> c (6);
+  bool found = 0;
+  for (char *line = strtok (out, "\n"); line; line = strtok (0, "\n"))
+    {
+      char *tab = strchr (line, '\t');
+      assert (tab);
+      if (std::string (line, tab) != key)
+	continue;
+      unsigned runs;
+      assert (sscanf (tab + 1, "%u %lf %lf %lf %lf %lf %lf", &runs,
+		      &c[0], &c[1], &c[2], &c[3], &c[4], &c[5]) == 7);
+      found = 1;
+    }
+  free (out);
+  assert (found);
+  return c;
+}
+
+static std::vector<cost_sample>
+synthetic_samples (const std::string &key, const double *t, const double *m)
+{
+  std::vector<cost_sample> samples;
+  for (unsigned n = 3; n <= 12; n ++)
+    for (unsigned j = 0; j < 3; j ++)
+      {
+	cost_sample s;
+	s.key = key;
+	s.shape.n_crossings = n;
+	s.shape.generators = ldexp (1.0, n) * (2 + j);
+	s.shape.nonzeros = ldexp (1.0, n) * n * (1 + j * j);
+	s.seconds = exp (t[0]
+			 + t[1] * log (s.shape.nonzeros + 1)
+			 + t[2] * n) - 0.001;
+	s.bytes = m[0] + m[1] * s.shape.generators + m[2] * s.shape.nonzeros;
+	samples.push_back (s);
+      }
+  return samples;
+}
+
+static bool
+close_to (double a, double b)
+{
+  return fabs (a - b) <= 1e-3 * (1 + fabs (b));
+}
+
+void
+test_cost_model ()
+{
+  // fit recovers the coefficients the runs were made with
+  double t[3] = { -9, 1.1, 0.05 },
+    m[3] = { 4e6, 40, 24 };
+  cost_model model;
+  model.fit (synthetic_samples ("khp Z7", t, m));
+  std::vector<double> c = saved_coefficients (model, "khp Z7");
+  for (unsigned j = 0; j < 3; j ++)
+    {
+      assert (close_to (c[j], t[j]));
+      assert (close_to (c[3 + j], m[j]));
+    }
+  
+  // time and memory only grow with the complex: a negative t[1] or
+  // m[j] is dropped
+  double neg_t[3] = { -2, -0.5, 0.6 },
+    neg_m[3] = { 1e6, -10, 30 };
+  model.fit (synthetic_samples ("khp Z5", neg_t, neg_m));
+  c = saved_coefficients (model, "khp Z5");
+  assert (c[1] == 0);
+  assert (c[2] > 0);
+  assert (c[4] == 0);
+  assert (c[5] > 0);
+  
+  // exact shape of a small cube: generators and nonzero entries of d
+  knot_diagram kd = parse_knot ("3_1");
+  cube<Z2> C (kd, 0);
+  mod_map<Z2> d = C.compute_d (1, 0, 0, 0, 0);
+  unsigned nonzeros = 0;
+  for (unsigned i = 1; i <= C.n_generators; i ++)
+    nonzeros += d.column (i).card ();
+  
+  cube_shape shape (kd, 0);
+  assert (shape.n_crossings == 3);
+  assert (shape.generators == C.n_generators);
+  assert (shape.nonzeros == nonzeros);
+}
+
+static std::string
+run (const std::string &cmd)
+{
+  FILE *fp = popen (cmd.c_str (), "r");
+  assert (fp);
+  std::string out;
+  char buf[4096];
+  size_t n;
+  while ((n = fread (buf, 1, sizeof buf, fp)) > 0)
+    out.append (buf, n);
+  assert (pclose (fp) == 0);
+  return out;
+}
+
+void
+test_thin_store ()
+{
+  /* 9_42 is not Kh-thin, so kk -thin guesses wrong.  The guess must
+     not reach the store, where a later run without -thin would read
+     it.  Needs ./kk. */
+  char dir[] = "/tmp/testlib-storeXXXXXX";
+  assert (mkdtemp (dir));
+  std::string store = std::string (" -store ") + dir;
+  
+  std::string full = run ("./kk khp -f Q 9_42");
+  std::string thin = run ("./kk khp -f Q -thin" + store + " 9_42");
+  assert (thin != full);
+  assert (run ("./kk khp -f Q" + store + " 9_42") == full);
+  assert (run ("./kk khp -f Q -thin" + store + " 9_42") == full);
+  
+  run (std::string ("rm -rf ") + dir);
+}
+
 void
 test_fields ()
 {
-  Q a (2, 1);
-  Q b (-2, 1);
+  Q a (2);
+  Q b (-2);
   a /= b;
   assert (a == -1);
 }
@@ -411,12 +805,20 @@ main ()
 {
   test_vector ();
   test_bitset ();
-  test_unsignedset1<unsignedset> ();
   test_unsignedset1<bitset> ();
   test_unsignedset1<ullmanset<1> > ();
   test_map ();
   test_polynomial ();
+  test_dense_polynomial ();
   test_laurentpoly ();
   // test_vs ();
   test_fields ();
+  test_bivariate_laurentpoly ();
+  test_Kh_bounds_solver ();
+  test_jones ();
+  test_alexander ();
+  test_murasugi ();
+  test_canonical ();
+  test_cost_model ();
+  test_thin_store ();
 }
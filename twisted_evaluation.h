@@ -0,0 +1,274 @@
+#ifndef _KNOTKIT_TWISTED_EVALUATION_H
+#define _KNOTKIT_TWISTED_EVALUATION_H
+
+#include <thread>
+#include <atomic>
+
+/* The twisted complexes over F(t) at points t = a of a finite
+   extension K of F.  Every entry of a twisted map is a rational
+   function of t, so at a point it is an element of K and the complex
+   over K reduces by plain sparse elimination, with none of the gcds
+   of fraction_field<polynomial<F> >.  The rank of a map at a point is
+   at most its rank over F(t), with equality away from the zeros of a
+   nonzero minor; the generic ranks are the largest seen over random
+   points.  Points are taken in rounds, eliminated in parallel, until
+   the largest rank of every graded piece has been seen twice. */
+
+/* The values of an entry at the points of a round, so the complex is
+   built once for all of them.  A single value is the same at every
+   point. */
+template<class K>
+class multipoint
+{
+ public:
+  std::vector<K> v;
+  
+  template<class O> multipoint combine (const multipoint &x, O op) const
+  {
+    multipoint r;
+    r.v.resize (std::max (v.size (), x.v.size ()));
+    for (unsigned i = 0; i < r.v.size (); i ++)
+      r.v[i] = op ((*this)[i], x[i]);
+    return r;
+  }
+  
+ public:
+  multipoint () : v(1) { }
+  multipoint (int x) : v(1, K (x)) { }
+  multipoint (const std::vector<K> &v_) : v(v_) { }
+  
+  const K &operator [] (unsigned i) const { return v.size () == 1 ? v[0] : v[i]; }
+  
+  bool operator == (int x) const
+  {
+    for (unsigned i = 0; i < v.size (); i ++)
+      {
+	if (v[i] != x)
+	  return 0;
+      }
+    return 1;
+  }
+  bool operator != (int x) const { return !operator == (x); }
+  
+  multipoint recip () const
+  {
+    multipoint r (*this);
+    for (unsigned i = 0; i < r.v.size (); i ++)
+      r.v[i] = r.v[i].recip ();
+    return r;
+  }
+  
+  multipoint operator - () const { return multipoint (0) - *this; }
+  multipoint operator + (const multipoint &x) const
+  {
+    return combine (x, [] (const K &a, const K &b) { return a + b; });
+  }
+  multipoint operator - (const multipoint &x) const
+  {
+    return combine (x, [] (const K &a, const K &b) { return a - b; });
+  }
+  multipoint operator * (const multipoint &x) const
+  {
+    return combine (x, [] (const K &a, const K &b) { return a * b; });
+  }
+  multipoint operator / (const multipoint &x) const { return operator * (x.recip ()); }
+  
+  multipoint &operator += (const multipoint &x) { return *this = *this + x; }
+  multipoint &operator -= (const multipoint &x) { return *this = *this - x; }
+  multipoint &operator *= (const multipoint &x) { return *this = *this * x; }
+};
+
+template<class F>
+class twisted_evaluator
+{
+ public:
+  typedef extension_field<F> K;
+  
+  // 0 for one per core
+  unsigned n_threads;
+  unsigned max_rounds;
+  
+  // points evaluated by the last call to homology ()
+  unsigned n_points;
+  
+ private:
+  uint64 state;
+  
+  K random_point ();
+  
+ public:
+  /* K has degree at least min_degree over F, up to
+     K::max_degree (); an element of degree k > n is not a root of
+     any polynomial of degree at most n.  Past the limit (61 over Z2)
+     a point may, with probability at most n / 2^61, be a root of the
+     denominator of an entry, and recip () then asserts. */
+  twisted_evaluator (unsigned min_degree, unsigned n_threads_ = 0);
+  
+  /* The graded dimensions over F(t) of the homology of the
+     differential d on generators with gradings gr, where
+     build (a, m) fills the rows of m, a sparse_field_matrix<multipoint<K> >,
+     with d at the points t = a[0], ..., as the exact code fills a
+     map_builder.  d must be homogeneous. */
+  template<class B> bivariate_laurentpoly
+    homology (const basedvector<grading, 1> &gr, B build);
+};
+
+template<class F>
+twisted_evaluator<F>::twisted_evaluator (unsigned min_degree, unsigned n_threads_)
+  : n_threads(n_threads_), max_rounds(8), n_points(0), state(0x9e3779b97f4a7c15ull)
+{
+  // 2^30 points or more
+  unsigned p = field_characteristic<F>::p,
+    k = 1;
+  for (uint64 q = p; q < ((uint64)1 << 30); q *= p)
+    k ++;
+  
+  k = std::min (std::max (k, min_degree), K::max_degree ());
+  if (K::k < k)
+    K::set_degree (k);
+}
+
+template<class F> extension_field<F>
+twisted_evaluator<F>::random_point ()
+{
+  unsigned p = field_characteristic<F>::p;
+  for (;;)
+    {
+      polynomial<F> a;
+      for (unsigned e = 0; e < K::k; e ++)
+	{
+	  // xorshift64
+	  state ^= state << 13;
+	  state ^= state >> 7;
+	  state ^= state << 17;
+	  a.add_term (F ((int)(state % p)), e);
+	}
+      // outside F, so of degree k
+      if (a.deg () >= 1)
+	return K (a);
+    }
+}
+
+template<class F> template<class B> bivariate_laurentpoly
+twisted_evaluator<F>::homology (const basedvector<grading, 1> &gr, B build)
+{
+  unsigned n = gr.size ();
+  
+  std::map<std::pair<int, int>, unsigned> block_idx;
+  std::vector<std::vector<unsigned> > blocks;
+  basedvector<unsigned, 1> gen_block (n);
+  for (unsigned i = 1; i <= n; i ++)
+    {
+      std::pair<int, int> hq (gr[i].h, gr[i].q);
+      std::map<std::pair<int, int>, unsigned>::const_iterator b = block_idx.find (hq);
+      if (b == block_idx.end ())
+	{
+	  b = block_idx.insert (std::make_pair (hq, blocks.size ())).first;
+	  blocks.push_back (std::vector<unsigned> ());
+	}
+      blocks[b->second].push_back (i);
+      gen_block[i] = b->second;
+    }
+  unsigned n_blocks = blocks.size ();
+  
+  unsigned nt = n_threads;
+  if (nt == 0)
+    nt = std::max (1u, std::thread::hardware_concurrency ());
+  unsigned per_round = std::max (2u, nt);
+  
+  std::vector<unsigned> best (n_blocks, 0),
+    best_seen (n_blocks, 0);
+  // block whose image lies in each block's, or n_blocks
+  std::vector<unsigned> target (n_blocks, n_blocks);
+  
+  n_points = 0;
+  for (unsigned round = 0; round < max_rounds; round ++)
+    {
+      // one build for all points of the round
+      std::vector<K> points (per_round);
+      for (unsigned i = 0; i < per_round; i ++)
+	points[i] = random_point ();
+      sparse_field_matrix<multipoint<K> > mm (n);
+      build (multipoint<K> (points), mm);
+      n_points += per_round;
+  
+      std::vector<sparse_field_matrix<K> > ms (per_round, sparse_field_matrix<K> (n));
+      for (unsigned j = 1; j <= n; j ++)
+	{
+	  const typename sparse_field_matrix<multipoint<K> >::entries &e = mm[j].e;
+	  for (unsigned k = 0; k < e.size (); k ++)
+	    for (unsigned i = 0; i < per_round; i ++)
+	      ms[i][j].muladd (e[k].second[i], e[k].first);
+	}
+      for (unsigned i = 0; i < per_round; i ++)
+	ms[i].finish ();
+  
+      for (unsigned i = 0; i < per_round; i ++)
+	for (unsigned j = 1; j <= n; j ++)
+	  {
+	    const typename sparse_field_matrix<K>::entries &e = ms[i][j].e;
+	    for (unsigned k = 0; k < e.size (); k ++)
+	      {
+		unsigned b = gen_block[j],
+		  t = gen_block[e[k].first];
+		assert (target[b] == n_blocks || target[b] == t);
+		target[b] = t;
+	      }
+	  }
+  
+      unsigned n_tasks = per_round * n_blocks;
+      std::vector<unsigned> ranks (n_tasks);
+      std::atomic<unsigned> next (0);
+      auto worker = [&] () {
+	for (unsigned t; (t = next ++) < n_tasks;)
+	  ranks[t] = ms[t / n_blocks].rank (blocks[t % n_blocks]);
+      };
+      std::vector<std::thread> pool;
+      for (unsigned i = 1; i < std::min (nt, n_tasks); i ++)
+	pool.push_back (std::thread (worker));
+      worker ();
+      for (unsigned i = 0; i < pool.size (); i ++)
+	pool[i].join ();
+  
+      bool done = 1;
+      for (unsigned b = 0; b < n_blocks; b ++)
+	{
+	  for (unsigned i = 0; i < per_round; i ++)
+	    {
+	      unsigned r = ranks[i * n_blocks + b];
+	      if (r > best[b])
+		{
+		  best[b] = r;
+		  best_seen[b] = 1;
+		}
+	      else if (r == best[b])
+		best_seen[b] ++;
+	    }
+	  if (best_seen[b] < 2)
+	    done = 0;
+	}
+      if (done)
+	break;
+    }
+  
+  std::vector<int> dim (n_blocks);
+  for (unsigned b = 0; b < n_blocks; b ++)
+    dim[b] = blocks[b].size () - best[b];
+  for (unsigned b = 0; b < n_blocks; b ++)
+    {
+      if (best[b])
+	dim[target[b]] -= best[b];
+    }
+  
+  bivariate_laurentpoly P;
+  for (std::map<std::pair<int, int>, unsigned>::const_iterator i = block_idx.begin ();
+       i != block_idx.end ();
+       i ++)
+    {
+      assert (dim[i->second] >= 0);
+      P.add_term (dim[i->second], i->first.first, i->first.second);
+    }
+  return P;
+}
+
+#endif // _KNOTKIT_TWISTED_EVALUATION_H